@@ -0,0 +1,177 @@
+#include "Benchmark.hpp"
+#include "Clock.hpp"
+#include "MessageId.h"
+#include "Registers.hpp"
+#include <stdexcept>
+
+namespace Xerxes
+{
+
+
+double BenchmarkResult::lossRatio() const
+{
+    return sent > 0 ? (double)lost / (double)sent : 0;
+}
+
+
+double BenchmarkResult::requestsPerSecond() const
+{
+    return seconds > 0 ? (double)received / seconds : 0;
+}
+
+
+double BenchmarkResult::bytesPerSecond() const
+{
+    return seconds > 0 ? (double)bytes / seconds : 0;
+}
+
+
+LatencyBenchmark::LatencyBenchmark(Protocol &protocol, const address_t myAddr, const uint32_t timeoutUs) :
+    _protocol(protocol), _myAddr(myAddr), _timeoutUs(timeoutUs)
+{
+}
+
+
+LatencyBenchmark::~LatencyBenchmark()
+{
+}
+
+
+void LatencyBenchmark::setReadOffset(const uint16_t offset)
+{
+    _readOffset = offset;
+}
+
+
+void LatencyBenchmark::drain(BenchmarkResult &result)
+{
+    Message message;
+    ReadStatus status;
+    while((status = _protocol.receive(message, _timeoutUs)) != READ_TIMEOUT)
+    {
+        if(status == READ_OK && message.srcAddr == result.address)
+        {
+            result.late++;
+        }
+    }
+}
+
+
+BenchmarkResult LatencyBenchmark::run(const address_t leaf, const BenchmarkProbe probe, const uint32_t count, const uint8_t readSize)
+{
+    if(probe == PROBE_READ && (readSize == 0 || readSize > MAX_READ_SIZE))
+    {
+        throw std::invalid_argument("Read size out of range.");
+    }
+
+    BenchmarkResult result;
+    result.address = leaf;
+    result.probe = probe;
+    result.readSize = probe == PROBE_READ ? readSize : 0;
+
+    Message request(_myAddr, leaf, MSGID_PING);
+    msgid_t expected = MSGID_PING_REPLY;
+    // PING_REPLY carries the device id and the version
+    size_t replyPayload = 3;
+    if(probe == PROBE_READ)
+    {
+        const std::vector<uint8_t> payload = {
+            (uint8_t)(_readOffset & 0xff),  // little endian
+            (uint8_t)(_readOffset >> 8),
+            readSize
+        };
+        request = Message(_myAddr, leaf, MSGID_READ, payload);
+        expected = MSGID_READ_VALUE;
+        replyPayload = readSize;
+    }
+
+    LatencyHistogram rtt;
+    LatencyHistogram wake;
+    Message reply;
+    const int64_t start = steadyNowNs();
+
+    for(uint32_t i = 0; i < count; i++)
+    {
+        if(!_protocol.sendMessage(request))
+        {
+            result.errors++;
+            continue;
+        }
+        result.sent++;
+        const int64_t sentNs = _protocol.lastSentNs();
+        const int64_t deadline = sentNs + (int64_t)_timeoutUs * 1000;
+
+        bool replied = false;
+        int64_t now;
+        while(!replied && (now = steadyNowNs()) < deadline)
+        {
+            const ReadStatus status = _protocol.receive(reply, (deadline - now + 999) / 1000);
+            const int64_t readNs = steadyNowNs();
+            if(status == READ_TIMEOUT)
+            {
+                break;
+            }
+            if(status == READ_CORRUPTED)
+            {
+                result.errors++;
+                continue;
+            }
+            if(reply.srcAddr != leaf)
+            {
+                // foreign traffic, not ours to count
+                continue;
+            }
+
+            replied = true;
+            if(reply.msgId != expected || (size_t)(reply.end() - reply.payloadBegin()) != replyPayload)
+            {
+                result.errors++;
+                continue;
+            }
+            result.received++;
+            // SOH, LEN and CHECKSUM frame the message on the wire
+            result.bytes += request.size() + 3 + reply.size() + 3;
+            rtt.record(reply.timestampNs - sentNs);
+            wake.record(readNs - reply.timestampNs);
+        }
+
+        if(!replied)
+        {
+            result.lost++;
+            // the reply may still come and would be taken for the reply to the next request
+            drain(result);
+        }
+    }
+
+    result.seconds = (double)(steadyNowNs() - start) / 1e9;
+    result.rttNs = rtt.snapshot();
+    result.wakeNs = wake.snapshot();
+    return result;
+}
+
+
+std::vector<BenchmarkResult> LatencyBenchmark::sweep(const address_t leaf, const uint32_t count, const std::vector<uint8_t> &sizes)
+{
+    std::vector<BenchmarkResult> results;
+    results.reserve(sizes.size());
+    for(const uint8_t size : sizes)
+    {
+        results.push_back(run(leaf, PROBE_READ, count, size));
+    }
+    return results;
+}
+
+
+std::vector<uint8_t> LatencyBenchmark::sweepSizes()
+{
+    std::vector<uint8_t> sizes;
+    for(size_t size = 1; size < MAX_READ_SIZE; size *= 2)
+    {
+        sizes.push_back(size);
+    }
+    sizes.push_back(MAX_READ_SIZE);
+    return sizes;
+}
+
+
+} // namespace Xerxes
@@ -0,0 +1,133 @@
+#ifndef __BENCHMARK_HPP
+#define __BENCHMARK_HPP
+
+#include "Protocol.hpp"
+#include "Metrics.hpp"
+#include "Master.hpp"
+#include <cstdint>
+#include <stddef.h>
+#include <vector>
+
+namespace Xerxes
+{
+
+
+/**
+ * @brief Request the benchmark sends to the leaf
+ *
+ */
+enum BenchmarkProbe : uint8_t
+{
+    /// @brief PING, the smallest request with a reply
+    PROBE_PING = 0,
+    /// @brief READ of readSize bytes, the reply grows with the size
+    PROBE_READ
+};
+
+
+/**
+ * @brief Result of one benchmark run against one leaf
+ *
+ */
+struct BenchmarkResult
+{
+    address_t address = 0;
+    BenchmarkProbe probe = PROBE_PING;
+    /// @brief number of bytes read by PROBE_READ, 0 for PROBE_PING
+    uint8_t readSize = 0;
+
+    /// @brief number of requests sent
+    uint64_t sent = 0;
+    /// @brief number of matching replies
+    uint64_t received = 0;
+    /// @brief requests with no reply in time
+    uint64_t lost = 0;
+    /// @brief corrupted frames and replies with a wrong message id or size
+    uint64_t errors = 0;
+    /// @brief replies which arrived after their request timed out
+    uint64_t late = 0;
+    /// @brief bytes on the wire in both directions, whole frames
+    uint64_t bytes = 0;
+    /// @brief wall time of the run
+    double seconds = 0;
+    /// @brief round trip times in nanoseconds, TX timestamp of the request to RX timestamp of the reply
+    HistogramSnapshot rttNs;
+    /// @brief reply detection delays in nanoseconds, RX timestamp of the reply to the reader getting it
+    HistogramSnapshot wakeNs;
+
+    /// @brief lost requests to sent requests
+    double lossRatio() const;
+
+    /// @brief completed requests per second
+    double requestsPerSecond() const;
+
+    /// @brief bytes per second on the wire in both directions
+    double bytesPerSecond() const;
+};
+
+
+/**
+ * @brief Latency and throughput characterisation of the leaves on a bus
+ *
+ * Sends back-to-back requests to a leaf and times each round trip from the TX timestamp
+ * of the request to the RX timestamp of the reply. The benchmark talks to the Protocol
+ * directly, with no retries, so every timeout counts as a lost request. Nothing else
+ * may use the bus during a run.
+ *
+ * Works with any Network, SimulatedBus gives the numbers of the host side alone.
+ */
+class LatencyBenchmark
+{
+private:
+    Protocol &_protocol;
+    address_t _myAddr;
+    uint32_t _timeoutUs;
+    uint16_t _readOffset = 0;
+
+    /// @brief read frames until the bus is quiet for one timeout, counts the late replies
+    void drain(BenchmarkResult &result);
+
+public:
+    /**
+     * @brief Construct a new Latency Benchmark object
+     *
+     * @param protocol protocol of the bus
+     * @param myAddr address the requests are sent from
+     * @param timeoutUs time to wait for each reply in microseconds
+     */
+    LatencyBenchmark(Protocol &protocol, const address_t myAddr, const uint32_t timeoutUs = 10000);
+    ~LatencyBenchmark();
+
+    /// @brief Set the memory offset PROBE_READ reads from, 0 by default
+    void setReadOffset(const uint16_t offset);
+
+    /**
+     * @brief Send count requests to the leaf, one at a time
+     *
+     * @param leaf address of the leaf
+     * @param probe request to send
+     * @param count number of requests
+     * @param readSize number of bytes read by PROBE_READ, up to MAX_READ_SIZE
+     * @return BenchmarkResult counters and round trip times of the run
+     * @throw std::invalid_argument if readSize is 0 or larger than MAX_READ_SIZE for PROBE_READ
+     */
+    BenchmarkResult run(const address_t leaf, const BenchmarkProbe probe, const uint32_t count, const uint8_t readSize = 4);
+
+    /**
+     * @brief Run PROBE_READ for each read size
+     *
+     * @param leaf address of the leaf
+     * @param count number of requests per size
+     * @param sizes read sizes, see sweepSizes()
+     * @return std::vector<BenchmarkResult> one result per size
+     */
+    std::vector<BenchmarkResult> sweep(const address_t leaf, const uint32_t count, const std::vector<uint8_t> &sizes = sweepSizes());
+
+    /// @brief Powers of two from 1 byte up to the largest READ fitting into a frame
+    static std::vector<uint8_t> sweepSizes();
+};
+
+
+} // namespace Xerxes
+
+#endif // !__BENCHMARK_HPP
@@ -0,0 +1,318 @@
+#include "Bulk.hpp"
+#include "Clock.hpp"
+#include "Registers.hpp"
+#include <algorithm>
+#include <array>
+#include <stdexcept>
+#include <thread>
+
+namespace Xerxes
+{
+
+
+uint16_t crc16(const uint8_t *data, const size_t length)
+{
+    uint16_t crc = 0xffff;
+    for(size_t i = 0; i < length; i++)
+    {
+        crc ^= (uint16_t)data[i] << 8;
+        for(uint8_t bit = 0; bit < 8; bit++)
+        {
+            crc = crc & 0x8000 ? (crc << 1) ^ 0x1021 : crc << 1;
+        }
+    }
+    return crc;
+}
+
+
+static constexpr std::array<uint32_t, 256> buildCrc32Table()
+{
+    std::array<uint32_t, 256> table {};
+    for(uint32_t i = 0; i < 256; i++)
+    {
+        uint32_t crc = i;
+        for(uint8_t bit = 0; bit < 8; bit++)
+        {
+            crc = crc & 1 ? (crc >> 1) ^ 0xEDB88320 : crc >> 1;
+        }
+        table[i] = crc;
+    }
+    return table;
+}
+
+
+static constexpr std::array<uint32_t, 256> crc32Table = buildCrc32Table();
+
+
+uint32_t crc32(const uint8_t *data, const size_t length)
+{
+    uint32_t crc = 0xffffffff;
+    for(size_t i = 0; i < length; i++)
+    {
+        crc = crc32Table[(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+    }
+    return ~crc;
+}
+
+
+static void putLe(std::vector<uint8_t> &out, const uint32_t value, const size_t bytes)
+{
+    for(size_t i = 0; i < bytes; i++)
+    {
+        out.push_back((value >> (8 * i)) & 0xff);
+    }
+}
+
+
+/**
+ * @brief State of the transfer to one leaf
+ *
+ */
+struct BulkLeaf
+{
+    enum Phase : uint8_t
+    {
+        BEGIN,
+        DATA,
+        QUERY,
+        COMMIT,
+        DONE
+    };
+
+    Phase phase = BEGIN;
+    /// @brief first block of the current window
+    uint32_t first = 0;
+    /// @brief blocks of the window still to send
+    std::vector<uint16_t> missing;
+    /// @brief the leaf is busy until this time
+    int64_t readyAtNs = 0;
+    uint8_t rounds = 0;
+    uint8_t failures = 0;
+};
+
+
+BulkTransfer::BulkTransfer(Master &master, const BulkOptions &options) :
+    _master(master), _options(options)
+{
+    if(options.blockSize == 0 || options.blockSize > BULK_MAX_BLOCK_SIZE)
+    {
+        throw std::invalid_argument("Bulk block size out of range.");
+    }
+    if(options.window == 0 || options.window > BULK_MAX_QUERY_BLOCKS)
+    {
+        throw std::invalid_argument("Bulk window out of range.");
+    }
+}
+
+
+BulkTransfer::~BulkTransfer()
+{
+}
+
+
+BulkResult BulkTransfer::send(const address_t leaf, const uint8_t *image, const size_t size)
+{
+    return send(std::vector<address_t>{leaf}, image, size).front();
+}
+
+
+std::vector<BulkResult> BulkTransfer::send(const std::vector<address_t> &leaves, const uint8_t *image, const size_t size)
+{
+    const uint8_t blockSize = _options.blockSize;
+    const uint32_t blocks = (size + blockSize - 1) / blockSize;
+    if(blocks > BULK_MAX_BLOCKS)
+    {
+        throw std::invalid_argument("Bulk image too large.");
+    }
+
+    std::vector<BulkResult> results(leaves.size());
+    std::vector<BulkLeaf> states(leaves.size());
+
+    // BEGIN is the same for all leaves
+    std::vector<uint8_t> begin;
+    putLe(begin, size, 4);
+    begin.push_back(blockSize);
+    putLe(begin, crc32(image, size), 4);
+
+    // blocks are sent to every leaf and again when missing, build their payloads once
+    std::vector<std::vector<uint8_t>> payloads(blocks);
+    for(uint32_t block = 0; block < blocks; block++)
+    {
+        const size_t offset = (size_t)block * blockSize;
+        const size_t length = std::min<size_t>(blockSize, size - offset);
+        std::vector<uint8_t> &payload = payloads[block];
+        payload.reserve(4 + length);
+        putLe(payload, block, 2);
+        putLe(payload, crc16(image + offset, length), 2);
+        payload.insert(payload.end(), image + offset, image + offset + length);
+    }
+
+    const address_t self = _master.getAddr();
+    const int64_t start = steadyNowNs();
+    size_t active = leaves.size();
+    for(size_t i = 0; i < leaves.size(); i++)
+    {
+        results[i].address = leaves[i];
+        results[i].blocks = blocks;
+    }
+
+    auto finish = [&](const size_t i, const Result<void> status) {
+        results[i].status = status;
+        results[i].seconds = (double)(steadyNowNs() - start) / 1e9;
+        states[i].phase = BulkLeaf::DONE;
+        active--;
+    };
+
+    // a failed request is repeated on the next pass until the leaf fails too many in a row
+    auto failed = [&](const size_t i, const XerxesError error) {
+        if(error == ERROR_NOK || ++states[i].failures >= _options.maxFailures)
+        {
+            finish(i, std::unexpected(error));
+        }
+    };
+
+    auto nextWindow = [&](BulkLeaf &state) {
+        state.missing.clear();
+        const uint32_t last = std::min<uint32_t>(state.first + _options.window, blocks);
+        for(uint32_t block = state.first; block < last; block++)
+        {
+            state.missing.push_back(block);
+        }
+        state.rounds = 0;
+        state.phase = state.missing.empty() ? BulkLeaf::COMMIT : BulkLeaf::DATA;
+    };
+
+    Message reply;
+    while(active > 0)
+    {
+        bool served = false;
+        int64_t wakeNs = INT64_MAX;
+
+        for(size_t i = 0; i < leaves.size(); i++)
+        {
+            BulkLeaf &state = states[i];
+            const address_t leaf = leaves[i];
+            if(state.phase == BulkLeaf::DONE)
+            {
+                continue;
+            }
+            if(state.readyAtNs > steadyNowNs())
+            {
+                // the leaf is writing its flash, serve the others meanwhile
+                wakeNs = std::min(wakeNs, state.readyAtNs);
+                continue;
+            }
+            served = true;
+
+            switch(state.phase)
+            {
+                case BulkLeaf::BEGIN:
+                {
+                    Result<void> done = _master.tryRequest(Message(self, leaf, MSGID_BULK_BEGIN, begin), {MSGID_ACK_OK}, reply);
+                    if(!done)
+                    {
+                        failed(i, done.error());
+                        break;
+                    }
+                    state.failures = 0;
+                    nextWindow(state);
+                    break;
+                }
+
+                case BulkLeaf::DATA:
+                {
+                    for(const uint16_t block : state.missing)
+                    {
+                        _master.post(Message(self, leaf, MSGID_BULK_DATA, payloads[block]));
+                    }
+                    results[i].retransmits += state.rounds > 0 ? state.missing.size() : 0;
+                    state.phase = BulkLeaf::QUERY;
+                    break;
+                }
+
+                case BulkLeaf::QUERY:
+                {
+                    const uint16_t count = std::min<uint32_t>(_options.window, blocks - state.first);
+                    std::vector<uint8_t> query;
+                    putLe(query, state.first, 2);
+                    putLe(query, count, 2);
+                    Result<void> done = _master.tryRequest(Message(self, leaf, MSGID_BULK_QUERY, query), {MSGID_BULK_STATUS}, reply);
+                    // FIRST_BLOCK u16 | BLOCKS u16 | BUSY_US u32 | BITMAP
+                    const size_t payload = reply.end() - reply.payloadBegin();
+                    if(done && payload < 8 + (count + 7u) / 8)
+                    {
+                        done = std::unexpected(ERROR_REPLY_SIZE);
+                    }
+                    if(!done)
+                    {
+                        failed(i, done.error());
+                        break;
+                    }
+
+                    state.failures = 0;
+
+                    const uint8_t *status = &*reply.payloadBegin();
+                    const uint32_t busyUs = status[4] | status[5] << 8 | status[6] << 16 | (uint32_t)status[7] << 24;
+                    if(busyUs > 0)
+                    {
+                        state.readyAtNs = steadyNowNs() + (int64_t)busyUs * 1000;
+                        break;
+                    }
+
+                    const uint8_t *bitmap = status + 8;
+                    state.missing.clear();
+                    for(uint16_t bit = 0; bit < count; bit++)
+                    {
+                        if(!(bitmap[bit / 8] & (1 << (bit % 8))))
+                        {
+                            state.missing.push_back(state.first + bit);
+                        }
+                    }
+
+                    if(state.missing.empty())
+                    {
+                        state.first += count;
+                        nextWindow(state);
+                    }
+                    else if(++state.rounds > _options.maxRounds)
+                    {
+                        finish(i, std::unexpected(ERROR_TIMEOUT));
+                    }
+                    else
+                    {
+                        state.phase = BulkLeaf::DATA;
+                    }
+                    break;
+                }
+
+                case BulkLeaf::COMMIT:
+                {
+                    // the leaf verifies the image and may finish writing its flash
+                    Result<void> done = _master.tryRequest(
+                        Message(self, leaf, MSGID_BULK_COMMIT), {MSGID_ACK_OK}, reply, FLASH_WRITE_TIMEOUT_US
+                    );
+                    if(!done)
+                    {
+                        failed(i, done.error());
+                        break;
+                    }
+                    finish(i, {});
+                    break;
+                }
+
+                case BulkLeaf::DONE:
+                    break;
+            }
+        }
+
+        if(!served && active > 0)
+        {
+            std::this_thread::sleep_for(std::chrono::nanoseconds(wakeNs - steadyNowNs()));
+        }
+    }
+
+    return results;
+}
+
+
+} // namespace Xerxes
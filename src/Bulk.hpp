@@ -0,0 +1,115 @@
+#ifndef __BULK_HPP
+#define __BULK_HPP
+
+#include "Master.hpp"
+#include <cstdint>
+#include <stddef.h>
+#include <vector>
+
+namespace Xerxes
+{
+
+
+/// @brief Largest block of a bulk transfer: MSGID_BULK_DATA payload without BLOCK and CRC16
+constexpr uint8_t BULK_MAX_BLOCK_SIZE = 244;
+
+/// @brief Largest number of blocks of a bulk transfer a leaf keeps track of
+constexpr uint16_t BULK_MAX_BLOCKS = 2048;
+
+/// @brief Largest number of blocks a single MSGID_BULK_STATUS reports
+constexpr uint16_t BULK_MAX_QUERY_BLOCKS = 8 * (248 - 8);
+
+
+/// @brief CRC-16/CCITT-FALSE of a block
+uint16_t crc16(const uint8_t *data, const size_t length);
+
+/// @brief CRC-32 (IEEE 802.3) of an image
+uint32_t crc32(const uint8_t *data, const size_t length);
+
+
+/**
+ * @brief Options of a bulk transfer
+ *
+ */
+struct BulkOptions
+{
+    /// @brief bytes per block, up to BULK_MAX_BLOCK_SIZE
+    uint8_t blockSize = BULK_MAX_BLOCK_SIZE;
+    /// @brief blocks sent before the leaf is asked which arrived
+    uint16_t window = 32;
+    /// @brief retransmissions of one window before the leaf is given up
+    uint8_t maxRounds = 8;
+    /// @brief failed BEGIN, QUERY or COMMIT requests before the leaf is given up
+    uint8_t maxFailures = 3;
+};
+
+
+/**
+ * @brief Outcome of a bulk transfer to one leaf
+ *
+ */
+struct BulkResult
+{
+    address_t address = 0;
+    /// @brief nothing if the leaf committed the image, the reason of the failure otherwise
+    Result<void> status;
+    /// @brief blocks of the image
+    uint32_t blocks = 0;
+    /// @brief blocks sent more than once
+    uint32_t retransmits = 0;
+    /// @brief time from the start of the transfer until the leaf finished
+    double seconds = 0;
+};
+
+
+/**
+ * @brief Windowed transfer of an image to many leaves at once
+ *
+ * The image is split into blocks with a CRC16 each. A window of blocks is streamed to a
+ * leaf without replies, then the leaf is asked for a bitmap of the blocks which arrived
+ * and only the missing ones are sent again. A leaf writing its flash reports how long it
+ * is busy, meanwhile the bus serves the windows of the other leaves, so the transfers are
+ * interleaved and the bus stays busy. Finally the leaf verifies the CRC32 of the image.
+ *
+ * Message flow per leaf:
+ *
+ *     BULK_BEGIN -> ACK_OK
+ *     (BULK_DATA * window, BULK_QUERY -> BULK_STATUS)*
+ *     BULK_COMMIT -> ACK_OK
+ */
+class BulkTransfer
+{
+private:
+    Master &_master;
+    BulkOptions _options;
+
+public:
+    /**
+     * @brief Construct a new Bulk Transfer object
+     *
+     * @param master master of the bus
+     * @param options block size, window and limits
+     * @throw std::invalid_argument if the block size or the window is out of range
+     */
+    BulkTransfer(Master &master, const BulkOptions &options = {});
+    ~BulkTransfer();
+
+    /**
+     * @brief Transfer an image to many leaves, interleaved
+     *
+     * @param leaves addresses of the leaves
+     * @param image bytes of the image
+     * @param size size of the image
+     * @return std::vector<BulkResult> outcome per leaf in the order of leaves
+     * @throw std::invalid_argument if the image has more than BULK_MAX_BLOCKS blocks
+     */
+    std::vector<BulkResult> send(const std::vector<address_t> &leaves, const uint8_t *image, const size_t size);
+
+    /// @brief Transfer an image to one leaf
+    BulkResult send(const address_t leaf, const uint8_t *image, const size_t size);
+};
+
+
+} // namespace Xerxes
+
+#endif // !__BULK_HPP
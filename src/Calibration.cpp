@@ -0,0 +1,140 @@
+#include "Calibration.hpp"
+#include "DeviceProfiles.hpp"
+#include "MemoryMap.h"
+#include <cstring>
+
+namespace Xerxes
+{
+
+
+CalibrationCache::CalibrationCache(const std::vector<address_t> &leaves) :
+    _leaves(leaves),
+    _gain(leaves.size() * PV_COUNT, 1.0f),
+    _offset(leaves.size() * PV_COUNT, 0.0f)
+{
+}
+
+
+CalibrationCache::~CalibrationCache()
+{
+}
+
+
+size_t CalibrationCache::leaves() const
+{
+    return _leaves.size();
+}
+
+
+size_t CalibrationCache::channels() const
+{
+    return _gain.size();
+}
+
+
+/// @brief scale of the process value in the device profile, 1 if the profile does not describe it
+static double unitScale(const devid_t devId, const size_t pv)
+{
+    const DeviceProfile &profile = deviceProfile(devId);
+    for(size_t i = 0; i < profile.channelCount; i++)
+    {
+        if(profile.channels[i].offset == PV0_OFFSET + 4 * pv)
+        {
+            return profile.channels[i].scale;
+        }
+    }
+    return 1.0;
+}
+
+
+void CalibrationCache::set(const size_t leaf, const float gain[PV_COUNT], const float offset[PV_COUNT], const devid_t devId)
+{
+    for(size_t pv = 0; pv < PV_COUNT; pv++)
+    {
+        const double scale = unitScale(devId, pv);
+        const size_t channel = ProcessStatistics::channel(leaf, pv);
+        _gain[channel] = gain[pv] * scale;
+        _offset[channel] = offset[pv] * scale;
+    }
+}
+
+
+void CalibrationCache::load(Master &master, const size_t leaf, const devid_t devId)
+{
+    // GAIN_PV0..GAIN_PV3 and OFFSET_PV0..OFFSET_PV3 are adjacent, the read throws on a short reply
+    uint8_t data[OFFSET_PV3_OFFSET + sizeof(float) - GAIN_PV0_OFFSET];
+    master.readMemory(_leaves[leaf], GAIN_PV0_OFFSET, sizeof(data), data);
+
+    float gain[PV_COUNT];
+    float offset[PV_COUNT];
+    memcpy(gain, data, sizeof(gain));
+    memcpy(offset, data + OFFSET_PV0_OFFSET - GAIN_PV0_OFFSET, sizeof(offset));
+    set(leaf, gain, offset, devId);
+}
+
+
+void CalibrationCache::load(Master &master)
+{
+    for(size_t leaf = 0; leaf < _leaves.size(); leaf++)
+    {
+        load(master, leaf, master.ping(_leaves[leaf]).device_id);
+    }
+}
+
+
+// restrict parameters let the compiler vectorise the kernels
+
+static void calibrate(
+    const size_t n,
+    const float *__restrict gain,
+    const float *__restrict offset,
+    const float *__restrict raw,
+    float *__restrict out
+)
+{
+    for(size_t i = 0; i < n; i++)
+    {
+        out[i] = raw[i] * gain[i] + offset[i];
+    }
+}
+
+
+static void calibrateInPlace(
+    const size_t n,
+    const float *__restrict gain,
+    const float *__restrict offset,
+    float *__restrict values
+)
+{
+    for(size_t i = 0; i < n; i++)
+    {
+        values[i] = values[i] * gain[i] + offset[i];
+    }
+}
+
+
+void CalibrationCache::apply(const float *raw, float *out) const
+{
+    calibrate(_gain.size(), _gain.data(), _offset.data(), raw, out);
+}
+
+
+void CalibrationCache::apply(float *values) const
+{
+    calibrateInPlace(_gain.size(), _gain.data(), _offset.data(), values);
+}
+
+
+float CalibrationCache::gain(const size_t channel) const
+{
+    return _gain[channel];
+}
+
+
+float CalibrationCache::offset(const size_t channel) const
+{
+    return _offset[channel];
+}
+
+
+} // namespace Xerxes
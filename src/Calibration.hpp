@@ -0,0 +1,104 @@
+#ifndef __CALIBRATION_HPP
+#define __CALIBRATION_HPP
+
+#include <vector>
+#include <cstdint>
+#include <stddef.h>
+#include "Master.hpp"
+#include "DeviceIds.h"
+#include "Statistics.hpp"
+
+namespace Xerxes
+{
+
+
+/**
+ * @brief Cached calibration of the process values of many leaves
+ *
+ * Holds the GAIN_PV* and OFFSET_PV* coefficients of every leaf, read once from the
+ * non-volatile range, with the unit scale of the device profile folded in. The
+ * coefficients are stored per channel (channel = leaf index * PV_COUNT + pv), the same
+ * layout as the PV0..PV3 blocks read from the leaves, so apply() is one multiply-add
+ * per channel over contiguous arrays which the compiler vectorises.
+ *
+ * value = (raw * gain + offset) * unitScale
+ */
+class CalibrationCache
+{
+private:
+    std::vector<address_t> _leaves;
+    /// @brief gain * unitScale of every channel
+    std::vector<float> _gain;
+    /// @brief offset * unitScale of every channel
+    std::vector<float> _offset;
+
+public:
+    /**
+     * @brief Construct a new Calibration Cache object, every leaf starts with gain 1 and offset 0
+     *
+     * @param leaves addresses of the leaves, the index in this list is the leaf index
+     */
+    CalibrationCache(const std::vector<address_t> &leaves);
+    ~CalibrationCache();
+
+    /// @brief Number of leaves
+    size_t leaves() const;
+
+    /// @brief Number of channels, leaves() * PV_COUNT
+    size_t channels() const;
+
+    /**
+     * @brief Set the coefficients of a leaf
+     *
+     * @param leaf leaf index
+     * @param gain GAIN_PV0..GAIN_PV3
+     * @param offset OFFSET_PV0..OFFSET_PV3
+     * @param devId device id selecting the unit scale, unknown devices are not scaled
+     */
+    void set(const size_t leaf, const float gain[PV_COUNT], const float offset[PV_COUNT], const devid_t devId);
+
+    /**
+     * @brief Read the coefficients of a leaf from its non-volatile range, a single read
+     *
+     * @param master master of the bus
+     * @param leaf leaf index
+     * @param devId device id of the leaf
+     * @throw TimeoutError if the leaf does not reply
+     * @throw std::runtime_error if the reply is invalid or of a different size
+     */
+    void load(Master &master, const size_t leaf, const devid_t devId);
+
+    /**
+     * @brief Ping every leaf for its device id and read its coefficients
+     *
+     * @param master master of the bus
+     * @throw TimeoutError if a leaf does not reply
+     */
+    void load(Master &master);
+
+    /**
+     * @brief Calibrate the raw process values of all leaves
+     *
+     * @param raw channels() raw values, PV0..PV3 of each leaf in leaf order
+     * @param out channels() calibrated values, must not overlap raw
+     */
+    void apply(const float *raw, float *out) const;
+
+    /**
+     * @brief Calibrate the raw process values of all leaves in place
+     *
+     * @param values channels() values
+     */
+    void apply(float *values) const;
+
+    /// @brief Effective gain of the channel, unit scale included
+    float gain(const size_t channel) const;
+
+    /// @brief Effective offset of the channel, unit scale included
+    float offset(const size_t channel) const;
+};
+
+
+} // namespace Xerxes
+
+#endif // !__CALIBRATION_HPP
@@ -0,0 +1,483 @@
+#include "Capture.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <stdexcept>
+#include <thread>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace Xerxes
+{
+
+
+/// @brief size of the block header
+constexpr size_t BLOCK_HEADER_SIZE = 4 + 4 + 4 + 8;
+/// @brief size of one index entry
+constexpr size_t INDEX_ENTRY_SIZE = 8 + 8 + 4;
+/// @brief size of the footer
+constexpr size_t FOOTER_SIZE = 8 + 4 + 4;
+/// @brief shortest match worth encoding
+constexpr size_t MIN_MATCH = 4;
+/// @brief farthest match reachable with the 16 bit offset
+constexpr size_t MAX_OFFSET = 0xffff;
+constexpr size_t HASH_BITS = 12;
+
+
+static void putLe(std::vector<uint8_t> &out, const uint64_t value, const size_t bytes)
+{
+    for(size_t i = 0; i < bytes; i++)
+    {
+        out.push_back((uint8_t)(value >> (8 * i)));
+    }
+}
+
+
+static uint64_t getLe(const uint8_t *in, const size_t bytes)
+{
+    uint64_t value = 0;
+    for(size_t i = 0; i < bytes; i++)
+    {
+        value |= (uint64_t)in[i] << (8 * i);
+    }
+    return value;
+}
+
+
+static void putVarint(std::vector<uint8_t> &out, uint64_t value)
+{
+    while(value >= 0x80)
+    {
+        out.push_back((uint8_t)(value | 0x80));
+        value >>= 7;
+    }
+    out.push_back((uint8_t)value);
+}
+
+
+static bool getVarint(const uint8_t *&in, const uint8_t *end, uint64_t &value)
+{
+    value = 0;
+    for(size_t shift = 0; in < end && shift < 64; shift += 7)
+    {
+        const uint8_t byte = *in++;
+        value |= (uint64_t)(byte & 0x7f) << shift;
+        if(!(byte & 0x80))
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+
+static uint32_t hash4(const uint8_t *p)
+{
+    uint32_t v;
+    memcpy(&v, p, sizeof(v));
+    return (v * 2654435761u) >> (32 - HASH_BITS);
+}
+
+
+static void pack(const std::vector<uint8_t> &raw, std::vector<uint8_t> &out)
+{
+    std::vector<uint32_t> table(1 << HASH_BITS, UINT32_MAX);
+    const size_t n = raw.size();
+    const uint8_t *src = raw.data();
+
+    size_t literal_start = 0;
+    size_t pos = 0;
+    while(pos + MIN_MATCH <= n)
+    {
+        const uint32_t h = hash4(src + pos);
+        const uint32_t candidate = table[h];
+        table[h] = pos;
+
+        if(candidate != UINT32_MAX && pos - candidate <= MAX_OFFSET && memcmp(src + candidate, src + pos, MIN_MATCH) == 0)
+        {
+            size_t length = MIN_MATCH;
+            while(pos + length < n && src[candidate + length] == src[pos + length])
+            {
+                length++;
+            }
+
+            putVarint(out, pos - literal_start);
+            out.insert(out.end(), src + literal_start, src + pos);
+            putVarint(out, length - MIN_MATCH);
+            putLe(out, pos - candidate, 2);
+
+            pos += length;
+            literal_start = pos;
+        }
+        else
+        {
+            pos++;
+        }
+    }
+
+    putVarint(out, n - literal_start);
+    out.insert(out.end(), src + literal_start, src + n);
+}
+
+
+static bool unpack(const uint8_t *in, const uint8_t *end, std::vector<uint8_t> &raw, const size_t rawSize)
+{
+    raw.resize(rawSize);
+    uint8_t *dst = raw.data();
+    size_t pos = 0;
+
+    while(true)
+    {
+        uint64_t literals;
+        if(!getVarint(in, end, literals) || literals > (uint64_t)(end - in) || pos + literals > rawSize)
+        {
+            return false;
+        }
+        memcpy(dst + pos, in, literals);
+        in += literals;
+        pos += literals;
+
+        if(pos == rawSize)
+        {
+            return true;
+        }
+
+        uint64_t length;
+        if(!getVarint(in, end, length) || end - in < 2)
+        {
+            return false;
+        }
+        length += MIN_MATCH;
+        const size_t offset = getLe(in, 2);
+        in += 2;
+        if(offset == 0 || offset > pos || pos + length > rawSize)
+        {
+            return false;
+        }
+
+        // byte by byte, the match may overlap its own output
+        for(size_t i = 0; i < length; i++, pos++)
+        {
+            dst[pos] = dst[pos - offset];
+        }
+    }
+}
+
+
+CaptureWriter::CaptureWriter(const std::string &path, const size_t blockSize) :
+    _blockSize(blockSize)
+{
+    _file = fopen(path.c_str(), "wb");
+    if(_file == nullptr)
+    {
+        throw std::runtime_error("Can not create capture " + path);
+    }
+
+    uint8_t header[8] = {0};
+    memcpy(header, CAPTURE_FILE_MAGIC, sizeof(CAPTURE_FILE_MAGIC));
+    header[4] = CAPTURE_FILE_VERSION;
+    fwrite(header, 1, sizeof(header), _file);
+    _offset = sizeof(header);
+
+    _raw.reserve(_blockSize + MAX_FRAME_SIZE + 16);
+}
+
+
+CaptureWriter::~CaptureWriter()
+{
+    close();
+}
+
+
+void CaptureWriter::write(
+    const uint64_t timestampNs,
+    const uint8_t busId,
+    const TraceDirection direction,
+    const uint8_t *frame,
+    const size_t length
+)
+{
+    if(_records == 0)
+    {
+        _firstTimestamp = timestampNs;
+        _lastTimestamp = timestampNs;
+    }
+
+    const uint8_t len = length < MAX_FRAME_SIZE ? length : MAX_FRAME_SIZE;
+    putVarint(_raw, timestampNs - _lastTimestamp);
+    _raw.push_back(busId);
+    _raw.push_back(direction);
+    _raw.push_back(len);
+    _raw.insert(_raw.end(), frame, frame + len);
+
+    _lastTimestamp = timestampNs;
+    _records++;
+
+    if(_raw.size() >= _blockSize)
+    {
+        flushBlock();
+    }
+}
+
+
+void CaptureWriter::flushBlock()
+{
+    if(_records == 0 || _file == nullptr)
+    {
+        return;
+    }
+
+    _packed.clear();
+    putLe(_packed, 0, 4);   // packed size, filled in below
+    putLe(_packed, _raw.size(), 4);
+    putLe(_packed, _records, 4);
+    putLe(_packed, _firstTimestamp, 8);
+    pack(_raw, _packed);
+
+    const uint32_t packed_size = _packed.size() - BLOCK_HEADER_SIZE;
+    for(size_t i = 0; i < 4; i++)
+    {
+        _packed[i] = (uint8_t)(packed_size >> (8 * i));
+    }
+
+    fwrite(_packed.data(), 1, _packed.size(), _file);
+    _index.push_back({_offset, _firstTimestamp, _records});
+    _offset += _packed.size();
+
+    _raw.clear();
+    _records = 0;
+}
+
+
+bool CaptureWriter::close()
+{
+    if(_file == nullptr)
+    {
+        return true;
+    }
+
+    flushBlock();
+
+    std::vector<uint8_t> tail;
+    for(const auto &block : _index)
+    {
+        putLe(tail, block.offset, 8);
+        putLe(tail, block.firstTimestampNs, 8);
+        putLe(tail, block.records, 4);
+    }
+    putLe(tail, _offset, 8);
+    putLe(tail, _index.size(), 4);
+    tail.insert(tail.end(), CAPTURE_INDEX_MAGIC, CAPTURE_INDEX_MAGIC + sizeof(CAPTURE_INDEX_MAGIC));
+    fwrite(tail.data(), 1, tail.size(), _file);
+
+    bool ok = !ferror(_file);
+    ok &= fclose(_file) == 0;
+    _file = nullptr;
+    return ok;
+}
+
+
+CaptureReader::CaptureReader(const std::string &path)
+{
+    int fd = open(path.c_str(), O_RDONLY);
+    if(fd < 0)
+    {
+        throw std::runtime_error("Can not open capture " + path);
+    }
+
+    struct stat st;
+    fstat(fd, &st);
+    _size = st.st_size;
+    if(_size < 8 + FOOTER_SIZE)
+    {
+        ::close(fd);
+        throw std::runtime_error("Not a capture file " + path);
+    }
+
+    void *map = mmap(nullptr, _size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if(map == MAP_FAILED)
+    {
+        throw std::runtime_error("Can not map capture " + path);
+    }
+    _map = (const uint8_t *)map;
+    madvise(map, _size, MADV_SEQUENTIAL);
+
+    const uint8_t *footer = _map + _size - FOOTER_SIZE;
+    const uint64_t index_offset = getLe(footer, 8);
+    const uint32_t blocks = getLe(footer + 8, 4);
+    if(
+        memcmp(_map, CAPTURE_FILE_MAGIC, sizeof(CAPTURE_FILE_MAGIC)) != 0 ||
+        _map[4] != CAPTURE_FILE_VERSION ||
+        memcmp(footer + 12, CAPTURE_INDEX_MAGIC, sizeof(CAPTURE_INDEX_MAGIC)) != 0 ||
+        index_offset + (uint64_t)blocks * INDEX_ENTRY_SIZE + FOOTER_SIZE != _size
+    )
+    {
+        munmap(map, _size);
+        throw std::runtime_error("Not a complete capture file " + path);
+    }
+
+    for(uint32_t i = 0; i < blocks; i++)
+    {
+        const uint8_t *entry = _map + index_offset + i * INDEX_ENTRY_SIZE;
+        _index.push_back({getLe(entry, 8), getLe(entry + 8, 8), (uint32_t)getLe(entry + 16, 4)});
+    }
+}
+
+
+CaptureReader::~CaptureReader()
+{
+    munmap((void *)_map, _size);
+}
+
+
+const std::vector<CaptureBlock> &CaptureReader::blocks() const
+{
+    return _index;
+}
+
+
+size_t CaptureReader::findBlock(const uint64_t timestampNs) const
+{
+    // last block starting at or before the timestamp
+    auto it = std::upper_bound(
+        _index.begin(), _index.end(), timestampNs,
+        [](const uint64_t ts, const CaptureBlock &block) { return ts < block.firstTimestampNs; }
+    );
+    return it == _index.begin() ? 0 : it - _index.begin() - 1;
+}
+
+
+void CaptureReader::readBlock(const size_t block, const std::function<void(const CaptureRecord &)> &callback)
+{
+    const CaptureBlock &entry = _index.at(block);
+    if(entry.offset + BLOCK_HEADER_SIZE > _size)
+    {
+        throw std::runtime_error("Corrupted capture block.");
+    }
+
+    const uint8_t *header = _map + entry.offset;
+    const uint32_t packed_size = getLe(header, 4);
+    const uint32_t raw_size = getLe(header + 4, 4);
+    const uint32_t records = getLe(header + 8, 4);
+    uint64_t timestamp = getLe(header + 12, 8);
+
+    const uint8_t *packed = header + BLOCK_HEADER_SIZE;
+    if(entry.offset + BLOCK_HEADER_SIZE + packed_size > _size || !unpack(packed, packed + packed_size, _raw, raw_size))
+    {
+        throw std::runtime_error("Corrupted capture block.");
+    }
+
+    const uint8_t *in = _raw.data();
+    const uint8_t *end = in + _raw.size();
+    for(uint32_t i = 0; i < records; i++)
+    {
+        uint64_t delta;
+        if(!getVarint(in, end, delta) || end - in < 3)
+        {
+            throw std::runtime_error("Corrupted capture block.");
+        }
+        timestamp += delta;
+
+        CaptureRecord record;
+        record.timestampNs = timestamp;
+        record.busId = in[0];
+        record.direction = (TraceDirection)in[1];
+        record.length = in[2];
+        record.frame = in + 3;
+        in += 3;
+        if(end - in < record.length)
+        {
+            throw std::runtime_error("Corrupted capture block.");
+        }
+        in += record.length;
+
+        callback(record);
+    }
+}
+
+
+void CaptureReader::forEach(const std::function<void(const CaptureRecord &)> &callback)
+{
+    for(size_t i = 0; i < _index.size(); i++)
+    {
+        readBlock(i, callback);
+    }
+}
+
+
+ReplayEngine::ReplayEngine(CaptureReader &capture) : _capture(capture)
+{
+}
+
+
+ReplayEngine::~ReplayEngine()
+{
+}
+
+
+ReplayStats ReplayEngine::run(
+    const ReplaySpeed speed,
+    Network *output,
+    const std::function<void(const CaptureRecord &, const Message *)> &handler
+)
+{
+    using namespace std::chrono;
+
+    ReplayStats stats;
+    const auto start = steady_clock::now();
+    bool first = true;
+    uint64_t first_timestamp = 0;
+    Packet packet;
+    std::vector<uint8_t> bytes;
+
+    _capture.forEach([&](const CaptureRecord &record)
+    {
+        if(first)
+        {
+            first_timestamp = record.timestampNs;
+            first = false;
+        }
+
+        if(speed == REPLAY_ORIGINAL_TIMING)
+        {
+            std::this_thread::sleep_until(start + nanoseconds(record.timestampNs - first_timestamp));
+        }
+
+        stats.frames++;
+        stats.bytes += record.length;
+
+        bytes.assign(record.frame, record.frame + record.length);
+        packet.setData(bytes);
+
+        if(packetIsValidMessage(packet) && packet.isValidPacket())
+        {
+            stats.validFrames++;
+            const Message message(packet);
+            if(handler)
+            {
+                handler(record, &message);
+            }
+            if(output != nullptr)
+            {
+                output->sendData(packet);
+            }
+        }
+        else
+        {
+            stats.corruptedFrames++;
+            if(handler)
+            {
+                handler(record, nullptr);
+            }
+        }
+    });
+
+    stats.seconds = duration<double>(steady_clock::now() - start).count();
+    return stats;
+}
+
+
+} // namespace Xerxes
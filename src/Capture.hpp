@@ -0,0 +1,246 @@
+#ifndef __CAPTURE_HPP
+#define __CAPTURE_HPP
+
+#include <cstdint>
+#include <stddef.h>
+#include <cstdio>
+#include <functional>
+#include <string>
+#include <vector>
+#include "Trace.hpp"
+#include "Network.hpp"
+#include "Message.hpp"
+
+namespace Xerxes
+{
+
+
+/// @brief Magic bytes at the beginning of a capture file
+constexpr char CAPTURE_FILE_MAGIC[4] = {'X', 'C', 'A', 'P'};
+
+/// @brief Magic bytes at the end of a capture file
+constexpr char CAPTURE_INDEX_MAGIC[4] = {'X', 'C', 'I', 'X'};
+
+/// @brief Version of the capture file format
+constexpr uint8_t CAPTURE_FILE_VERSION = 1;
+
+
+/**
+ * @brief One captured frame, the frame points into the decoded block
+ *
+ */
+struct CaptureRecord
+{
+    /// @brief timestamp in nanoseconds
+    uint64_t timestampNs;
+    /// @brief bus the frame was captured on
+    uint8_t busId;
+    TraceDirection direction;
+    /// @brief number of bytes of the frame
+    uint8_t length;
+    /// @brief raw bytes SOH..CHECKSUM
+    const uint8_t *frame;
+};
+
+
+/**
+ * @brief Entry of the block index of a capture file
+ *
+ */
+struct CaptureBlock
+{
+    /// @brief offset of the block header in the file
+    uint64_t offset;
+    /// @brief timestamp of the first record of the block
+    uint64_t firstTimestampNs;
+    /// @brief number of records in the block
+    uint32_t records;
+};
+
+
+/**
+ * @brief Writer of capture files
+ *
+ * Capture file format, all integers little endian:
+ *
+ *     FILE   := HEADER BLOCK* INDEX FOOTER
+ *     HEADER := "XCAP" | VERSION u8 | RESERVED u8[3]
+ *     BLOCK  := PACKED_SIZE u32 | RAW_SIZE u32 | RECORDS u32 | FIRST_TIMESTAMP_NS u64 | PACKED[PACKED_SIZE]
+ *     INDEX  := (BLOCK_OFFSET u64 | FIRST_TIMESTAMP_NS u64 | RECORDS u32)*
+ *     FOOTER := INDEX_OFFSET u64 | BLOCKS u32 | "XCIX"
+ *
+ * The raw block is a sequence of records:
+ *
+ *     RECORD := TIMESTAMP_DELTA varint | BUS_ID u8 | DIRECTION u8 | LEN u8 | FRAME[LEN]
+ *
+ * where the delta of the first record is taken from FIRST_TIMESTAMP_NS. The raw block is
+ * packed with a byte-oriented LZ77 scheme:
+ *
+ *     SEQUENCE := LITERALS varint | LITERAL[LITERALS] | MATCH_LENGTH - 4 varint | MATCH_OFFSET u16
+ *
+ * the last sequence ends after its literals, once RAW_SIZE bytes were produced. Polling
+ * traffic repeats the same frames over and over, so it packs very well.
+ */
+class CaptureWriter
+{
+private:
+    FILE *_file;
+    size_t _blockSize;
+    uint64_t _offset;
+
+    std::vector<uint8_t> _raw;
+    std::vector<uint8_t> _packed;
+    uint32_t _records = 0;
+    uint64_t _firstTimestamp = 0;
+    uint64_t _lastTimestamp = 0;
+
+    std::vector<CaptureBlock> _index;
+
+    void flushBlock();
+
+public:
+    /**
+     * @brief Construct a new Capture Writer object
+     *
+     * @param path capture file to create
+     * @param blockSize size of a raw block before packing
+     * @throw std::runtime_error if the file can not be created
+     */
+    CaptureWriter(const std::string &path, const size_t blockSize = 1 << 16);
+
+    /// @brief Close the file if not closed yet
+    ~CaptureWriter();
+
+    /**
+     * @brief Add a frame to the capture, timestamps must not decrease
+     *
+     * @param timestampNs timestamp in nanoseconds
+     * @param busId bus the frame was captured on
+     * @param direction direction of the frame
+     * @param frame raw bytes SOH..CHECKSUM
+     * @param length number of bytes, frames longer than MAX_FRAME_SIZE are truncated
+     */
+    void write(
+        const uint64_t timestampNs,
+        const uint8_t busId,
+        const TraceDirection direction,
+        const uint8_t *frame,
+        const size_t length
+    );
+
+    /**
+     * @brief Write the last block, the index and the footer and close the file
+     *
+     * @return true if everything was written
+     */
+    bool close();
+};
+
+
+/**
+ * @brief Memory-mapped reader of capture files
+ *
+ */
+class CaptureReader
+{
+private:
+    const uint8_t *_map = nullptr;
+    size_t _size = 0;
+    std::vector<CaptureBlock> _index;
+    std::vector<uint8_t> _raw;
+
+public:
+    /**
+     * @brief Map a capture file
+     *
+     * @param path capture file
+     * @throw std::runtime_error if the file can not be mapped or is not a complete capture
+     */
+    CaptureReader(const std::string &path);
+    ~CaptureReader();
+
+    /// @brief Block index of the capture
+    const std::vector<CaptureBlock> &blocks() const;
+
+    /// @brief Index of the block holding the first record at or after the timestamp
+    size_t findBlock(const uint64_t timestampNs) const;
+
+    /**
+     * @brief Decode a block and call the callback for each of its records
+     *
+     * The records point into a buffer reused for the next block.
+     *
+     * @param block index of the block
+     * @param callback called for each record in order
+     * @throw std::runtime_error if the block is corrupted
+     */
+    void readBlock(const size_t block, const std::function<void(const CaptureRecord &)> &callback);
+
+    /// @brief Decode all blocks in order
+    void forEach(const std::function<void(const CaptureRecord &)> &callback);
+};
+
+
+/**
+ * @brief Replay speed of the ReplayEngine
+ *
+ */
+enum ReplaySpeed : uint8_t
+{
+    /// @brief keep the original spacing of the frames
+    REPLAY_ORIGINAL_TIMING = 0,
+    /// @brief replay as fast as possible
+    REPLAY_MAX_SPEED
+};
+
+
+/**
+ * @brief Result of a replay
+ *
+ */
+struct ReplayStats
+{
+    uint64_t frames = 0;
+    uint64_t validFrames = 0;
+    uint64_t corruptedFrames = 0;
+    uint64_t bytes = 0;
+    /// @brief wall time of the replay
+    double seconds = 0;
+};
+
+
+/**
+ * @brief Replays a capture through the decode path of the library
+ *
+ * Every frame is validated as a Packet and parsed into a Message, then handed to the
+ * handler and, if valid, sent to the output network. Used to reproduce field incidents
+ * and to benchmark the decode path on real traffic.
+ */
+class ReplayEngine
+{
+private:
+    CaptureReader &_capture;
+
+public:
+    ReplayEngine(CaptureReader &capture);
+    ~ReplayEngine();
+
+    /**
+     * @brief Replay the whole capture
+     *
+     * @param speed original timing or maximum speed
+     * @param output network to send the valid frames to, may be nullptr
+     * @param handler called for each frame with the parsed message, nullptr for a corrupted frame
+     * @return ReplayStats counters and wall time of the replay
+     */
+    ReplayStats run(
+        const ReplaySpeed speed,
+        Network *output = nullptr,
+        const std::function<void(const CaptureRecord &, const Message *)> &handler = {}
+    );
+};
+
+
+} // namespace Xerxes
+
+#endif // !__CAPTURE_HPP
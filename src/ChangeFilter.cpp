@@ -0,0 +1,210 @@
+#include "ChangeFilter.hpp"
+#include <algorithm>
+#include <stdexcept>
+
+namespace Xerxes
+{
+
+
+static bool isFloatKind(const ValueKind kind)
+{
+    return kind == VALUE_PV || kind == VALUE_AV;
+}
+
+
+ChangeFilter::ChangeFilter(const size_t leaves, const int64_t maxSilenceNs) :
+    _channels(leaves * SNAPSHOT_VALUES),
+    _maxSilenceNs(maxSilenceNs),
+    _valid(_channels),
+    _mask(_channels)
+{
+    for(size_t kind = 0; kind < VALUE_KIND_COUNT; kind++)
+    {
+        if(isFloatKind((ValueKind)kind))
+        {
+            _absolute[kind].assign(_channels, 0.0f);
+            _relative[kind].assign(_channels, 0.0f);
+            _lastFloat[kind].assign(_channels, 0.0f);
+        }
+        else
+        {
+            _watch[kind].assign(_channels, 0xffffffff);
+            _lastBits[kind].assign(_channels, 0);
+        }
+        _published[kind].assign(_channels, 0);
+        _lastMs[kind].assign(_channels, 0);
+    }
+    // filter() needs one slot more for the branch-free compaction
+    _changes.reserve(_channels * VALUE_KIND_COUNT + 1);
+}
+
+
+ChangeFilter::~ChangeFilter()
+{
+}
+
+
+void ChangeFilter::setDeadband(const ValueKind kind, const size_t channel, const float absolute, const float relative)
+{
+    if(!isFloatKind(kind))
+    {
+        throw std::invalid_argument("Deadband applies to PV and AV values only.");
+    }
+    _absolute[kind].at(channel) = absolute;
+    _relative[kind].at(channel) = relative;
+}
+
+
+void ChangeFilter::setWatchedBits(const ValueKind kind, const size_t channel, const uint32_t mask)
+{
+    if(isFloatKind(kind))
+    {
+        throw std::invalid_argument("Watched bits apply to DV and SV values only.");
+    }
+    _watch[kind].at(channel) = mask;
+}
+
+
+void ChangeFilter::setMaxSilence(const int64_t maxSilenceNs)
+{
+    _maxSilenceNs = maxSilenceNs;
+}
+
+
+void ChangeFilter::reset()
+{
+    for(size_t kind = 0; kind < VALUE_KIND_COUNT; kind++)
+    {
+        std::fill(_published[kind].begin(), _published[kind].end(), 0);
+    }
+}
+
+
+// the kernels take restrict parameters and are free of branches so the compiler can
+// vectorise them, all their operands are 32 bit wide and fabs/fmax are spelled out as
+// selects. A value is published if mask[i] is 1, its last value is updated in place.
+// Times are milliseconds, unsigned subtraction keeps the age right across the wrap.
+
+static void deadbandMask(
+    const size_t n,
+    const uint32_t nowMs,
+    const uint32_t maxSilenceMs,
+    const float *__restrict values,
+    const float *__restrict absolute,
+    const float *__restrict relative,
+    float *__restrict last,
+    uint32_t *__restrict published,
+    uint32_t *__restrict lastMs,
+    uint32_t *__restrict mask
+)
+{
+    for(size_t i = 0; i < n; i++)
+    {
+        const float x = values[i];
+        const float l = last[i];
+        const float d = x > l ? x - l : l - x;
+        const float r = relative[i] * (l < 0 ? -l : l);
+        const float band = absolute[i] > r ? absolute[i] : r;
+        const uint32_t moved = d > band;
+        const uint32_t silent = maxSilenceMs != 0 && nowMs - lastMs[i] >= maxSilenceMs;
+        const uint32_t fresh = published[i] == 0;
+        // NaN is a missing value and is never published
+        const uint32_t valid = x == x;
+        const uint32_t m = (moved | silent | fresh) & valid;
+        last[i] = m ? x : l;
+        lastMs[i] = m ? nowMs : lastMs[i];
+        published[i] |= m;
+        mask[i] = m;
+    }
+}
+
+
+static void bitsMask(
+    const size_t n,
+    const uint32_t nowMs,
+    const uint32_t maxSilenceMs,
+    const uint32_t *__restrict values,
+    const uint32_t *__restrict watch,
+    const uint32_t *__restrict valid,
+    uint32_t *__restrict last,
+    uint32_t *__restrict published,
+    uint32_t *__restrict lastMs,
+    uint32_t *__restrict mask
+)
+{
+    for(size_t i = 0; i < n; i++)
+    {
+        const uint32_t x = values[i];
+        const uint32_t l = last[i];
+        const uint32_t flipped = ((x ^ l) & watch[i]) != 0;
+        const uint32_t silent = maxSilenceMs != 0 && nowMs - lastMs[i] >= maxSilenceMs;
+        const uint32_t fresh = published[i] == 0;
+        const uint32_t m = (flipped | silent | fresh) & valid[i];
+        last[i] = m ? x : l;
+        lastMs[i] = m ? nowMs : lastMs[i];
+        published[i] |= m;
+        mask[i] = m;
+    }
+}
+
+
+/// @brief append the channels selected by the mask, branch-free
+static size_t compact(const size_t n, const uint32_t *mask, const ValueKind kind, ChangedValue *out)
+{
+    size_t count = 0;
+    for(size_t i = 0; i < n; i++)
+    {
+        out[count] = ChangedValue{kind, (uint32_t)i};
+        count += mask[i];
+    }
+    return count;
+}
+
+
+const std::vector<ChangedValue> &ChangeFilter::filter(const BusSnapshot &snapshot)
+{
+    if(snapshot.pv.size() != _channels)
+    {
+        throw std::invalid_argument("Snapshot does not match the filter.");
+    }
+
+    const uint32_t now = (uint32_t)(snapshot.syncTimestampNs / 1000000);
+    const uint32_t silence = (uint32_t)(_maxSilenceNs / 1000000);
+    for(size_t i = 0; i < _channels; i++)
+    {
+        _valid[i] = !snapshot.missed[i / SNAPSHOT_VALUES];
+    }
+
+    // room for every channel plus the slot overwritten by the branch-free compaction
+    _changes.resize(_channels * VALUE_KIND_COUNT + 1);
+    size_t count = 0;
+
+    for(size_t kind = 0; kind < VALUE_KIND_COUNT; kind++)
+    {
+        if(isFloatKind((ValueKind)kind))
+        {
+            const float *values = kind == VALUE_PV ? snapshot.pv.data() : snapshot.av.data();
+            deadbandMask(
+                _channels, now, silence, values,
+                _absolute[kind].data(), _relative[kind].data(), _lastFloat[kind].data(),
+                _published[kind].data(), _lastMs[kind].data(), _mask.data()
+            );
+        }
+        else
+        {
+            const uint32_t *values = kind == VALUE_DV ? snapshot.dv.data() : (const uint32_t *)snapshot.sv.data();
+            bitsMask(
+                _channels, now, silence, values,
+                _watch[kind].data(), _valid.data(), _lastBits[kind].data(),
+                _published[kind].data(), _lastMs[kind].data(), _mask.data()
+            );
+        }
+        count += compact(_channels, _mask.data(), (ValueKind)kind, _changes.data() + count);
+    }
+
+    _changes.resize(count);
+    return _changes;
+}
+
+
+} // namespace Xerxes
@@ -0,0 +1,120 @@
+#ifndef __CHANGE_FILTER_HPP
+#define __CHANGE_FILTER_HPP
+
+#include <vector>
+#include <cstdint>
+#include <stddef.h>
+#include "Snapshot.hpp"
+
+namespace Xerxes
+{
+
+
+/**
+ * @brief Kind of a value of a bus snapshot
+ *
+ */
+enum ValueKind : uint8_t
+{
+    VALUE_PV = 0,
+    VALUE_DV,
+    VALUE_AV,
+    VALUE_SV,
+    VALUE_KIND_COUNT
+};
+
+
+/**
+ * @brief Value selected for publishing, read its value from the snapshot
+ *
+ */
+struct ChangedValue
+{
+    ValueKind kind;
+    /// @brief index into the array of the kind, leaf index * SNAPSHOT_VALUES + value
+    uint32_t channel;
+};
+
+
+/**
+ * @brief Selects the values of a bus snapshot worth publishing
+ *
+ * A value is published when:
+ * - PV and AV: it moved away from the last published value by more than
+ *   max(absolute, relative * |last published|)
+ * - DV and SV: any watched bit changed since the last published value
+ * - it was not published for longer than the maximal silence (heartbeat)
+ * - it was never published before
+ *
+ * Values of leaves which missed the cycle are never published. Each kind is filtered by a
+ * branch-free kernel over the contiguous snapshot array which writes a mask, the mask is
+ * then compacted into a preallocated list, so filtering does not allocate.
+ */
+class ChangeFilter
+{
+private:
+    size_t _channels;
+    int64_t _maxSilenceNs;
+
+    std::vector<float> _absolute[VALUE_KIND_COUNT];
+    std::vector<float> _relative[VALUE_KIND_COUNT];
+    std::vector<uint32_t> _watch[VALUE_KIND_COUNT];
+
+    std::vector<float> _lastFloat[VALUE_KIND_COUNT];
+    std::vector<uint32_t> _lastBits[VALUE_KIND_COUNT];
+    std::vector<uint32_t> _published[VALUE_KIND_COUNT];
+    /// @brief time of the last publishing in milliseconds, wraps around
+    std::vector<uint32_t> _lastMs[VALUE_KIND_COUNT];
+
+    std::vector<uint32_t> _valid;
+    std::vector<uint32_t> _mask;
+    std::vector<ChangedValue> _changes;
+
+public:
+    /**
+     * @brief Construct a new Change Filter object, all deadbands are 0 and all bits are watched
+     *
+     * @param leaves number of leaves of the snapshots
+     * @param maxSilenceNs longest time a value may stay unpublished, 0 disables the heartbeat,
+     * it is resolved in milliseconds and must be shorter than 49 days
+     */
+    ChangeFilter(const size_t leaves, const int64_t maxSilenceNs = 0);
+    ~ChangeFilter();
+
+    /**
+     * @brief Set the deadband of a PV or AV channel
+     *
+     * @param kind VALUE_PV or VALUE_AV
+     * @param channel channel index
+     * @param absolute smallest absolute change to publish
+     * @param relative smallest change relative to the last published value, eg. 0.01 for 1 %
+     */
+    void setDeadband(const ValueKind kind, const size_t channel, const float absolute, const float relative);
+
+    /**
+     * @brief Set the bits of a DV or SV channel whose change is published, all bits by default
+     *
+     * @param kind VALUE_DV or VALUE_SV
+     * @param channel channel index
+     * @param mask watched bits
+     */
+    void setWatchedBits(const ValueKind kind, const size_t channel, const uint32_t mask);
+
+    void setMaxSilence(const int64_t maxSilenceNs);
+
+    /**
+     * @brief Select the changed values of the snapshot and remember them as published
+     *
+     * @param snapshot snapshot of the bus
+     * @return const std::vector<ChangedValue>& values to publish, valid until the next call
+     */
+    const std::vector<ChangedValue> &filter(const BusSnapshot &snapshot);
+
+    /// @brief Forget the published values, the next snapshot is published completely
+    void reset();
+};
+
+
+} // namespace Xerxes
+
+#endif // !__CHANGE_FILTER_HPP
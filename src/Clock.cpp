@@ -0,0 +1,136 @@
+#include "Clock.hpp"
+#include "Master.hpp"
+#include <algorithm>
+#include <chrono>
+#include <time.h>
+
+namespace Xerxes
+{
+
+
+/// @brief SOH | LEN | SRC | DST | MSGID_L | MSGID_H | CHECKSUM, same for SYNC and PING
+constexpr size_t EMPTY_FRAME_SIZE = 7;
+
+/// @brief PING_REPLY carries the device id and the version
+constexpr size_t PING_REPLY_FRAME_SIZE = EMPTY_FRAME_SIZE + 3;
+
+
+int64_t steadyNowNs()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()
+    ).count();
+}
+
+
+int64_t realtimeToSteadyNs(const int64_t realtimeNs)
+{
+    // sample both clocks as close as possible, the realtime clock is read twice around the steady one
+    timespec before, after;
+    clock_gettime(CLOCK_REALTIME, &before);
+    const int64_t steady = steadyNowNs();
+    clock_gettime(CLOCK_REALTIME, &after);
+
+    const int64_t realtime = ((int64_t)before.tv_sec * 1000000000 + before.tv_nsec +
+        (int64_t)after.tv_sec * 1000000000 + after.tv_nsec) / 2;
+    return realtimeNs - realtime + steady;
+}
+
+
+int64_t frameTimeNs(const size_t bytes, const uint32_t baudRate)
+{
+    if(baudRate == 0)
+    {
+        return 0;
+    }
+    return (int64_t)bytes * 10 * 1000000000 / baudRate;
+}
+
+
+ClockCorrelator::ClockCorrelator(const uint32_t baudRate) : _baudRate(baudRate)
+{
+}
+
+
+ClockCorrelator::~ClockCorrelator()
+{
+}
+
+
+void ClockCorrelator::addRoundTrip(const uint8_t leaf, const int64_t txNs, const int64_t rxNs, const size_t requestBytes, const size_t replyBytes)
+{
+    // time spent on the wire is known from the baud rate, the rest is split evenly
+    const int64_t roundTrip = rxNs - txNs - frameTimeNs(requestBytes, _baudRate) - frameTimeNs(replyBytes, _baudRate);
+
+    std::array<int64_t, CORRELATOR_WINDOW> &window = _roundTrips[leaf];
+    window[_next[leaf]] = std::max<int64_t>(roundTrip, 0);
+    _next[leaf] = (_next[leaf] + 1) % CORRELATOR_WINDOW;
+    _count[leaf] = std::min<size_t>(_count[leaf] + 1, CORRELATOR_WINDOW);
+    updateOneWay(leaf);
+}
+
+
+void ClockCorrelator::updateOneWay(const uint8_t leaf)
+{
+    if(_count[leaf] == 0)
+    {
+        return;
+    }
+    const int64_t fastest = *std::min_element(_roundTrips[leaf].begin(), _roundTrips[leaf].begin() + _count[leaf]);
+    _oneWayNs[leaf] = std::max<int64_t>(fastest - _turnaroundNs[leaf], 0) / 2;
+}
+
+
+size_t ClockCorrelator::calibrate(Master &master, const uint8_t leaf, const size_t rounds)
+{
+    size_t added = 0;
+    for(size_t i = 0; i < rounds; i++)
+    {
+        const Result<ping_reply_t> reply = master.tryPing(leaf);
+        if(!reply)
+        {
+            // a lost ping says nothing about the delay
+            continue;
+        }
+        addRoundTrip(leaf, reply->tx_ns, reply->rx_ns, EMPTY_FRAME_SIZE, PING_REPLY_FRAME_SIZE);
+        added++;
+    }
+    return added;
+}
+
+
+void ClockCorrelator::setTurnaround(const uint8_t leaf, const int64_t turnaroundNs)
+{
+    _turnaroundNs[leaf] = turnaroundNs;
+    updateOneWay(leaf);
+}
+
+
+void ClockCorrelator::setSamplingDelay(const uint8_t leaf, const int64_t delayNs)
+{
+    _samplingDelayNs[leaf] = delayNs;
+}
+
+
+int64_t ClockCorrelator::oneWayDelayNs(const uint8_t leaf) const
+{
+    return _oneWayNs[leaf];
+}
+
+
+int64_t ClockCorrelator::samplingInstantNs(const uint8_t leaf, const int64_t syncTxNs) const
+{
+    return syncTxNs + frameTimeNs(EMPTY_FRAME_SIZE, _baudRate) + _oneWayNs[leaf] + _samplingDelayNs[leaf];
+}
+
+
+void ClockCorrelator::samplingInstants(const uint8_t *leaves, const size_t count, const int64_t syncTxNs, int64_t *instantsNs) const
+{
+    for(size_t i = 0; i < count; i++)
+    {
+        instantsNs[i] = samplingInstantNs(leaves[i], syncTxNs);
+    }
+}
+
+
+} // namespace Xerxes
@@ -0,0 +1,133 @@
+#ifndef __CLOCK_HPP
+#define __CLOCK_HPP
+
+#include <array>
+#include <cstdint>
+#include <stddef.h>
+
+namespace Xerxes
+{
+
+
+class Master;
+
+
+/// @brief Current time of the steady clock in nanoseconds, the time base of all frame timestamps
+int64_t steadyNowNs();
+
+/**
+ * @brief Convert a CLOCK_REALTIME timestamp to the steady clock
+ *
+ * Kernel timestamps of sockets (SO_TIMESTAMPNS) are taken on the realtime clock, a
+ * Network implementation converts them before it stores them in the Packet.
+ *
+ * @param realtimeNs realtime timestamp in nanoseconds
+ * @return int64_t the same instant on the steady clock in nanoseconds
+ */
+int64_t realtimeToSteadyNs(const int64_t realtimeNs);
+
+/**
+ * @brief Time a frame takes on a serial line, 10 bits per byte (start, 8 data, stop)
+ *
+ * @param bytes size of the frame
+ * @param baudRate baud rate of the line, 0 for an instant transfer
+ * @return int64_t duration in nanoseconds
+ */
+int64_t frameTimeNs(const size_t bytes, const uint32_t baudRate);
+
+
+/// @brief Number of round trips per leaf the clock correlator keeps the minimum of
+constexpr size_t CORRELATOR_WINDOW = 32;
+
+
+/**
+ * @brief Estimates when each leaf samples relative to the SYNC sent by the host
+ *
+ * The host time of SYNC is known exactly from the TX timestamp, a leaf samples when the
+ * SYNC frame reached it plus its own reaction time:
+ *
+ *     sampling = syncTx + frameTime(SYNC) + oneWayDelay + samplingDelay
+ *
+ * The one-way delay is half of the round trip without the frame times on the wire and
+ * the turnaround of the leaf, taken from the fastest of the last CORRELATOR_WINDOW round
+ * trips of the leaf, since the fastest one carries the least scheduling noise. The
+ * turnaround and the sampling delay are reaction times of the firmware, set per leaf if
+ * known.
+ */
+class ClockCorrelator
+{
+private:
+    uint32_t _baudRate;
+
+    std::array<std::array<int64_t, CORRELATOR_WINDOW>, 256> _roundTrips;
+    std::array<uint8_t, 256> _next {};
+    std::array<uint8_t, 256> _count {};
+    std::array<int64_t, 256> _oneWayNs {};
+    std::array<int64_t, 256> _samplingDelayNs {};
+    std::array<int64_t, 256> _turnaroundNs {};
+
+    void updateOneWay(const uint8_t leaf);
+
+public:
+    /**
+     * @brief Construct a new Clock Correlator object
+     *
+     * @param baudRate baud rate of the bus, 0 if the frame time is negligible
+     */
+    ClockCorrelator(const uint32_t baudRate = 0);
+    ~ClockCorrelator();
+
+    /**
+     * @brief Add a measured round trip of a leaf
+     *
+     * @param leaf address of the leaf
+     * @param txNs TX timestamp of the request
+     * @param rxNs RX timestamp of the reply
+     * @param requestBytes size of the request frame
+     * @param replyBytes size of the reply frame
+     */
+    void addRoundTrip(const uint8_t leaf, const int64_t txNs, const int64_t rxNs, const size_t requestBytes, const size_t replyBytes);
+
+    /**
+     * @brief Measure the round trips of a leaf with pings
+     *
+     * @param master master of the bus
+     * @param leaf address of the leaf
+     * @param rounds number of pings, failed pings are skipped
+     * @return size_t number of round trips added
+     */
+    size_t calibrate(Master &master, const uint8_t leaf, const size_t rounds = CORRELATOR_WINDOW);
+
+    /// @brief Set the time the leaf takes from receiving a request to sending the reply
+    void setTurnaround(const uint8_t leaf, const int64_t turnaroundNs);
+
+    /// @brief Set the reaction time of the firmware of the leaf to SYNC
+    void setSamplingDelay(const uint8_t leaf, const int64_t delayNs);
+
+    /// @brief Estimated one-way delay from the host to the leaf, 0 without round trips
+    int64_t oneWayDelayNs(const uint8_t leaf) const;
+
+    /**
+     * @brief Estimate the sampling instant of a leaf on the host steady clock
+     *
+     * @param leaf address of the leaf
+     * @param syncTxNs TX timestamp of the SYNC, as returned by Master::sync()
+     * @return int64_t sampling instant in nanoseconds
+     */
+    int64_t samplingInstantNs(const uint8_t leaf, const int64_t syncTxNs) const;
+
+    /**
+     * @brief Estimate the sampling instants of many leaves
+     *
+     * @param leaves addresses of the leaves
+     * @param count number of leaves
+     * @param syncTxNs TX timestamp of the SYNC
+     * @param instantsNs count sampling instants in nanoseconds
+     */
+    void samplingInstants(const uint8_t *leaves, const size_t count, const int64_t syncTxNs, int64_t *instantsNs) const;
+};
+
+
+} // namespace Xerxes
+
+#endif // !__CLOCK_HPP
@@ -0,0 +1,536 @@
+#include "Daemon.hpp"
+#include "Clock.hpp"
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace Xerxes
+{
+
+
+static size_t regionSize(const uint16_t slots)
+{
+    return sizeof(DaemonRegion) + (size_t)slots * sizeof(DaemonSlot);
+}
+
+
+static DaemonSlot *slotsOf(DaemonRegion *region)
+{
+    return (DaemonSlot *)(region + 1);
+}
+
+
+static const DaemonSlot *slotsOf(const DaemonRegion *region)
+{
+    return (const DaemonSlot *)(region + 1);
+}
+
+
+static uint32_t rangeKey(const uint8_t address, const uint16_t offset, const uint8_t size)
+{
+    return (uint32_t)address << 24 | (uint32_t)offset << 8 | size;
+}
+
+
+/// @brief send the reply with its padding zeroed, no stale daemon memory leaves the process
+static void sendReply(const int client, const DaemonReply &reply)
+{
+    DaemonReply wire;
+    memset(&wire, 0, sizeof(wire));
+    wire.id = reply.id;
+    wire.error = reply.error;
+    wire.slot = reply.slot;
+    wire.sequence = reply.sequence;
+    // a client which does not read its replies is dropped on its next hangup
+    send(client, &wire, sizeof(wire), MSG_DONTWAIT | MSG_NOSIGNAL);
+}
+
+
+static sockaddr_un socketAddress(const std::string &path)
+{
+    sockaddr_un address {};
+    address.sun_family = AF_UNIX;
+    if(path.size() >= sizeof(address.sun_path))
+    {
+        throw std::runtime_error("Socket path too long " + path);
+    }
+    memcpy(address.sun_path, path.c_str(), path.size() + 1);
+    return address;
+}
+
+
+BusDaemon::BusDaemon(Master &master, const std::string &path, const uint16_t slots) :
+    _master(master), _path(path)
+{
+    if(slots == 0)
+    {
+        throw std::invalid_argument("Daemon needs at least one slot.");
+    }
+
+    const sockaddr_un address = socketAddress(path);
+
+    // the memory is passed to the clients on connect, so it needs no name
+    _regionSize = regionSize(slots);
+    _memory = memfd_create("xerxes-bus", MFD_CLOEXEC);
+    if(_memory < 0 || ftruncate(_memory, _regionSize) != 0)
+    {
+        if(_memory >= 0)
+        {
+            close(_memory);
+        }
+        throw std::runtime_error("Can not allocate shared memory for " + path);
+    }
+    void *map = mmap(nullptr, _regionSize, PROT_READ | PROT_WRITE, MAP_SHARED, _memory, 0);
+    if(map == MAP_FAILED)
+    {
+        close(_memory);
+        throw std::runtime_error("Can not map shared memory for " + path);
+    }
+    _region = (DaemonRegion *)map;
+    memcpy(_region->magic, DAEMON_MAGIC, sizeof(DAEMON_MAGIC));
+    _region->version = DAEMON_VERSION;
+    _region->slots = slots;
+
+    _listen = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    unlink(path.c_str());
+    if(_listen < 0 || bind(_listen, (const sockaddr *)&address, sizeof(address)) != 0 || listen(_listen, 16) != 0 ||
+        pipe2(_wake, O_NONBLOCK | O_CLOEXEC) != 0)
+    {
+        if(_listen >= 0)
+        {
+            close(_listen);
+        }
+        munmap(_region, _regionSize);
+        close(_memory);
+        throw std::runtime_error("Can not listen on " + path);
+    }
+}
+
+
+BusDaemon::~BusDaemon()
+{
+    for(const int client : _clients)
+    {
+        close(client);
+    }
+    close(_listen);
+    close(_wake[0]);
+    close(_wake[1]);
+    unlink(_path.c_str());
+    munmap(_region, _regionSize);
+    close(_memory);
+}
+
+
+void BusDaemon::accept()
+{
+    int client;
+    while((client = accept4(_listen, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC)) >= 0)
+    {
+        // hello: magic with the shared memory attached
+        char control[CMSG_SPACE(sizeof(int))] = {};
+        iovec iov {(void *)DAEMON_MAGIC, sizeof(DAEMON_MAGIC)};
+        msghdr message {};
+        message.msg_iov = &iov;
+        message.msg_iovlen = 1;
+        message.msg_control = control;
+        message.msg_controllen = sizeof(control);
+        cmsghdr *header = CMSG_FIRSTHDR(&message);
+        header->cmsg_level = SOL_SOCKET;
+        header->cmsg_type = SCM_RIGHTS;
+        header->cmsg_len = CMSG_LEN(sizeof(int));
+        memcpy(CMSG_DATA(header), &_memory, sizeof(int));
+
+        if(sendmsg(client, &message, MSG_NOSIGNAL) != sizeof(DAEMON_MAGIC))
+        {
+            close(client);
+            continue;
+        }
+        _clients.push_back(client);
+        _connected++;
+    }
+}
+
+
+bool BusDaemon::receive(const int client)
+{
+    while(true)
+    {
+        // a fresh request per datagram, so a short one never carries bytes of the previous one
+        Pending pending {client, 0, {}};
+        const ssize_t length = recv(client, &pending.request, sizeof(pending.request), MSG_DONTWAIT);
+        if(length < 0)
+        {
+            return errno == EAGAIN || errno == EWOULDBLOCK;
+        }
+        if(length == 0)
+        {
+            return false;
+        }
+        if((size_t)length < DAEMON_REQUEST_HEADER)
+        {
+            continue;
+        }
+        pending.length = length;
+        _pending.push_back(pending);
+    }
+}
+
+
+void BusDaemon::publish(const uint16_t slot, const DaemonRequest &request, const uint8_t *data, const int64_t timestampNs)
+{
+    DaemonSlot &target = slotsOf(_region)[slot];
+    const uint32_t sequence = target.sequence.load(std::memory_order_relaxed);
+    target.sequence.store(sequence + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    target.address = request.address;
+    target.size = request.size;
+    target.offset = request.offset;
+    target.timestampNs = timestampNs;
+    memcpy(target.data, data, request.size);
+
+    target.sequence.store(sequence + 2, std::memory_order_release);
+}
+
+
+DaemonReply BusDaemon::read(const DaemonRequest &request)
+{
+    DaemonReply reply {request.id, 0, 0, 0};
+    if(request.size == 0 || request.size > MAX_READ_SIZE)
+    {
+        reply.error = ERROR_NOK;
+        return reply;
+    }
+
+    uint8_t data[MAX_READ_SIZE];
+    _transactions++;
+    Result<void> done = _master.tryReadMemory(request.address, request.offset, request.size, data);
+    if(!done)
+    {
+        reply.error = done.error();
+        return reply;
+    }
+
+    const uint32_t key = rangeKey(request.address, request.offset, request.size);
+    auto found = _slotOf.find(key);
+    if(found == _slotOf.end())
+    {
+        // slots are reused round robin, a client which finds another range in its slot asks again
+        const uint16_t slot = _nextSlot;
+        _nextSlot = (_nextSlot + 1) % _region->slots;
+        std::erase_if(_slotOf, [slot](const auto &entry) { return entry.second == slot; });
+        found = _slotOf.emplace(key, slot).first;
+    }
+
+    reply.slot = found->second;
+    publish(reply.slot, request, data, steadyNowNs());
+    reply.sequence = slotsOf(_region)[reply.slot].sequence.load(std::memory_order_relaxed);
+    return reply;
+}
+
+
+void BusDaemon::serve()
+{
+    // reads of one range drained together are served by the first transaction
+    std::unordered_map<uint32_t, DaemonReply> served;
+
+    for(const Pending &pending : _pending)
+    {
+        const DaemonRequest &request = pending.request;
+        DaemonReply reply {request.id, 0, 0, 0};
+        _requests++;
+
+        if(request.op == DAEMON_READ)
+        {
+            const uint32_t key = rangeKey(request.address, request.offset, request.size);
+            auto found = served.find(key);
+            if(found != served.end())
+            {
+                reply = found->second;
+                reply.id = request.id;
+                _coalesced++;
+            }
+            else
+            {
+                reply = read(request);
+                served.emplace(key, reply);
+            }
+        }
+        else if(request.op == DAEMON_WRITE && request.size <= MAX_WRITE_SIZE &&
+            pending.length == DAEMON_REQUEST_HEADER + request.size)
+        {
+            _transactions++;
+            Result<void> done = _master.tryWriteMemory(request.address, request.offset, request.data, request.size);
+            reply.error = done ? 0 : done.error();
+            // later reads of the leaf must see the write
+            std::erase_if(served, [&request](const auto &entry) { return entry.first >> 24 == request.address; });
+        }
+        else
+        {
+            reply.error = ERROR_NOK;
+        }
+
+        sendReply(pending.client, reply);
+    }
+}
+
+
+size_t BusDaemon::serveOnce(const int timeoutMs)
+{
+    std::vector<pollfd> fds;
+    fds.reserve(_clients.size() + 2);
+    fds.push_back({_wake[0], POLLIN, 0});
+    fds.push_back({_listen, POLLIN, 0});
+    for(const int client : _clients)
+    {
+        fds.push_back({client, POLLIN, 0});
+    }
+
+    if(poll(fds.data(), fds.size(), timeoutMs) <= 0)
+    {
+        return 0;
+    }
+    if(fds[0].revents & POLLIN)
+    {
+        char drain[16];
+        while(::read(_wake[0], drain, sizeof(drain)) > 0)
+        {
+        }
+    }
+    if(fds[1].revents & POLLIN)
+    {
+        accept();
+    }
+
+    // drain every client before the bus is used, so concurrent reads meet in one batch
+    _pending.clear();
+    std::vector<int> gone;
+    for(size_t i = 2; i < fds.size(); i++)
+    {
+        if(fds[i].revents != 0 && !receive(fds[i].fd))
+        {
+            gone.push_back(fds[i].fd);
+        }
+    }
+
+    serve();
+
+    for(const int client : gone)
+    {
+        close(client);
+        std::erase(_clients, client);
+    }
+    return _pending.size();
+}
+
+
+void BusDaemon::run()
+{
+    while(!_stop.exchange(false))
+    {
+        serveOnce(-1);
+    }
+}
+
+
+void BusDaemon::stop()
+{
+    _stop = true;
+    const char wake = 1;
+    [[maybe_unused]] const ssize_t written = write(_wake[1], &wake, sizeof(wake));
+}
+
+
+DaemonStats BusDaemon::stats() const
+{
+    return DaemonStats{_connected.load(), _requests.load(), _transactions.load(), _coalesced.load()};
+}
+
+
+BusClient::BusClient(const std::string &path, const uint32_t timeoutUs)
+{
+    const sockaddr_un address = socketAddress(path);
+    _socket = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+    if(_socket < 0 || connect(_socket, (const sockaddr *)&address, sizeof(address)) != 0)
+    {
+        if(_socket >= 0)
+        {
+            close(_socket);
+        }
+        throw std::runtime_error("Can not connect to " + path);
+    }
+
+    const timeval timeout {(time_t)(timeoutUs / 1000000), (suseconds_t)(timeoutUs % 1000000)};
+    setsockopt(_socket, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+    char magic[sizeof(DAEMON_MAGIC)];
+    char control[CMSG_SPACE(sizeof(int))] = {};
+    iovec iov {magic, sizeof(magic)};
+    msghdr message {};
+    message.msg_iov = &iov;
+    message.msg_iovlen = 1;
+    message.msg_control = control;
+    message.msg_controllen = sizeof(control);
+
+    int memory = -1;
+    const cmsghdr *header = nullptr;
+    if(recvmsg(_socket, &message, MSG_CMSG_CLOEXEC) == sizeof(magic) &&
+        memcmp(magic, DAEMON_MAGIC, sizeof(magic)) == 0 &&
+        (header = CMSG_FIRSTHDR(&message)) != nullptr && header->cmsg_type == SCM_RIGHTS)
+    {
+        memcpy(&memory, CMSG_DATA(header), sizeof(int));
+    }
+    if(memory < 0)
+    {
+        close(_socket);
+        throw std::runtime_error("Not a bus daemon " + path);
+    }
+
+    // map the header first to learn the number of slots
+    DaemonRegion region;
+    if(pread(memory, &region, sizeof(region), 0) != sizeof(region) ||
+        memcmp(region.magic, DAEMON_MAGIC, sizeof(DAEMON_MAGIC)) != 0 || region.version != DAEMON_VERSION)
+    {
+        close(memory);
+        close(_socket);
+        throw std::runtime_error("Unsupported bus daemon " + path);
+    }
+    _regionSize = regionSize(region.slots);
+    void *map = mmap(nullptr, _regionSize, PROT_READ, MAP_SHARED, memory, 0);
+    close(memory);
+    if(map == MAP_FAILED)
+    {
+        close(_socket);
+        throw std::runtime_error("Can not map shared memory of " + path);
+    }
+    _region = (const DaemonRegion *)map;
+}
+
+
+BusClient::~BusClient()
+{
+    munmap((void *)_region, _regionSize);
+    close(_socket);
+}
+
+
+Result<DaemonReply> BusClient::transact(DaemonRequest &request)
+{
+    request.id = _nextId++;
+    const size_t length = DAEMON_REQUEST_HEADER + (request.op == DAEMON_WRITE ? request.size : 0);
+    if(send(_socket, &request, length, MSG_NOSIGNAL) != (ssize_t)length)
+    {
+        return std::unexpected(ERROR_SEND);
+    }
+
+    // replies of requests which timed out before may still arrive
+    DaemonReply reply;
+    do
+    {
+        if(recv(_socket, &reply, sizeof(reply), 0) != sizeof(reply))
+        {
+            return std::unexpected(ERROR_TIMEOUT);
+        }
+    } while(reply.id != request.id);
+
+    if(reply.error != 0)
+    {
+        return std::unexpected((XerxesError)reply.error);
+    }
+    return reply;
+}
+
+
+Result<void> BusClient::tryReadMemory(
+    const address_t address,
+    const uint16_t offset,
+    const uint8_t size,
+    uint8_t *data,
+    int64_t *timestampNs
+)
+{
+    DaemonRequest request {0, DAEMON_READ, address, offset, size, {}};
+    for(uint8_t attempt = 0; attempt < 3; attempt++)
+    {
+        Result<DaemonReply> reply = transact(request);
+        if(!reply)
+        {
+            return std::unexpected(reply.error());
+        }
+        if(reply->slot >= _region->slots)
+        {
+            return std::unexpected(ERROR_REPLY_SIZE);
+        }
+
+        const DaemonSlot &slot = slotsOf(_region)[reply->slot];
+        uint32_t before;
+        DaemonSlot copy;
+        do
+        {
+            before = slot.sequence.load(std::memory_order_acquire);
+            copy.address = slot.address;
+            copy.size = slot.size;
+            copy.offset = slot.offset;
+            copy.timestampNs = slot.timestampNs;
+            memcpy(copy.data, slot.data, std::min<uint8_t>(size, MAX_READ_SIZE));
+            std::atomic_thread_fence(std::memory_order_acquire);
+        } while(before % 2 != 0 || before != slot.sequence.load(std::memory_order_relaxed));
+
+        // the slot may already hold a newer value of the range, but not an older one
+        if(copy.address == address && copy.offset == offset && copy.size == size &&
+            (int32_t)(before - reply->sequence) >= 0)
+        {
+            memcpy(data, copy.data, size);
+            if(timestampNs != nullptr)
+            {
+                *timestampNs = copy.timestampNs;
+            }
+            return {};
+        }
+    }
+    return std::unexpected(ERROR_TIMEOUT);
+}
+
+
+std::vector<uint8_t> BusClient::readMemory(const address_t address, const uint16_t offset, const uint8_t size)
+{
+    std::vector<uint8_t> data(size);
+    Result<void> done = tryReadMemory(address, offset, size, data.data());
+    if(!done)
+    {
+        throwError(done.error(), "daemon read");
+    }
+    return data;
+}
+
+
+Result<void> BusClient::tryWriteMemory(
+    const address_t address,
+    const uint16_t offset,
+    const uint8_t *data,
+    const uint8_t size
+)
+{
+    if(size > MAX_WRITE_SIZE)
+    {
+        return std::unexpected(ERROR_SEND);
+    }
+    DaemonRequest request {0, DAEMON_WRITE, address, offset, size, {}};
+    memcpy(request.data, data, size);
+    Result<DaemonReply> reply = transact(request);
+    if(!reply)
+    {
+        return std::unexpected(reply.error());
+    }
+    return {};
+}
+
+
+} // namespace Xerxes
@@ -0,0 +1,282 @@
+#ifndef __DAEMON_HPP
+#define __DAEMON_HPP
+
+#include <atomic>
+#include <cstdint>
+#include <stddef.h>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "Master.hpp"
+#include "Registers.hpp"
+
+namespace Xerxes
+{
+
+
+/// @brief Magic bytes of the hello datagram and of the shared memory of a bus daemon
+constexpr char DAEMON_MAGIC[4] = {'X', 'B', 'U', 'S'};
+
+/// @brief Version of the daemon protocol and shared memory layout
+constexpr uint8_t DAEMON_VERSION = 1;
+
+/// @brief Timeout of a client waiting for the daemon in microseconds
+constexpr uint32_t DAEMON_CLIENT_TIMEOUT_US = 1000000;
+
+
+/**
+ * @brief Requests served by the bus daemon
+ *
+ */
+enum DaemonOp : uint8_t
+{
+    /// @brief read a memory block, the data is published in a shared memory slot
+    DAEMON_READ = 1,
+    /// @brief write a memory block with an acknowledged write
+    DAEMON_WRITE
+};
+
+
+/**
+ * @brief Datagram of a client, only the first size bytes of data are sent with a write
+ *
+ */
+struct DaemonRequest
+{
+    uint32_t id;
+    DaemonOp op;
+    uint8_t address;
+    uint16_t offset;
+    uint8_t size;
+    uint8_t data[MAX_READ_SIZE];
+};
+
+
+/// @brief Bytes of a request before its data
+constexpr size_t DAEMON_REQUEST_HEADER = offsetof(DaemonRequest, data);
+
+
+/**
+ * @brief Datagram of the daemon answering a request
+ *
+ */
+struct DaemonReply
+{
+    /// @brief id of the request
+    uint32_t id;
+    /// @brief 0 on success, XerxesError otherwise
+    uint8_t error;
+    /// @brief shared memory slot holding the data of a read
+    uint16_t slot;
+    /// @brief sequence of the slot when the data was published, newer data has a higher one
+    uint32_t sequence;
+};
+
+
+/**
+ * @brief Slot of the shared memory holding the last value of one leaf range
+ *
+ * The daemon writes the slot under a sequence lock: the sequence is odd while the
+ * slot is written, readers copy the slot and retry if the sequence changed meanwhile.
+ */
+struct DaemonSlot
+{
+    std::atomic<uint32_t> sequence;
+    uint8_t address;
+    uint8_t size;
+    uint16_t offset;
+    /// @brief steady clock time the value was read in nanoseconds
+    int64_t timestampNs;
+    uint8_t data[MAX_READ_SIZE];
+};
+
+static_assert(std::atomic<uint32_t>::is_always_lock_free, "slots are shared between processes");
+
+
+/**
+ * @brief Header of the shared memory, followed by the slots
+ *
+ */
+struct alignas(DaemonSlot) DaemonRegion
+{
+    char magic[4];
+    uint8_t version;
+    uint16_t slots;
+};
+
+
+/**
+ * @brief Counters of a bus daemon
+ *
+ */
+struct DaemonStats
+{
+    uint64_t clients = 0;
+    uint64_t requests = 0;
+    /// @brief transactions on the bus
+    uint64_t transactions = 0;
+    /// @brief reads served by a transaction of another client
+    uint64_t coalesced = 0;
+};
+
+
+/**
+ * @brief Shares the master of a bus with other processes over a Unix domain socket
+ *
+ * Clients send DaemonRequest datagrams over a SOCK_SEQPACKET socket. The daemon drains
+ * all pending requests before it touches the bus, so identical reads of one leaf range
+ * which arrive while the bus is busy are served by a single transaction. The data of a
+ * read is published in a slot of a shared memory which every client maps read only,
+ * and the reply only names the slot. The memory is passed to the client on connect.
+ *
+ * A write to a leaf makes the next read of it go to the bus again.
+ */
+class BusDaemon
+{
+private:
+    /// @brief request waiting for the bus
+    struct Pending
+    {
+        int client;
+        /// @brief bytes of the received datagram
+        size_t length;
+        DaemonRequest request;
+    };
+
+    Master &_master;
+    std::string _path;
+    int _listen = -1;
+    int _memory = -1;
+    /// @brief stop() writes into the pipe to wake run()
+    int _wake[2] = {-1, -1};
+    std::atomic<bool> _stop = false;
+
+    DaemonRegion *_region = nullptr;
+    size_t _regionSize = 0;
+    /// @brief slot of a range, keyed by address, offset and size
+    std::unordered_map<uint32_t, uint16_t> _slotOf;
+    /// @brief next slot to give to a new range
+    uint16_t _nextSlot = 0;
+
+    std::vector<int> _clients;
+    std::vector<Pending> _pending;
+
+    std::atomic<uint64_t> _connected = 0;
+    std::atomic<uint64_t> _requests = 0;
+    std::atomic<uint64_t> _transactions = 0;
+    std::atomic<uint64_t> _coalesced = 0;
+
+    void accept();
+    /// @brief read all requests of the client, false if the client is gone
+    bool receive(const int client);
+    void serve();
+    /// @brief read the range into its slot
+    DaemonReply read(const DaemonRequest &request);
+    void publish(const uint16_t slot, const DaemonRequest &request, const uint8_t *data, const int64_t timestampNs);
+
+public:
+    /**
+     * @brief Listen for clients on a Unix domain socket
+     *
+     * @param master master of the bus to share, only the daemon should use it afterwards
+     * @param path path of the socket, an existing socket is replaced
+     * @param slots number of ranges kept in the shared memory
+     * @throw std::invalid_argument if slots is zero
+     * @throw std::runtime_error if the socket or the shared memory can not be created
+     */
+    BusDaemon(Master &master, const std::string &path, const uint16_t slots = 256);
+    ~BusDaemon();
+
+    BusDaemon(const BusDaemon &) = delete;
+    BusDaemon &operator=(const BusDaemon &) = delete;
+
+    /**
+     * @brief Wait for requests once and serve them
+     *
+     * @param timeoutMs time to wait for a request in milliseconds, -1 forever
+     * @return size_t number of requests served
+     */
+    size_t serveOnce(const int timeoutMs);
+
+    /// @brief Serve clients until stop() is called
+    void run();
+
+    /// @brief Make run() return, safe to call from another thread or a signal handler
+    void stop();
+
+    DaemonStats stats() const;
+};
+
+
+/**
+ * @brief Client of a bus daemon, use one per thread
+ *
+ */
+class BusClient
+{
+private:
+    int _socket = -1;
+    const DaemonRegion *_region = nullptr;
+    size_t _regionSize = 0;
+    uint32_t _nextId = 1;
+
+    Result<DaemonReply> transact(DaemonRequest &request);
+
+public:
+    /**
+     * @brief Connect to a bus daemon and map its shared memory
+     *
+     * @param path path of the socket of the daemon
+     * @param timeoutUs time to wait for a reply of the daemon in microseconds
+     * @throw std::runtime_error if the daemon is not running
+     */
+    BusClient(const std::string &path, const uint32_t timeoutUs = DAEMON_CLIENT_TIMEOUT_US);
+    ~BusClient();
+
+    BusClient(const BusClient &) = delete;
+    BusClient &operator=(const BusClient &) = delete;
+
+    /**
+     * @brief Read a block of memory of a leaf through the daemon
+     *
+     * @param data buffer of size bytes receiving the memory block
+     * @param timestampNs set to the steady clock time the daemon read the value if not nullptr
+     * @return Result<void> nothing on success, the error of the bus transaction otherwise,
+     * ERROR_TIMEOUT or ERROR_SEND if the daemon does not answer
+     */
+    Result<void> tryReadMemory(
+        const address_t address,
+        const uint16_t offset,
+        const uint8_t size,
+        uint8_t *data,
+        int64_t *timestampNs = nullptr
+    );
+
+    /**
+     * @brief Read a block of memory of a leaf through the daemon
+     *
+     * @return std::vector<uint8_t> memory block
+     * @throw TimeoutError if the leaf or the daemon does not reply
+     * @throw std::runtime_error if the reply is invalid
+     */
+    std::vector<uint8_t> readMemory(const address_t address, const uint16_t offset, const uint8_t size);
+
+    /**
+     * @brief Write a block of memory of a leaf through the daemon, never coalesced
+     *
+     * @param size size of the block, up to MAX_WRITE_SIZE
+     * @return Result<void> nothing if the leaf acknowledged the write, the reason otherwise,
+     * ERROR_SEND if the block is too large
+     */
+    Result<void> tryWriteMemory(
+        const address_t address,
+        const uint16_t offset,
+        const uint8_t *data,
+        const uint8_t size
+    );
+};
+
+
+} // namespace Xerxes
+
+#endif // !__DAEMON_HPP
@@ -0,0 +1,338 @@
+#ifndef __DEVICE_PROFILES_HPP
+#define __DEVICE_PROFILES_HPP
+
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <initializer_list>
+#include <stddef.h>
+#include <utility>
+#include "DeviceIds.h"
+#include "MemoryMap.h"
+
+namespace Xerxes
+{
+
+
+/**
+ * @brief Data type of a channel register
+ *
+ */
+enum ChannelType : uint8_t
+{
+    CHANNEL_FLOAT = 0,
+    CHANNEL_UINT32,
+    CHANNEL_INT32
+};
+
+
+/**
+ * @brief SI unit of a channel after scaling
+ *
+ */
+enum ChannelUnit : uint8_t
+{
+    UNIT_NONE = 0,
+    UNIT_PASCAL,
+    UNIT_KELVIN,
+    UNIT_METER,
+    UNIT_DEGREE,
+    UNIT_G,
+    UNIT_COUNT,
+    UNIT_BITS
+};
+
+
+/**
+ * @brief Meaning of one register of a device
+ *
+ */
+struct ChannelProfile
+{
+    /// @brief register offset from MemoryMap.h
+    uint16_t offset;
+    ChannelType type;
+    ChannelUnit unit;
+    /// @brief factor converting the register value to the unit
+    double scale;
+    const char *name;
+};
+
+
+/// @brief Maximal number of channels of a device profile
+constexpr size_t MAX_PROFILE_CHANNELS = 4;
+
+
+/**
+ * @brief What the registers of a device mean and how to poll them
+ *
+ */
+struct DeviceProfile
+{
+    devid_t id;
+    const char *name;
+    uint8_t channelCount;
+    std::array<ChannelProfile, MAX_PROFILE_CHANNELS> channels;
+    /// @brief first register of the recommended poll range
+    uint16_t pollOffset;
+    /// @brief size of the recommended poll range, covers all channels in one read
+    uint8_t pollLength;
+};
+
+
+namespace detail
+{
+
+constexpr ChannelProfile pv(const uint16_t offset, const ChannelUnit unit, const double scale, const char *name)
+{
+    return ChannelProfile{offset, CHANNEL_FLOAT, unit, scale, name};
+}
+
+constexpr ChannelProfile dv(const uint16_t offset, const char *name)
+{
+    return ChannelProfile{offset, CHANNEL_UINT32, UNIT_BITS, 1.0, name};
+}
+
+/// @brief profile with the poll range spanning all its channels
+constexpr DeviceProfile profile(
+    const devid_t id,
+    const char *name,
+    std::initializer_list<ChannelProfile> channels
+)
+{
+    DeviceProfile p{id, name, 0, {}, 0, 0};
+    uint16_t first = 0xffff;
+    uint16_t last = 0;
+    for(const auto &channel : channels)
+    {
+        p.channels[p.channelCount++] = channel;
+        first = channel.offset < first ? channel.offset : first;
+        last = channel.offset + 4 > last ? channel.offset + 4 : last;
+    }
+    p.pollOffset = p.channelCount ? first : 0;
+    p.pollLength = p.channelCount ? last - first : 0;
+    return p;
+}
+
+constexpr double MILLI = 1e-3;
+constexpr double MICRO = 1e-6;
+
+constexpr DeviceProfile knownProfiles[] = {
+    profile(DEVID_TEMP_DS18B20, "DS18B20", {
+        pv(PV0_OFFSET, UNIT_KELVIN, MILLI, "temperature"),
+    }),
+    profile(DEVID_PRESSURE_600MBAR, "PRESSURE_600MBAR", {
+        pv(PV0_OFFSET, UNIT_PASCAL, 1.0, "pressure"),
+        pv(PV1_OFFSET, UNIT_KELVIN, MILLI, "temperature_ext_1"),
+        pv(PV2_OFFSET, UNIT_KELVIN, MILLI, "temperature_ext_2"),
+    }),
+    profile(DEVID_PRESSURE_60MBAR, "PRESSURE_60MBAR", {
+        pv(PV0_OFFSET, UNIT_PASCAL, 1.0, "pressure"),
+        pv(PV1_OFFSET, UNIT_KELVIN, MILLI, "temperature_ext_1"),
+        pv(PV2_OFFSET, UNIT_KELVIN, MILLI, "temperature_ext_2"),
+    }),
+    profile(DEVID_STRAIN_24BIT, "STRAIN_24BIT", {
+        pv(PV0_OFFSET, UNIT_COUNT, 1.0, "strain"),
+        pv(PV1_OFFSET, UNIT_KELVIN, MILLI, "temperature_ext_1"),
+        pv(PV2_OFFSET, UNIT_KELVIN, MILLI, "temperature_ext_2"),
+    }),
+    profile(DEVID_IO_8DI_8DO, "IO_8DI_8DO", {
+        dv(DV0_OFFSET, "digital_inputs"),
+        dv(DV1_OFFSET, "digital_outputs"),
+    }),
+    profile(DEVID_IO_4DI_4DO, "IO_4DI_4DO", {
+        dv(DV0_OFFSET, "digital_inputs"),
+        dv(DV1_OFFSET, "digital_outputs"),
+    }),
+    profile(DEVID_IO_4AI, "IO_4AI", {
+        pv(PV0_OFFSET, UNIT_NONE, 1.0, "analog_input_0"),
+        pv(PV1_OFFSET, UNIT_NONE, 1.0, "analog_input_1"),
+        pv(PV2_OFFSET, UNIT_NONE, 1.0, "analog_input_2"),
+        pv(PV3_OFFSET, UNIT_NONE, 1.0, "analog_input_3"),
+    }),
+    profile(DEVID_IO_3AI, "IO_3AI", {
+        pv(PV0_OFFSET, UNIT_NONE, 1.0, "analog_input_0"),
+        pv(PV1_OFFSET, UNIT_NONE, 1.0, "analog_input_1"),
+        pv(PV2_OFFSET, UNIT_NONE, 1.0, "analog_input_2"),
+    }),
+    profile(DEVID_ENC_1000PPR, "ENC_1000PPR", {
+        pv(PV0_OFFSET, UNIT_COUNT, 1.0, "pulses"),
+    }),
+    profile(DEVID_CUTTER, "CUTTER", {
+        dv(DV0_OFFSET, "state"),
+    }),
+    profile(DEVID_WELDER, "WELDER", {
+        dv(DV0_OFFSET, "state"),
+    }),
+    profile(DEVID_ANGLE_XY_90, "ANGLE_XY_90", {
+        pv(PV0_OFFSET, UNIT_DEGREE, 1.0, "angle_x"),
+        pv(PV1_OFFSET, UNIT_DEGREE, 1.0, "angle_y"),
+    }),
+    profile(DEVID_ANGLE_XY_30, "ANGLE_XY_30", {
+        pv(PV0_OFFSET, UNIT_DEGREE, 1.0, "angle_x"),
+        pv(PV1_OFFSET, UNIT_DEGREE, 1.0, "angle_y"),
+    }),
+    profile(DEVID_ACCEL_XYZ, "ACCEL_XYZ", {
+        pv(PV0_OFFSET, UNIT_G, 1.0, "accel_x"),
+        pv(PV1_OFFSET, UNIT_G, 1.0, "accel_y"),
+        pv(PV2_OFFSET, UNIT_G, 1.0, "accel_z"),
+    }),
+    profile(DEVID_ACCEL_LIS, "ACCEL_LIS", {
+        pv(PV0_OFFSET, UNIT_G, 1.0, "accel_x"),
+        pv(PV1_OFFSET, UNIT_G, 1.0, "accel_y"),
+        pv(PV2_OFFSET, UNIT_G, 1.0, "accel_z"),
+    }),
+    profile(DEVID_ACCEL_LIS_XY, "ACCEL_LIS_XY", {
+        pv(PV0_OFFSET, UNIT_G, 1.0, "accel_x"),
+        pv(PV1_OFFSET, UNIT_G, 1.0, "accel_y"),
+    }),
+    profile(DEVID_DIST_22MM, "DIST_22MM", {
+        pv(PV0_OFFSET, UNIT_METER, MICRO, "distance_0"),
+        pv(PV1_OFFSET, UNIT_METER, MICRO, "distance_1"),
+    }),
+    profile(DEVID_DIST_225MM, "DIST_225MM", {
+        pv(PV0_OFFSET, UNIT_METER, MICRO, "distance_0"),
+        pv(PV1_OFFSET, UNIT_METER, MICRO, "distance_1"),
+    }),
+    // the meaning of the pollution sensor channels is device specific, report raw values
+    profile(DEVID_AIR_POL_CO_NOX_VOC, "AIR_POL_CO_NOX_VOC", {
+        pv(PV0_OFFSET, UNIT_NONE, 1.0, "pv0"),
+        pv(PV1_OFFSET, UNIT_NONE, 1.0, "pv1"),
+        pv(PV2_OFFSET, UNIT_NONE, 1.0, "pv2"),
+    }),
+    profile(DEVID_AIR_POL_PM, "AIR_POL_PM", {
+        pv(PV0_OFFSET, UNIT_NONE, 1.0, "pv0"),
+        pv(PV1_OFFSET, UNIT_NONE, 1.0, "pv1"),
+    }),
+    profile(DEVID_AIR_POL_CO_NOX_VOC_PM, "AIR_POL_CO_NOX_VOC_PM", {
+        pv(PV0_OFFSET, UNIT_NONE, 1.0, "pv0"),
+        pv(PV1_OFFSET, UNIT_NONE, 1.0, "pv1"),
+        pv(PV2_OFFSET, UNIT_NONE, 1.0, "pv2"),
+        pv(PV3_OFFSET, UNIT_NONE, 1.0, "pv3"),
+    }),
+    profile(DEVID_AIR_POL_CO_NOX_VOC_PM_GPS, "AIR_POL_CO_NOX_VOC_PM_GPS", {
+        pv(PV0_OFFSET, UNIT_NONE, 1.0, "pv0"),
+        pv(PV1_OFFSET, UNIT_NONE, 1.0, "pv1"),
+        pv(PV2_OFFSET, UNIT_NONE, 1.0, "pv2"),
+        pv(PV3_OFFSET, UNIT_NONE, 1.0, "pv3"),
+    }),
+    profile(DEVID_LIGHT_SOUND_POLLUTION, "LIGHT_SOUND_POLLUTION", {
+        pv(PV0_OFFSET, UNIT_NONE, 1.0, "pv0"),
+        pv(PV1_OFFSET, UNIT_NONE, 1.0, "pv1"),
+    }),
+};
+
+/// @brief table indexed directly by the device id, a perfect hash over the 8 bit id space
+constexpr std::array<DeviceProfile, 256> buildTable()
+{
+    std::array<DeviceProfile, 256> table {};
+    for(size_t id = 0; id < table.size(); id++)
+    {
+        table[id] = DeviceProfile{(devid_t)id, "UNKNOWN", 0, {}, 0, 0};
+    }
+    for(const auto &p : knownProfiles)
+    {
+        table[p.id] = p;
+    }
+    return table;
+}
+
+} // namespace detail
+
+
+/// @brief Profiles of all device ids, unknown devices have no channels
+inline constexpr std::array<DeviceProfile, 256> deviceProfiles = detail::buildTable();
+
+
+/**
+ * @brief Get the profile of a device, a single table lookup
+ *
+ * @param id device id as reported by ping or MSGID_INFO
+ * @return const DeviceProfile& profile, with no channels for unknown devices
+ */
+constexpr const DeviceProfile &deviceProfile(const devid_t id)
+{
+    return deviceProfiles[id];
+}
+
+
+/**
+ * @brief Decode one register into its scaled value
+ *
+ * @tparam type data type of the register
+ * @param bytes little endian register bytes
+ * @return double register value
+ */
+template<ChannelType type>
+inline double decodeRegister(const uint8_t *bytes)
+{
+    if constexpr(type == CHANNEL_FLOAT)
+    {
+        float value;
+        memcpy(&value, bytes, sizeof(value));
+        return value;
+    }
+    else if constexpr(type == CHANNEL_UINT32)
+    {
+        uint32_t value;
+        memcpy(&value, bytes, sizeof(value));
+        return value;
+    }
+    else
+    {
+        int32_t value;
+        memcpy(&value, bytes, sizeof(value));
+        return value;
+    }
+}
+
+
+/**
+ * @brief Decode the recommended poll range of a device known at compile time
+ *
+ * The channel layout is resolved at compile time, the generated code is a fixed
+ * sequence of loads and multiplications with no lookups or branches.
+ *
+ * @tparam id device id
+ * @param block deviceProfile(id).pollLength bytes read from deviceProfile(id).pollOffset
+ * @param out deviceProfile(id).channelCount scaled channel values
+ */
+template<devid_t id>
+inline void decodePoll(const uint8_t *block, double *out)
+{
+    [&]<size_t... i>(std::index_sequence<i...>)
+    {
+        constexpr const DeviceProfile &p = deviceProfiles[id];
+        ((out[i] = decodeRegister<p.channels[i].type>(block + p.channels[i].offset - p.pollOffset) * p.channels[i].scale), ...);
+    }(std::make_index_sequence<deviceProfiles[id].channelCount>{});
+}
+
+
+/**
+ * @brief Decode the recommended poll range of a device known at run time
+ *
+ * @param profile profile of the device
+ * @param block profile.pollLength bytes read from profile.pollOffset
+ * @param out profile.channelCount scaled channel values
+ */
+inline void decodePoll(const DeviceProfile &profile, const uint8_t *block, double *out)
+{
+    for(size_t i = 0; i < profile.channelCount; i++)
+    {
+        const ChannelProfile &channel = profile.channels[i];
+        const uint8_t *bytes = block + channel.offset - profile.pollOffset;
+        double value;
+        switch(channel.type)
+        {
+            case CHANNEL_UINT32: value = decodeRegister<CHANNEL_UINT32>(bytes); break;
+            case CHANNEL_INT32: value = decodeRegister<CHANNEL_INT32>(bytes); break;
+            default: value = decodeRegister<CHANNEL_FLOAT>(bytes); break;
+        }
+        out[i] = value * channel.scale;
+    }
+}
+
+
+} // namespace Xerxes
+
+#endif // !__DEVICE_PROFILES_HPP
@@ -0,0 +1,46 @@
+#include "Error.hpp"
+#include <cctype>
+
+namespace Xerxes
+{
+
+
+const char *errorName(const XerxesError error)
+{
+    switch(error)
+    {
+        case ERROR_TIMEOUT: return "ERROR_TIMEOUT";
+        case ERROR_CHECKSUM: return "ERROR_CHECKSUM";
+        case ERROR_UNEXPECTED_MSGID: return "ERROR_UNEXPECTED_MSGID";
+        case ERROR_NOK: return "ERROR_NOK";
+        case ERROR_REPLY_SIZE: return "ERROR_REPLY_SIZE";
+        case ERROR_SEND: return "ERROR_SEND";
+        default: return "ERROR_UNKNOWN";
+    }
+}
+
+
+void throwError(const XerxesError error, const std::string &operation)
+{
+    std::string capitalized = operation;
+    if(!capitalized.empty())
+    {
+        capitalized[0] = toupper(capitalized[0]);
+    }
+
+    switch(error)
+    {
+        case ERROR_UNEXPECTED_MSGID:
+            throw std::runtime_error("Invalid " + operation + " reply received.");
+        case ERROR_NOK:
+            throw std::runtime_error(capitalized + " refused by the device.");
+        case ERROR_REPLY_SIZE:
+            throw std::runtime_error("Invalid " + operation + " reply size.");
+        default:
+            // corrupted replies and failed sends were always reported as timeouts
+            throw TimeoutError(capitalized + " timeout.");
+    }
+}
+
+
+} // namespace Xerxes
@@ -0,0 +1,73 @@
+#ifndef __ERROR_HPP
+#define __ERROR_HPP
+
+#include <cstdint>
+#include <expected>
+#include <stdexcept>
+#include <string>
+
+namespace Xerxes
+{
+
+
+/**
+ * @brief Exception thrown when no reply arrived in time
+ *
+ */
+class TimeoutError : public std::runtime_error
+{
+public:
+    TimeoutError(const std::string &what_arg) : std::runtime_error(what_arg) {}
+};
+
+
+/**
+ * @brief Reason of a failed transaction
+ *
+ */
+enum XerxesError : uint8_t
+{
+    /// @brief no reply arrived within the retry policy
+    ERROR_TIMEOUT = 1,
+    /// @brief only corrupted frames arrived, the checksum or the framing was wrong
+    ERROR_CHECKSUM,
+    /// @brief the device replied with a message id other than the expected reply
+    ERROR_UNEXPECTED_MSGID,
+    /// @brief the device refused the request with ACK_NOK
+    ERROR_NOK,
+    /// @brief the reply carried a payload of a different size than requested
+    ERROR_REPLY_SIZE,
+    /// @brief the request could not be sent to the network
+    ERROR_SEND
+};
+
+
+/// @brief Value of an operation or the reason it failed
+template<class T>
+using Result = std::expected<T, XerxesError>;
+
+
+/**
+ * @brief Get the name of the error
+ *
+ * @param error error code
+ * @return const char* name of the error, eg. "ERROR_TIMEOUT"
+ */
+const char *errorName(const XerxesError error);
+
+
+/**
+ * @brief Throw the exception the throwing API uses for the error
+ *
+ * Timeouts, corrupted replies and send failures throw TimeoutError, the rest
+ * std::runtime_error.
+ *
+ * @param error reason of the failure
+ * @param operation name of the failed operation for the message, eg. "read memory"
+ */
+[[noreturn]] void throwError(const XerxesError error, const std::string &operation);
+
+
+} // namespace Xerxes
+
+#endif // !__ERROR_HPP
@@ -6,7 +6,7 @@ namespace Xerxes
 
 Leaf::Leaf(address_t leaf_addr, Master *master)
 {
-    master = master;
+    this->master = master;
     _my_addr = leaf_addr;
 }
 
@@ -21,6 +21,12 @@ ping_reply_t Leaf::ping()
     return master->ping(_my_addr);
 }
 
+
+Result<ping_reply_t> Leaf::tryPing()
+{
+    return master->tryPing(_my_addr);
+}
+
 const address_t Leaf::getAddr() const
 {
     return _my_addr;
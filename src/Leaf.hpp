@@ -2,6 +2,10 @@
 #define __LEAF_HPP
 
 #include "Master.hpp"
+#include "Registers.hpp"
+#include <cstring>
+#include <tuple>
+#include <type_traits>
 
 namespace Xerxes
 {
@@ -10,8 +14,8 @@ namespace Xerxes
 class Leaf
 {
 private:
-    Master *master;
-    address_t _my_addr;
+    Master *master = nullptr;
+    address_t _my_addr = 0;
 public:
     Leaf(){};
     Leaf(address_t leaf_addr, Master *master);
@@ -26,6 +30,9 @@ public:
      */
     ping_reply_t ping();
 
+    /// @brief Ping the leaf without throwing
+    Result<ping_reply_t> tryPing();
+
     const address_t getAddr() const;
 
 
@@ -39,6 +46,16 @@ public:
     }
 
 
+    template<class T>
+    Result<void> tryWriteValue(
+        const uint16_t mem_addr, 
+        const T value
+    ) const
+    {
+        return master->tryWriteValue(_my_addr, mem_addr, value);
+    }
+
+
     template<class T>
     const T readValue(
         const address_t device_addr, 
@@ -47,6 +64,161 @@ public:
     {
         return master->readValue<T>(_my_addr, mem_addr);
     }
+
+
+    template<class T>
+    Result<T> tryReadValue(const uint16_t mem_addr) const
+    {
+        return master->tryReadValue<T>(_my_addr, mem_addr);
+    }
+
+
+    /**
+     * @brief Read a register, eg. leaf.read<Registers::PV0>()
+     * 
+     * @tparam reg register from Registers
+     * @return value of the register in its type
+     * @throw TimeoutError if the leaf does not reply
+     */
+    template<const auto &reg>
+    typename std::remove_cvref_t<decltype(reg)>::type read() const
+    {
+        return master->readValue<typename std::remove_cvref_t<decltype(reg)>::type>(_my_addr, reg.offset);
+    }
+
+
+    /// @brief Read a register without throwing, eg. leaf.tryRead<Registers::PV0>()
+    template<const auto &reg>
+    Result<typename std::remove_cvref_t<decltype(reg)>::type> tryRead() const
+    {
+        return master->tryReadValue<typename std::remove_cvref_t<decltype(reg)>::type>(_my_addr, reg.offset);
+    }
+
+
+    /**
+     * @brief Write a register, the timeout follows the region of the register
+     * 
+     * @tparam reg writable register from Registers
+     * @param value new value of the register
+     * @return true if the leaf acknowledged the write
+     */
+    template<const auto &reg>
+    bool write(const typename std::remove_cvref_t<decltype(reg)>::type value) const
+    {
+        static_assert(reg.access == ACCESS_READ_WRITE, "register is read only");
+        return master->writeValue(_my_addr, reg.offset, value);
+    }
+
+
+    /// @brief Write a register without throwing, ERROR_NOK if the leaf refused the write
+    template<const auto &reg>
+    Result<void> tryWrite(const typename std::remove_cvref_t<decltype(reg)>::type value) const
+    {
+        static_assert(reg.access == ACCESS_READ_WRITE, "register is read only");
+        return master->tryWriteValue(_my_addr, reg.offset, value);
+    }
+
+
+    /**
+     * @brief Read several registers with a single READ of the memory span covering them
+     * 
+     * The span is computed at compile time, eg. leaf.readAll<Registers::PV0, Registers::DV0>()
+     * reads 84 bytes in one transaction.
+     * 
+     * @tparam regs registers from Registers
+     * @return std::tuple of the register values in the order of regs
+     * @throw TimeoutError if the leaf does not reply
+     */
+    template<const auto &... regs>
+    std::tuple<typename std::remove_cvref_t<decltype(regs)>::type...> readAll() const
+    {
+        using Span = RegisterSpan<regs...>;
+        uint8_t block[Span::size];
+        master->readMemory(_my_addr, Span::offset, Span::size, block);
+        return std::tuple<typename std::remove_cvref_t<decltype(regs)>::type...>{
+            decode<typename std::remove_cvref_t<decltype(regs)>::type>(block + regs.offset - Span::offset)...
+        };
+    }
+
+
+    /// @brief Read several registers with a single READ without throwing, see readAll()
+    template<const auto &... regs>
+    Result<std::tuple<typename std::remove_cvref_t<decltype(regs)>::type...>> tryReadAll() const
+    {
+        using Span = RegisterSpan<regs...>;
+        uint8_t block[Span::size];
+        Result<void> read = master->tryReadMemory(_my_addr, Span::offset, Span::size, block);
+        if(!read)
+        {
+            return std::unexpected(read.error());
+        }
+        return std::tuple<typename std::remove_cvref_t<decltype(regs)>::type...>{
+            decode<typename std::remove_cvref_t<decltype(regs)>::type>(block + regs.offset - Span::offset)...
+        };
+    }
+
+
+    /**
+     * @brief Read registers scattered over the memory with a single READ_MULTI
+     * 
+     * Unlike readAll() the registers may lie in different regions, eg.
+     * leaf.readMulti<Registers::PV0, Registers::STATUS, Registers::NET_CYCLE_TIME>()
+     * reads 16 bytes instead of the 292 bytes spanning them.
+     * 
+     * @tparam regs registers from Registers
+     * @return std::tuple of the register values in the order of regs
+     * @throw TimeoutError if the leaf does not reply
+     * @throw std::runtime_error if the leaf refused the read, eg. it does not know READ_MULTI
+     */
+    template<const auto &... regs>
+    std::tuple<typename std::remove_cvref_t<decltype(regs)>::type...> readMulti() const
+    {
+        static_assert(sizeof...(regs) <= READ_MULTI_MAX_RANGES, "too many registers for a single READ_MULTI");
+        static_assert((regs.size + ...) <= MAX_READ_SIZE, "registers do not fit into a single reply");
+        uint8_t block[(regs.size + ...)];
+        master->readMulti(_my_addr, {memory_range_t{regs.offset, regs.size}...}, block);
+        const uint8_t *cursor = block;
+        return std::tuple<typename std::remove_cvref_t<decltype(regs)>::type...>{
+            decodeNext<typename std::remove_cvref_t<decltype(regs)>::type>(cursor)...
+        };
+    }
+
+
+    /// @brief Read scattered registers with a single READ_MULTI without throwing, see readMulti()
+    template<const auto &... regs>
+    Result<std::tuple<typename std::remove_cvref_t<decltype(regs)>::type...>> tryReadMulti() const
+    {
+        static_assert(sizeof...(regs) <= READ_MULTI_MAX_RANGES, "too many registers for a single READ_MULTI");
+        static_assert((regs.size + ...) <= MAX_READ_SIZE, "registers do not fit into a single reply");
+        uint8_t block[(regs.size + ...)];
+        Result<void> read = master->tryReadMulti(_my_addr, {memory_range_t{regs.offset, regs.size}...}, block);
+        if(!read)
+        {
+            return std::unexpected(read.error());
+        }
+        const uint8_t *cursor = block;
+        return std::tuple<typename std::remove_cvref_t<decltype(regs)>::type...>{
+            decodeNext<typename std::remove_cvref_t<decltype(regs)>::type>(cursor)...
+        };
+    }
+
+private:
+    template<class T>
+    static T decode(const uint8_t *bytes)
+    {
+        T value;
+        memcpy(&value, bytes, sizeof(T));
+        return value;
+    }
+
+    /// @brief decode the value at the cursor and move past it, braced initializers keep the order
+    template<class T>
+    static T decodeNext(const uint8_t *&cursor)
+    {
+        const T value = decode<T>(cursor);
+        cursor += sizeof(T);
+        return value;
+    }
 };
 
 
@@ -0,0 +1,447 @@
+#include "LeafEngine.hpp"
+#include "Network.hpp"
+#include "Registers.hpp"
+#include "Clock.hpp"
+#include <algorithm>
+#include <cstring>
+
+namespace Xerxes
+{
+
+
+constexpr std::array<LeafEngine::Handler, LEAF_DISPATCH_SIZE> LeafEngine::buildDispatch()
+{
+    std::array<Handler, LEAF_DISPATCH_SIZE> table {};
+    for(auto &handler : table)
+    {
+        handler = &LeafEngine::handleUnknown;
+    }
+    table[MSGID_PING] = &LeafEngine::handlePing;
+    table[MSGID_GET_INFO] = &LeafEngine::handleGetInfo;
+    table[MSGID_READ] = &LeafEngine::handleRead;
+    table[MSGID_READ_MULTI] = &LeafEngine::handleReadMulti;
+    table[MSGID_WRITE] = &LeafEngine::handleWrite;
+    table[MSGID_SYNC] = &LeafEngine::handleEvent;
+    table[MSGID_SLEEP] = &LeafEngine::handleSleep;
+    table[MSGID_RESET_SOFT] = &LeafEngine::handleEvent;
+    table[MSGID_RESET_HARD] = &LeafEngine::handleResetHard;
+    table[MSGID_BULK_BEGIN] = &LeafEngine::handleBulkBegin;
+    table[MSGID_BULK_DATA] = &LeafEngine::handleBulkData;
+    table[MSGID_BULK_QUERY] = &LeafEngine::handleBulkQuery;
+    table[MSGID_BULK_COMMIT] = &LeafEngine::handleBulkCommit;
+    table[MSGID_BULK_ABORT] = &LeafEngine::handleBulkAbort;
+    return table;
+}
+
+
+constexpr const std::array<LeafEngine::Handler, LEAF_DISPATCH_SIZE> LeafEngine::_dispatch = LeafEngine::buildDispatch();
+
+
+LeafEngine::LeafEngine(const uint8_t address, const devid_t deviceId, const uint8_t versionMajor, const uint8_t versionMinor) :
+    _address(address), _deviceId(deviceId), _versionMajor(versionMajor), _versionMinor(versionMinor)
+{
+    memset(_registers, 0, sizeof(_registers));
+    factoryReset();
+}
+
+
+LeafEngine::~LeafEngine()
+{
+}
+
+
+void LeafEngine::factoryReset()
+{
+    memset(_registers, 0, VOLATILE_OFFSET);
+    const float gain = 1.0f;
+    for(uint16_t offset = GAIN_PV0_OFFSET; offset <= GAIN_PV3_OFFSET; offset += sizeof(float))
+    {
+        memcpy(_registers + offset, &gain, sizeof(gain));
+    }
+    _registers[OFFSET_ADDRESS] = _address;
+}
+
+
+size_t LeafEngine::handle(const uint8_t *frame, const size_t length, uint8_t *reply)
+{
+    // SOH | LEN | SRC | DST | MSGID_L | MSGID_H | PAYLOAD | CHECKSUM
+    if(length < 7 || length > MAX_FRAME_SIZE || frame[0] != SOH || frame[1] != length)
+    {
+        return 0;
+    }
+    uint8_t checksum = 0;
+    for(size_t i = 0; i < length; i++)
+    {
+        checksum += frame[i];
+    }
+    if(checksum != 0 || (frame[3] != _address && frame[3] != BROADCAST_ADDR))
+    {
+        return 0;
+    }
+
+    const LeafRequest request{
+        frame[2],
+        frame[3],
+        (msgid_t)(frame[4] | frame[5] << 8),
+        frame + 6,
+        (uint8_t)(length - 7)
+    };
+
+    const Handler handler = request.msgId < LEAF_DISPATCH_SIZE ? _dispatch[request.msgId] : &LeafEngine::handleUnknown;
+    const size_t size = (this->*handler)(request, reply);
+    return request.dstAddr == BROADCAST_ADDR ? 0 : size;
+}
+
+
+size_t LeafEngine::reply(const LeafRequest &request, uint8_t *frame, const msgid_t msgId, const uint8_t *payload, const uint8_t size) const
+{
+    const uint8_t length = size + 7;
+    frame[0] = SOH;
+    frame[1] = length;
+    frame[2] = _address;
+    frame[3] = request.srcAddr;
+    frame[4] = msgId & 0xff;
+    frame[5] = msgId >> 8;
+    if(size > 0)
+    {
+        memcpy(frame + 6, payload, size);
+    }
+
+    uint8_t checksum = 0;
+    for(size_t i = 0; i < length - 1u; i++)
+    {
+        checksum += frame[i];
+    }
+    frame[length - 1] = ~checksum + 1; // two's complement
+    return length;
+}
+
+
+size_t LeafEngine::handlePing(const LeafRequest &request, uint8_t *frame)
+{
+    const uint8_t payload[3] = {_deviceId, _versionMajor, _versionMinor};
+    return reply(request, frame, MSGID_PING_REPLY, payload, sizeof(payload));
+}
+
+
+size_t LeafEngine::handleGetInfo(const LeafRequest &request, uint8_t *frame)
+{
+    uint8_t payload[3 + 8] = {_deviceId, _versionMajor, _versionMinor};
+    memcpy(payload + 3, _registers + UID_OFFSET, 8);
+    return reply(request, frame, MSGID_INFO, payload, sizeof(payload));
+}
+
+
+size_t LeafEngine::handleRead(const LeafRequest &request, uint8_t *frame)
+{
+    if(request.payloadSize != 3)
+    {
+        return reply(request, frame, MSGID_ACK_NOK, nullptr, 0);
+    }
+    const uint16_t offset = request.payload[0] | request.payload[1] << 8;
+    const uint8_t size = request.payload[2];
+    if(size > MAX_READ_SIZE || offset + size > REGISTER_SIZE)
+    {
+        return reply(request, frame, MSGID_ACK_NOK, nullptr, 0);
+    }
+    return reply(request, frame, MSGID_READ_VALUE, _registers + offset, size);
+}
+
+
+size_t LeafEngine::handleReadMulti(const LeafRequest &request, uint8_t *frame)
+{
+    // OFFSET u16 | SIZE u8, repeated
+    if(request.payloadSize == 0 || request.payloadSize % 3 != 0)
+    {
+        return reply(request, frame, MSGID_ACK_NOK, nullptr, 0);
+    }
+    uint8_t payload[MAX_READ_SIZE];
+    size_t size = 0;
+    for(const uint8_t *range = request.payload; range < request.payload + request.payloadSize; range += 3)
+    {
+        const uint16_t offset = range[0] | range[1] << 8;
+        const uint8_t length = range[2];
+        if(size + length > MAX_READ_SIZE || offset + length > REGISTER_SIZE)
+        {
+            return reply(request, frame, MSGID_ACK_NOK, nullptr, 0);
+        }
+        memcpy(payload + size, _registers + offset, length);
+        size += length;
+    }
+    return reply(request, frame, MSGID_READ_VALUE, payload, size);
+}
+
+
+size_t LeafEngine::handleWrite(const LeafRequest &request, uint8_t *frame)
+{
+    if(request.payloadSize < 2)
+    {
+        return reply(request, frame, MSGID_ACK_NOK, nullptr, 0);
+    }
+    const uint16_t offset = request.payload[0] | request.payload[1] << 8;
+    const uint8_t size = request.payloadSize - 2;
+    // a 16 bit end would wrap for offsets close to 0xffff
+    const uint32_t end = (uint32_t)offset + size;
+
+    uint32_t unlocked;
+    memcpy(&unlocked, _registers + MEM_UNLOCKED_OFFSET, sizeof(unlocked));
+
+    if(end > READ_ONLY_OFFSET ||
+        (regionOf(offset) == REGION_NON_VOLATILE && unlocked != MEM_UNLOCKED_VAL))
+    {
+        return reply(request, frame, MSGID_ACK_NOK, nullptr, 0);
+    }
+
+    memcpy(_registers + offset, request.payload + 2, size);
+    handleEvent(request, frame);
+    return reply(request, frame, MSGID_ACK_OK, nullptr, 0);
+}
+
+
+size_t LeafEngine::handleSleep(const LeafRequest &request, uint8_t *frame)
+{
+    if(request.payloadSize >= sizeof(_sleepUs))
+    {
+        memcpy(&_sleepUs, request.payload, sizeof(_sleepUs));
+    }
+    return handleEvent(request, frame);
+}
+
+
+size_t LeafEngine::handleResetHard(const LeafRequest &request, uint8_t *frame)
+{
+    factoryReset();
+    return handleEvent(request, frame);
+}
+
+
+size_t LeafEngine::handleEvent(const LeafRequest &request, uint8_t *)
+{
+    if(_eventHandler != nullptr)
+    {
+        _eventHandler(*this, request, _eventContext);
+    }
+    return 0;
+}
+
+
+size_t LeafEngine::handleUnknown(const LeafRequest &request, uint8_t *frame)
+{
+    return reply(request, frame, MSGID_ACK_NOK, nullptr, 0);
+}
+
+
+static uint32_t getLe(const uint8_t *bytes, const size_t size)
+{
+    uint32_t value = 0;
+    for(size_t i = 0; i < size; i++)
+    {
+        value |= (uint32_t)bytes[i] << (8 * i);
+    }
+    return value;
+}
+
+
+size_t LeafEngine::handleBulkBegin(const LeafRequest &request, uint8_t *frame)
+{
+    // SIZE u32 | BLOCK_SIZE u8 | CRC32 u32
+    if(request.payloadSize != 9)
+    {
+        return reply(request, frame, MSGID_ACK_NOK, nullptr, 0);
+    }
+    const uint32_t size = getLe(request.payload, 4);
+    const uint8_t blockSize = request.payload[4];
+    if(blockSize == 0 || blockSize > BULK_MAX_BLOCK_SIZE || size > _bulk.capacity ||
+        (size + blockSize - 1) / blockSize > BULK_MAX_BLOCKS)
+    {
+        return reply(request, frame, MSGID_ACK_NOK, nullptr, 0);
+    }
+
+    _bulk.size = size;
+    _bulk.blockSize = blockSize;
+    _bulk.blocks = (size + blockSize - 1) / blockSize;
+    _bulk.crc = getLe(request.payload + 5, 4);
+    _bulk.active = true;
+    _bulk.committed = false;
+    _bulk.pending = 0;
+    _bulk.bitmap.fill(0);
+    return reply(request, frame, MSGID_ACK_OK, nullptr, 0);
+}
+
+
+size_t LeafEngine::handleBulkData(const LeafRequest &request, uint8_t *)
+{
+    // BLOCK u16 | CRC16 u16 | DATA
+    if(!_bulk.active || request.payloadSize < 4)
+    {
+        return 0;
+    }
+    const uint16_t block = getLe(request.payload, 2);
+    const uint32_t offset = (uint32_t)block * _bulk.blockSize;
+    const uint8_t *data = request.payload + 4;
+    const size_t length = request.payloadSize - 4;
+    if(block >= _bulk.blocks || length != std::min<uint32_t>(_bulk.blockSize, _bulk.size - offset))
+    {
+        return 0;
+    }
+    if(steadyNowNs() < _bulk.busyUntilNs || crc16(data, length) != getLe(request.payload + 2, 2))
+    {
+        _bulk.dropped++;
+        return 0;
+    }
+
+    memcpy(_bulk.storage + offset, data, length);
+    if(!(_bulk.bitmap[block / 8] & (1 << (block % 8))))
+    {
+        _bulk.bitmap[block / 8] |= 1 << (block % 8);
+        _bulk.pending++;
+    }
+    return 0;
+}
+
+
+size_t LeafEngine::handleBulkQuery(const LeafRequest &request, uint8_t *frame)
+{
+    // FIRST_BLOCK u16 | BLOCKS u16
+    if(!_bulk.active || request.payloadSize != 4)
+    {
+        return reply(request, frame, MSGID_ACK_NOK, nullptr, 0);
+    }
+    const uint16_t first = getLe(request.payload, 2);
+    const uint16_t count = getLe(request.payload + 2, 2);
+    if(count > BULK_MAX_QUERY_BLOCKS || first + count > _bulk.blocks)
+    {
+        return reply(request, frame, MSGID_ACK_NOK, nullptr, 0);
+    }
+
+    // the blocks received so far are written now, the master comes back when it is done
+    const int64_t now = steadyNowNs();
+    if(now >= _bulk.busyUntilNs && _bulk.pending > 0)
+    {
+        _bulk.busyUntilNs = now + (int64_t)_bulk.pending * _bulk.flashBlockUs * 1000;
+        _bulk.pending = 0;
+    }
+    const uint32_t busyUs = now < _bulk.busyUntilNs ? (_bulk.busyUntilNs - now + 999) / 1000 : 0;
+
+    // FIRST_BLOCK u16 | BLOCKS u16 | BUSY_US u32 | BITMAP
+    uint8_t payload[MAX_READ_SIZE] = {
+        (uint8_t)(first & 0xff), (uint8_t)(first >> 8),
+        (uint8_t)(count & 0xff), (uint8_t)(count >> 8),
+        (uint8_t)(busyUs & 0xff), (uint8_t)(busyUs >> 8), (uint8_t)(busyUs >> 16), (uint8_t)(busyUs >> 24)
+    };
+    uint8_t *bitmap = payload + 8;
+    const size_t bitmapSize = (count + 7) / 8;
+    memset(bitmap, 0, bitmapSize);
+    for(uint16_t bit = 0; bit < count; bit++)
+    {
+        const uint16_t block = first + bit;
+        if(_bulk.bitmap[block / 8] & (1 << (block % 8)))
+        {
+            bitmap[bit / 8] |= 1 << (bit % 8);
+        }
+    }
+    return reply(request, frame, MSGID_BULK_STATUS, payload, 8 + bitmapSize);
+}
+
+
+size_t LeafEngine::handleBulkCommit(const LeafRequest &request, uint8_t *frame)
+{
+    // the master repeats COMMIT if the acknowledge got lost
+    if(!_bulk.active && _bulk.committed)
+    {
+        return reply(request, frame, MSGID_ACK_OK, nullptr, 0);
+    }
+    if(!_bulk.active)
+    {
+        return reply(request, frame, MSGID_ACK_NOK, nullptr, 0);
+    }
+    for(uint16_t block = 0; block < _bulk.blocks; block++)
+    {
+        if(!(_bulk.bitmap[block / 8] & (1 << (block % 8))))
+        {
+            return reply(request, frame, MSGID_ACK_NOK, nullptr, 0);
+        }
+    }
+    if(crc32(_bulk.storage, _bulk.size) != _bulk.crc)
+    {
+        return reply(request, frame, MSGID_ACK_NOK, nullptr, 0);
+    }
+
+    _bulk.active = false;
+    _bulk.committed = true;
+    handleEvent(request, frame);
+    return reply(request, frame, MSGID_ACK_OK, nullptr, 0);
+}
+
+
+size_t LeafEngine::handleBulkAbort(const LeafRequest &request, uint8_t *frame)
+{
+    _bulk.active = false;
+    return reply(request, frame, MSGID_ACK_OK, nullptr, 0);
+}
+
+
+void LeafEngine::setEventHandler(leaf_event_handler_t handler, void *context)
+{
+    _eventHandler = handler;
+    _eventContext = context;
+}
+
+
+uint8_t LeafEngine::address() const
+{
+    return _address;
+}
+
+
+devid_t LeafEngine::deviceId() const
+{
+    return _deviceId;
+}
+
+
+uint32_t LeafEngine::sleepUs() const
+{
+    return _sleepUs;
+}
+
+
+void LeafEngine::setBulkStorage(uint8_t *storage, const uint32_t capacity)
+{
+    _bulk.storage = storage;
+    _bulk.capacity = storage != nullptr ? capacity : 0;
+    _bulk.active = false;
+}
+
+
+void LeafEngine::setFlashWriteUs(const uint32_t blockUs)
+{
+    _bulk.flashBlockUs = blockUs;
+}
+
+
+uint32_t LeafEngine::bulkCommitted() const
+{
+    return _bulk.committed ? _bulk.size : 0;
+}
+
+
+uint32_t LeafEngine::bulkDropped() const
+{
+    return _bulk.dropped;
+}
+
+
+uint8_t *LeafEngine::registers()
+{
+    return _registers;
+}
+
+
+const uint8_t *LeafEngine::registers() const
+{
+    return _registers;
+}
+
+
+} // namespace Xerxes
@@ -0,0 +1,191 @@
+#ifndef __LEAF_ENGINE_HPP
+#define __LEAF_ENGINE_HPP
+
+#include <array>
+#include <cstdint>
+#include <stddef.h>
+#include "MessageId.h"
+#include "DeviceIds.h"
+#include "MemoryMap.h"
+#include "Trace.hpp"
+#include "Bulk.hpp"
+
+namespace Xerxes
+{
+
+
+/// @brief Message ids below this value are dispatched through the table of the leaf engine
+constexpr msgid_t LEAF_DISPATCH_SIZE = 0x0300;
+
+
+/**
+ * @brief Request parsed by the leaf engine, points into the received frame
+ *
+ */
+struct LeafRequest
+{
+    uint8_t srcAddr;
+    uint8_t dstAddr;
+    msgid_t msgId;
+    const uint8_t *payload;
+    uint8_t payloadSize;
+};
+
+
+class LeafEngine;
+
+/**
+ * @brief Called after the leaf engine served a request, eg. to take a measurement on SYNC
+ *
+ * @param leaf leaf engine which served the request
+ * @param request the request
+ * @param context context given to setEventHandler
+ */
+typedef void (*leaf_event_handler_t)(LeafEngine &leaf, const LeafRequest &request, void *context);
+
+
+/**
+ * @brief Device side of the protocol, serves requests of a master
+ *
+ * Parses raw frames, dispatches them by message id through a table built at compile time
+ * and serves READ and WRITE from a register file laid out per MemoryMap.h. The engine
+ * never allocates, so one process can host thousands of simulated leaves.
+ *
+ * Served messages:
+ * - PING: PING_REPLY with device id and version
+ * - GET_INFO: INFO with device id, version and uid
+ * - READ: READ_VALUE with the memory block, ACK_NOK if out of range
+ * - READ_MULTI: READ_VALUE with the ranges back to back, ACK_NOK if any is out of range
+ * - WRITE: ACK_OK, ACK_NOK if out of range, read only or the flash is locked
+ * - SYNC, SLEEP, RESET_SOFT, RESET_HARD: no reply, the event handler is called
+ * - BULK_BEGIN, BULK_QUERY, BULK_COMMIT, BULK_ABORT: see BulkTransfer, BULK_DATA: no reply
+ * - anything else: ACK_NOK
+ *
+ * Broadcast requests are served but never replied to.
+ */
+class LeafEngine
+{
+private:
+    typedef size_t (LeafEngine::*Handler)(const LeafRequest &request, uint8_t *reply);
+
+    static const std::array<Handler, LEAF_DISPATCH_SIZE> _dispatch;
+
+    uint8_t _address;
+    devid_t _deviceId;
+    uint8_t _versionMajor;
+    uint8_t _versionMinor;
+    uint32_t _sleepUs = 0;
+    uint8_t _registers[REGISTER_SIZE];
+
+    leaf_event_handler_t _eventHandler = nullptr;
+    void *_eventContext = nullptr;
+
+    /// @brief bulk transfer into the storage given by setBulkStorage()
+    struct BulkState
+    {
+        uint8_t *storage = nullptr;
+        uint32_t capacity = 0;
+        uint32_t size = 0;
+        uint32_t crc = 0;
+        uint16_t blocks = 0;
+        uint8_t blockSize = 0;
+        bool active = false;
+        bool committed = false;
+        /// @brief blocks received and not written to the flash yet
+        uint16_t pending = 0;
+        /// @brief blocks are dropped while the flash is written
+        int64_t busyUntilNs = 0;
+        uint32_t flashBlockUs = 0;
+        uint32_t dropped = 0;
+        std::array<uint8_t, BULK_MAX_BLOCKS / 8> bitmap {};
+    } _bulk;
+
+    size_t reply(const LeafRequest &request, uint8_t *frame, const msgid_t msgId, const uint8_t *payload, const uint8_t size) const;
+
+    size_t handlePing(const LeafRequest &request, uint8_t *reply);
+    size_t handleGetInfo(const LeafRequest &request, uint8_t *reply);
+    size_t handleRead(const LeafRequest &request, uint8_t *reply);
+    size_t handleReadMulti(const LeafRequest &request, uint8_t *reply);
+    size_t handleWrite(const LeafRequest &request, uint8_t *reply);
+    size_t handleSleep(const LeafRequest &request, uint8_t *reply);
+    size_t handleResetHard(const LeafRequest &request, uint8_t *reply);
+    size_t handleEvent(const LeafRequest &request, uint8_t *reply);
+    size_t handleUnknown(const LeafRequest &request, uint8_t *reply);
+    size_t handleBulkBegin(const LeafRequest &request, uint8_t *reply);
+    size_t handleBulkData(const LeafRequest &request, uint8_t *reply);
+    size_t handleBulkQuery(const LeafRequest &request, uint8_t *reply);
+    size_t handleBulkCommit(const LeafRequest &request, uint8_t *reply);
+    size_t handleBulkAbort(const LeafRequest &request, uint8_t *reply);
+
+    /// @brief factory settings of the non volatile range
+    void factoryReset();
+
+    static constexpr std::array<Handler, LEAF_DISPATCH_SIZE> buildDispatch();
+
+public:
+    /**
+     * @brief Construct a new Leaf Engine object with factory settings
+     *
+     * @param address address of the leaf
+     * @param deviceId device id reported by PING and GET_INFO
+     * @param versionMajor firmware version reported by PING and GET_INFO
+     * @param versionMinor firmware version reported by PING and GET_INFO
+     */
+    LeafEngine(const uint8_t address, const devid_t deviceId, const uint8_t versionMajor = 1, const uint8_t versionMinor = 0);
+    ~LeafEngine();
+
+    /**
+     * @brief Serve a received frame
+     *
+     * @param frame raw bytes SOH..CHECKSUM
+     * @param length number of bytes of the frame
+     * @param reply buffer of MAX_FRAME_SIZE bytes receiving the reply frame
+     * @return size_t length of the reply frame, 0 if there is no reply or the frame is
+     * corrupted or addressed to another device
+     */
+    size_t handle(const uint8_t *frame, const size_t length, uint8_t *reply);
+
+    /// @brief Call the handler after every served SYNC, SLEEP, RESET_* and WRITE
+    void setEventHandler(leaf_event_handler_t handler, void *context);
+
+    uint8_t address() const;
+    devid_t deviceId() const;
+
+    /// @brief Duration of the last SLEEP request in microseconds
+    uint32_t sleepUs() const;
+
+    /**
+     * @brief Give the engine memory for images of bulk transfers, like a flash region of a device
+     *
+     * BULK_BEGIN is refused until storage is given or if the image does not fit.
+     *
+     * @param storage buffer receiving the image, owned by the caller
+     * @param capacity size of the buffer
+     */
+    void setBulkStorage(uint8_t *storage, const uint32_t capacity);
+
+    /**
+     * @brief Simulate the time a device needs to write a block to its flash
+     *
+     * The received blocks are written when the master asks with BULK_QUERY, blocks
+     * arriving meanwhile are dropped like on a device stalled by the flash.
+     *
+     * @param blockUs time per block in microseconds, 0 to write instantly
+     */
+    void setFlashWriteUs(const uint32_t blockUs);
+
+    /// @brief Size of the last committed bulk image, 0 if none
+    uint32_t bulkCommitted() const;
+
+    /// @brief Number of bulk blocks dropped because of a bad CRC16 or a busy flash
+    uint32_t bulkDropped() const;
+
+    /// @brief Register file of REGISTER_SIZE bytes, update the volatile values through it
+    uint8_t *registers();
+    const uint8_t *registers() const;
+};
+
+
+} // namespace Xerxes
+
+#endif // !__LEAF_ENGINE_HPP
@@ -1,6 +1,11 @@
 #include "Master.hpp"
+#include "Registers.hpp"
 #include <chrono>
 #include <stdexcept>
+#include <algorithm>
+#include <thread>
+#include <iterator>
+#include <random>
 
 namespace Xerxes
 {
@@ -14,6 +19,11 @@ Master::Master(
 {
     xp = protocol;
     _my_addr = device_addr;
+
+    _policies[OP_PING] = {1, 0, 0, true};
+    _policies[OP_READ] = {3, 1000, 0, true};   // 3 attempts, 1ms, 2ms backoff
+    _policies[OP_WRITE] = {1, 0, 0, false};
+    _policies[OP_CUSTOM] = {1, 0, 0, false};
 }
 
 
@@ -25,41 +35,50 @@ Master::~Master()
 ping_reply_t Master::ping(
     address_t device_addr
 )
+{
+    Result<ping_reply_t> reply = tryPing(device_addr);
+    if(!reply)
+    {
+        throwError(reply.error(), "ping");
+    }
+    return *reply;
+}
+
+
+Result<ping_reply_t> Master::tryPing(
+    address_t device_addr
+)
 {
     ping_reply_t reply;
     reply.device_id = 0;
     reply.v_major = 0;
     reply.v_minor = 0;
     reply.latency_ms = 0.0;
+    reply.tx_ns = 0;
+    reply.rx_ns = 0;
 
     const Message ping_msg(_my_addr, device_addr, MSGID_PING);
     Message reply_msg;
+    int64_t sent_ns = 0;
 
-    auto start_time = std::chrono::steady_clock::now();
-    
-    xp->sendMessage(ping_msg);
-
-    if(xp->readMessage(reply_msg, _timeoutUs))
+    Result<void> done = transact(OP_PING, ping_msg, _timeoutUs.load(), {MSGID_PING_REPLY}, reply_msg, &sent_ns);
+    if(!done)
     {
-        auto end_time = std::chrono::steady_clock::now();
-        if(reply_msg.msgId == MSGID_PING_REPLY)
-        {
-            auto payload_it = reply_msg.payloadBegin();
-            reply.device_id = *payload_it++;
-            reply.v_major = *payload_it++;
-            reply.v_minor = *payload_it++;
-            reply.latency_ms = (float)std::chrono::duration_cast<std::chrono::milliseconds>(end_time - start_time).count();
-        return reply;
-        }
-        else
-        {
-            throw std::runtime_error("Invalid ping reply received.");
-        }
+        return std::unexpected(done.error());
     }
-    else
+    if(reply_msg.end() - reply_msg.payloadBegin() < 3)
     {
-        throw TimeoutError("Ping timeout.");
+        return std::unexpected(ERROR_REPLY_SIZE);
     }
+
+    auto payload_it = reply_msg.payloadBegin();
+    reply.device_id = *payload_it++;
+    reply.v_major = *payload_it++;
+    reply.v_minor = *payload_it++;
+    reply.tx_ns = sent_ns;
+    reply.rx_ns = reply_msg.timestampNs;
+    reply.latency_ms = (float)(reply.rx_ns - reply.tx_ns) / 1e6f;
+    return reply;
 }
 
     
@@ -82,6 +101,7 @@ void Master::broadcast(
 {
     Message msg(_my_addr, BROADCAST_ADDRESS, msgid, payload);
 
+    std::lock_guard<std::mutex> lock(_bus);
     xp->sendMessage(msg);
 }
 
@@ -90,12 +110,110 @@ void Master::broadcast(const msgid_t msgid)
 {
     Message msg(_my_addr, BROADCAST_ADDRESS, msgid);
 
+    std::lock_guard<std::mutex> lock(_bus);
     xp->sendMessage(msg);
 }
 
-void Master::sync()
+
+broadcast_write_report_t Master::broadcastWrite(
+    const std::vector<address_t> &leaves,
+    const uint16_t mem_addr,
+    const uint8_t *data,
+    const uint8_t size,
+    const size_t sample
+)
+{
+    if(size > MAX_WRITE_SIZE)
+    {
+        throw std::invalid_argument("Broadcast write too large.");
+    }
+
+    std::vector<uint8_t> payload_vec;
+    payload_vec.push_back((uint8_t)(mem_addr & 0xff));  // little endian
+    payload_vec.push_back((uint8_t)(mem_addr >> 8));
+    payload_vec.insert(payload_vec.end(), data, data + size);
+    broadcast(MSGID_WRITE, payload_vec);
+
+    // the leaves write the flash in parallel, the first read back waits for it
+    const uint32_t timeoutUs = std::max(writeTimeoutUs(regionOf(mem_addr)), _timeoutUs.load());
+
+    broadcast_write_report_t report;
+    std::vector<address_t> to_repair;
+    std::vector<uint8_t> read_back(size);
+    auto verify = [&](const address_t leaf) {
+        Result<void> read = tryReadMemory(leaf, mem_addr, size, read_back.data(), timeoutUs);
+        if(read && std::equal(read_back.begin(), read_back.end(), data))
+        {
+            report.verified.push_back(leaf);
+        }
+        else
+        {
+            to_repair.push_back(leaf);
+        }
+    };
+
+    std::vector<address_t> sampled;
+    if(sample > 0 && sample < leaves.size())
+    {
+        std::sample(leaves.begin(), leaves.end(), std::back_inserter(sampled), sample, std::mt19937(std::random_device()()));
+        for(const address_t leaf : sampled)
+        {
+            verify(leaf);
+        }
+    }
+    if(sampled.empty() || !to_repair.empty())
+    {
+        // a disagreeing sample means the broadcast was not reliable, check everybody else too
+        for(const address_t leaf : leaves)
+        {
+            if(std::find(sampled.begin(), sampled.end(), leaf) == sampled.end())
+            {
+                verify(leaf);
+            }
+        }
+    }
+
+    for(const address_t leaf : to_repair)
+    {
+        Result<void> written = tryWriteMemory(leaf, mem_addr, data, size);
+        if(written)
+        {
+            report.repaired.push_back(leaf);
+        }
+        else
+        {
+            report.failed.emplace_back(leaf, written.error());
+        }
+    }
+    return report;
+}
+
+
+bool Master::post(const Message &message)
+{
+    std::lock_guard<std::mutex> lock(_bus);
+    return xp->sendMessage(message);
+}
+
+
+Result<void> Master::tryRequest(
+    const Message &request,
+    const std::initializer_list<msgid_t> expected,
+    Message &reply,
+    const uint32_t timeoutUs
+)
+{
+    return transact(OP_CUSTOM, request, timeoutUs ? timeoutUs : _timeoutUs.load(), expected, reply);
+}
+
+
+int64_t Master::sync()
 {
-    broadcast(MSGID_SYNC);
+    Message msg(_my_addr, BROADCAST_ADDRESS, MSGID_SYNC);
+
+    std::lock_guard<std::mutex> lock(_bus);
+    xp->sendMessage(msg);
+    return xp->lastSentNs();
 }
 
 std::vector<uint8_t> Master::readMemory(
@@ -103,6 +221,21 @@ std::vector<uint8_t> Master::readMemory(
     const uint16_t address, 
     const uint8_t size
 )
+{
+    Result<std::vector<uint8_t>> data = tryReadMemory(device_addr, address, size);
+    if(!data)
+    {
+        throwError(data.error(), "read memory");
+    }
+    return std::move(*data);
+}
+
+
+Result<std::vector<uint8_t>> Master::tryReadMemory(
+    address_t device_addr, 
+    const uint16_t address, 
+    const uint8_t size
+)
 {
     std::vector<uint8_t> payload;
     payload.push_back((uint8_t)(address & 0xff));  // little endian
@@ -112,27 +245,187 @@ std::vector<uint8_t> Master::readMemory(
     Message msg(_my_addr, device_addr, MSGID_READ, payload);
     Message reply_msg;
 
-    xp->sendMessage(msg);
+    Result<void> done = transact(OP_READ, msg, _timeoutUs.load(), {MSGID_READ_VALUE}, reply_msg);
+    if(!done)
+    {
+        return std::unexpected(done.error());
+    }
+    if(reply_msg.end() - reply_msg.payloadBegin() != size)
+    {
+        return std::unexpected(ERROR_REPLY_SIZE);
+    }
+    return std::vector<uint8_t>(reply_msg.payloadBegin(), reply_msg.end());
+}
+
+
+void Master::readMemory(
+    address_t device_addr, 
+    const uint16_t address, 
+    const uint8_t size,
+    uint8_t *data,
+    const uint32_t timeoutUs
+)
+{
+    Result<void> done = tryReadMemory(device_addr, address, size, data, timeoutUs);
+    if(!done)
+    {
+        throwError(done.error(), "read memory");
+    }
+}
+
+
+Result<void> Master::tryReadMemory(
+    address_t device_addr, 
+    const uint16_t address, 
+    const uint8_t size,
+    uint8_t *data,
+    const uint32_t timeoutUs
+)
+{
+    const uint8_t payload[3] = {
+        (uint8_t)(address & 0xff),  // little endian
+        (uint8_t)(address >> 8),
+        size
+    };
+
+    Message msg(_my_addr, device_addr, MSGID_READ, std::vector<uint8_t>(payload, payload + sizeof(payload)));
+    Message reply_msg;
+
+    Result<void> done = transact(OP_READ, msg, timeoutUs ? timeoutUs : _timeoutUs.load(), {MSGID_READ_VALUE}, reply_msg);
+    if(!done)
+    {
+        return done;
+    }
+    if(reply_msg.end() - reply_msg.payloadBegin() != size)
+    {
+        return std::unexpected(ERROR_REPLY_SIZE);
+    }
+    std::copy(reply_msg.payloadBegin(), reply_msg.end(), data);
+    return {};
+}
+
+
+bool Master::writeMemory(
+    address_t device_addr, 
+    const uint16_t address, 
+    const uint8_t *payload, 
+    const uint8_t payload_size
+)
+{
+    Result<void> done = tryWriteMemory(device_addr, address, payload, payload_size);
+    if(!done && done.error() != ERROR_NOK)
+    {
+        throwError(done.error(), "write memory");
+    }
+    return done.has_value();
+}
+
+
+std::vector<uint8_t> Master::readMulti(
+    address_t device_addr, 
+    const std::vector<memory_range_t> &ranges
+)
+{
+    size_t size = 0;
+    for(const memory_range_t &range : ranges)
+    {
+        size += range.size;
+    }
+    std::vector<uint8_t> data(size);
+    readMulti(device_addr, ranges, data.data());
+    return data;
+}
 
-    if(xp->readMessage(reply_msg, _timeoutUs))
+
+void Master::readMulti(
+    address_t device_addr, 
+    const std::vector<memory_range_t> &ranges,
+    uint8_t *data,
+    const uint32_t timeoutUs
+)
+{
+    Result<void> done = tryReadMulti(device_addr, ranges, data, timeoutUs);
+    if(!done)
+    {
+        throwError(done.error(), "read multi");
+    }
+}
+
+
+Result<void> Master::tryReadMulti(
+    address_t device_addr, 
+    const std::vector<memory_range_t> &ranges,
+    uint8_t *data,
+    const uint32_t timeoutUs
+)
+{
+    // adjacent ranges come back as one block anyway, merging them saves request bytes
+    std::vector<std::pair<uint16_t, uint32_t>> spans;
+    for(const memory_range_t &range : ranges)
     {
-        if(reply_msg.msgId == MSGID_READ_VALUE)
+        if(!spans.empty() && spans.back().first + spans.back().second == range.offset)
         {
-            return std::vector<uint8_t>(reply_msg.payloadBegin(), reply_msg.end());
+            spans.back().second += range.size;
         }
-        else
+        else if(range.size > 0)
         {
-            throw std::runtime_error("Invalid read memory reply received.");
+            spans.emplace_back(range.offset, range.size);
         }
     }
-    else
+
+    std::vector<uint8_t> payload;
+    size_t reply_size = 0;
+    Message reply_msg;
+
+    auto flush = [&]() -> Result<void> {
+        const Message msg(_my_addr, device_addr, MSGID_READ_MULTI, payload);
+        Result<void> done = transact(OP_READ, msg, timeoutUs ? timeoutUs : _timeoutUs.load(), {MSGID_READ_VALUE}, reply_msg);
+        if(!done)
+        {
+            return done;
+        }
+        if((size_t)(reply_msg.end() - reply_msg.payloadBegin()) != reply_size)
+        {
+            return std::unexpected(ERROR_REPLY_SIZE);
+        }
+        data = std::copy(reply_msg.payloadBegin(), reply_msg.end(), data);
+        payload.clear();
+        reply_size = 0;
+        return {};
+    };
+
+    for(auto [offset, size] : spans)
     {
-        throw TimeoutError("Read memory timeout.");
+        while(size > 0)
+        {
+            if(reply_size == MAX_READ_SIZE || payload.size() == READ_MULTI_MAX_RANGES * 3u)
+            {
+                Result<void> done = flush();
+                if(!done)
+                {
+                    return done;
+                }
+            }
+            // a range larger than the space left in the reply continues in the next request
+            const uint8_t piece = std::min<uint32_t>(size, MAX_READ_SIZE - reply_size);
+            payload.push_back((uint8_t)(offset & 0xff));  // little endian
+            payload.push_back((uint8_t)(offset >> 8));
+            payload.push_back(piece);
+            reply_size += piece;
+            offset += piece;
+            size -= piece;
+        }
     }
+
+    if(!payload.empty())
+    {
+        return flush();
+    }
+    return {};
 }
 
 
-bool Master::writeMemory(
+Result<void> Master::tryWriteMemory(
     address_t device_addr, 
     const uint16_t address, 
     const uint8_t *payload, 
@@ -144,48 +437,276 @@ bool Master::writeMemory(
     payload_vec.push_back((uint8_t)(address & 0xff));  // little endian
     payload_vec.push_back((uint8_t)(address >> 8));
     payload_vec.insert(payload_vec.end(), payload, payload + payload_size);
-    
-    xp->sendMessage(Message(_my_addr, device_addr, MSGID_WRITE, payload_vec));
-    uint32_t old_timeout = _timeoutUs;
-    if(address < 256)
-    {
-        setTimeout(100000); // 100ms for memory write in FLASH
-    }
-    else
+
+    // writes to the flash take much longer than writes to the RAM
+    const uint32_t timeoutUs = writeTimeoutUs(regionOf(address));
+
+    const Message msg(_my_addr, device_addr, MSGID_WRITE, payload_vec);
+    Message reply_msg;
+
+    // ACK_NOK ends the transaction with ERROR_NOK
+    return transact(OP_WRITE, msg, timeoutUs, {MSGID_ACK_OK}, reply_msg);
+}
+
+
+void Master::setTimeout(const uint32_t timeoutUs)
+{
+    _timeoutUs = timeoutUs;
+}
+
+
+address_t Master::getAddr() const
+{
+    return _my_addr;
+}
+
+
+void Master::setRetryPolicy(const MasterOperation op, const retry_policy_t &policy)
+{
+    std::lock_guard<std::mutex> lock(_bus);
+    _policies[op] = policy;
+}
+
+
+retry_policy_t Master::getRetryPolicy(const MasterOperation op) const
+{
+    std::lock_guard<std::mutex> lock(_bus);
+    return _policies[op];
+}
+
+
+Result<void> Master::transact(
+    const MasterOperation op,
+    const Message &request,
+    const uint64_t timeoutUs,
+    const std::initializer_list<msgid_t> expected,
+    Message &reply,
+    int64_t *sentNs
+)
+{
+    using namespace std::chrono;
+
+    // the bus is held for every attempt, and for the backoff between them while a reply
+    // to an earlier attempt may still arrive, lest the next thread takes it for its own
+    std::unique_lock<std::mutex> lock(_bus);
+    drainLateReplies(request.dstAddr);
+
+    const retry_policy_t policy = _policies[op];
+    const uint8_t max_attempts = std::max<uint8_t>(policy.maxAttempts, 1);
+    const auto budget_end = policy.budgetUs
+        ? steady_clock::now() + microseconds(policy.budgetUs)
+        : steady_clock::time_point::max();
+
+    uint64_t backoff_us = policy.backoffUs;
+    uint8_t sent = 0;
+    // attempts which got no reply of the device, their replies may still arrive
+    uint8_t silent = 0;
+    auto last_sent = steady_clock::now();
+    // the replies of the silent attempts are waited for before the next request to the device
+    auto expect_late_replies = [&]{
+        if(silent > 0)
+        {
+            _lateReplies[request.dstAddr] = {silent, last_sent + microseconds(2 * timeoutUs)};
+        }
+    };
+    // a wrong reply of the device tells more than the timeouts of the other attempts
+    XerxesError error = ERROR_SEND;
+
+    for(uint8_t attempt = 0; attempt < max_attempts; attempt++)
     {
-        setTimeout(10000); // 10ms for memory write in RAM
+        if(attempt > 0)
+        {
+            if(sent > 0 && !policy.idempotent)
+            {
+                // the request may have been executed already
+                break;
+            }
+
+            // do not start an attempt which can not finish within the budget
+            auto resume = steady_clock::now() + microseconds(backoff_us);
+            if(budget_end != steady_clock::time_point::max() && resume + microseconds(timeoutUs) > budget_end)
+            {
+                break;
+            }
+            if(silent > 0)
+            {
+                std::this_thread::sleep_until(resume);
+            }
+            else
+            {
+                // every attempt got its answer, let the other threads use the idle wire
+                lock.unlock();
+                std::this_thread::sleep_until(resume);
+                lock.lock();
+            }
+            backoff_us *= 2;
+        }
+
+        TransportMetrics *metrics = xp->getMetrics();
+
+        auto start = steady_clock::now();
+        if(!xp->sendMessage(request))
+        {
+            continue;
+        }
+        sent++;
+        last_sent = start;
+        if(metrics != nullptr)
+        {
+            metrics->onRequest(request.dstAddr, request.msgId);
+        }
+
+        auto deadline = std::min(start + microseconds(timeoutUs), budget_end);
+        bool received = false;
+        Result<void> attempt_result = awaitReply(request.dstAddr, expected, deadline, reply, received);
+        if(attempt_result)
+        {
+            if(metrics != nullptr)
+            {
+                metrics->onRoundTrip(request.dstAddr, request.msgId, reply.timestampNs - xp->lastSentNs());
+            }
+            if(sentNs != nullptr)
+            {
+                *sentNs = xp->lastSentNs();
+            }
+
+            // the reply may have been the one of an earlier attempt, the others are still on the way
+            expect_late_replies();
+            return {};
+        }
+
+        if(attempt_result.error() == ERROR_NOK)
+        {
+            // the device refused the request, repeating it would not help
+            expect_late_replies();
+            return attempt_result;
+        }
+        if(error != ERROR_UNEXPECTED_MSGID)
+        {
+            error = attempt_result.error();
+        }
+
+        if(!received)
+        {
+            silent++;
+            if(metrics != nullptr)
+            {
+                metrics->onTimeout(request.dstAddr, request.msgId);
+            }
+        }
     }
 
-    Message reply_msg;
-    bool read_ok = xp->readMessage(reply_msg, _timeoutUs);
-    setTimeout(old_timeout);
+    expect_late_replies();
+    return std::unexpected(error);
+}
+
 
-    if(read_ok)
+Result<void> Master::awaitReply(
+    const address_t device_addr,
+    const std::initializer_list<msgid_t> &expected,
+    const std::chrono::steady_clock::time_point deadline,
+    Message &reply,
+    bool &received
+)
+{
+    using namespace std::chrono;
+
+    bool other_reply = false;
+
+    auto now = steady_clock::now();
+    while(now < deadline)
     {
-        if(reply_msg.msgId == MSGID_ACK_OK)
+        uint64_t remaining_us = duration_cast<microseconds>(deadline - now).count();
+        ReadStatus status = xp->receive(reply, remaining_us);
+        if(status == READ_TIMEOUT)
         {
-            return true;
+            break;
         }
-        else if(reply_msg.msgId == MSGID_ACK_NOK)
+        if(status == READ_CORRUPTED)
         {
-            return false;
+            // corrupted reply, retry right away instead of waiting for the deadline
+            received = true;
+            return std::unexpected(ERROR_CHECKSUM);
         }
-        else
+        now = steady_clock::now();
+
+        // late reply of another device
+        bool foreign = reply.srcAddr != device_addr;
+        // reply to a different request of the same device
+        bool other = !foreign && std::find(expected.begin(), expected.end(), reply.msgId) == expected.end();
+
+        if(other && reply.msgId == MSGID_ACK_NOK)
         {
-            throw std::runtime_error("Invalid write memory reply received.");
+            received = true;
+            return std::unexpected(ERROR_NOK);
         }
+
+        if(foreign || other)
+        {
+            if(foreign)
+            {
+                countLateReply(reply.srcAddr);
+            }
+            other_reply |= other;
+            if(xp->getMetrics() != nullptr)
+            {
+                xp->getMetrics()->onUnexpectedReply(reply.srcAddr, reply.msgId);
+            }
+            // events pushed by the leaves and late replies go to the registered handlers
+            xp->dispatch(reply);
+            continue;
+        }
+
+        received = true;
+        return {};
     }
-    else
+
+    return std::unexpected(other_reply ? ERROR_UNEXPECTED_MSGID : ERROR_TIMEOUT);
+}
+
+
+void Master::drainLateReplies(const address_t device_addr)
+{
+    using namespace std::chrono;
+
+    LateReplies &late = _lateReplies[device_addr];
+    Message message;
+
+    auto now = steady_clock::now();
+    while(late.count > 0 && now < late.deadline)
     {
-        throw TimeoutError("Write memory timeout.");
+        uint64_t remaining_us = duration_cast<microseconds>(late.deadline - now).count();
+        ReadStatus status = xp->receive(message, remaining_us);
+        if(status == READ_TIMEOUT)
+        {
+            break;
+        }
+        now = steady_clock::now();
+        if(status == READ_CORRUPTED)
+        {
+            continue;
+        }
+
+        countLateReply(message.srcAddr);
+        if(xp->getMetrics() != nullptr)
+        {
+            xp->getMetrics()->onUnexpectedReply(message.srcAddr, message.msgId);
+        }
+        xp->dispatch(message);
     }
 
+    // the replies which did not arrive in time are not waited for any more
+    late.count = 0;
 }
 
 
-void Master::setTimeout(const uint32_t timeoutUs)
+void Master::countLateReply(const address_t device_addr)
 {
-    _timeoutUs = timeoutUs;
+    LateReplies &late = _lateReplies[device_addr];
+    if(late.count > 0)
+    {
+        late.count--;
+    }
 }
 
 
@@ -4,9 +4,16 @@
 
 #include "MessageId.h"
 #include "Protocol.hpp"
+#include "Error.hpp"
 #include <vector> 
 #include <string>
 #include <stdexcept>
+#include <chrono>
+#include <initializer_list>
+#include <atomic>
+#include <array>
+#include <mutex>
+#include <utility>
 
 
 typedef struct 
@@ -15,11 +22,43 @@ typedef struct
     uint8_t v_major;
     uint8_t v_minor;
     float latency_ms;
+    /// @brief steady clock TX timestamp of the ping in nanoseconds
+    int64_t tx_ns;
+    /// @brief steady clock RX timestamp of the reply in nanoseconds
+    int64_t rx_ns;
 } ping_reply_t;
 
 
 typedef uint8_t address_t;
 
+
+/**
+ * @brief Range of device memory, several of them are read at once with READ_MULTI
+ * 
+ */
+typedef struct
+{
+    uint16_t offset;
+    uint8_t size;
+} memory_range_t;
+
+
+/**
+ * @brief Retry policy of a master operation
+ * 
+ */
+typedef struct
+{
+    /// @brief maximum number of attempts, including the first one
+    uint8_t maxAttempts;
+    /// @brief pause before the first retry in microseconds, doubled with every further retry
+    uint32_t backoffUs;
+    /// @brief time budget of the whole operation in microseconds, 0 for unlimited
+    uint64_t budgetUs;
+    /// @brief the request may be repeated once it was put on the bus
+    bool idempotent;
+} retry_policy_t;
+
 constexpr address_t BROADCAST_ADDRESS = 0xff;
 constexpr uint64_t _default_timeout_us = 10000; // 10ms
 
@@ -27,19 +66,127 @@ namespace Xerxes
 {
 
 
-class TimeoutError : public std::runtime_error
+/**
+ * @brief Operations of the master with their own retry policy
+ * 
+ */
+enum MasterOperation : uint8_t
 {
-public:
-    TimeoutError(const std::string &what_arg) : std::runtime_error(what_arg) {}
+    OP_PING = 0,
+    OP_READ,
+    OP_WRITE,
+    /// @brief requests of other protocols on top of the master, eg. bulk transfers
+    OP_CUSTOM,
+    OP_COUNT
 };
 
 
+/**
+ * @brief Outcome of a broadcast write
+ * 
+ */
+typedef struct
+{
+    /// @brief leaves which read back the written block after the broadcast
+    std::vector<address_t> verified;
+    /// @brief leaves which disagreed and were written again with an acknowledged write
+    std::vector<address_t> repaired;
+    /// @brief leaves which could not be read back nor repaired, with the reason of the failure
+    std::vector<std::pair<address_t, XerxesError>> failed;
+} broadcast_write_report_t;
+
+
+/**
+ * @brief Master of a bus, safe to call from many threads
+ * 
+ * The bus arbiter lets one thread at a time send a request and wait for its reply.
+ * Building the request and decoding the reply run outside the arbiter, so threads only
+ * wait for each other while the bus is busy. The backoff between retries runs outside
+ * the arbiter too, unless an attempt timed out and its reply may still arrive.
+ * 
+ * The only state kept between calls belongs to the bus rather than to a call: the retry
+ * policies and the replies still expected from the attempts which timed out, both guarded
+ * by the arbiter. Message handlers registered in the Protocol are called with the bus held.
+ * 
+ * A device may answer an attempt after its timeout. Such a reply is expected until twice
+ * the timeout after the last attempt, and the next request to the device waits for it so
+ * it is not taken for the reply to that request.
+ */
 class Master
 {
 private:
     Protocol *xp;
     address_t _my_addr;
-    uint32_t _timeoutUs;
+    std::atomic<uint32_t> _timeoutUs;
+
+    /// @brief bus arbiter, held for the wire transaction and guards the state of the bus below
+    mutable std::mutex _bus;
+
+    /// @brief retry policies indexed by MasterOperation
+    retry_policy_t _policies[OP_COUNT];
+
+    /**
+     * @brief Replies of a device to attempts which timed out, they may still arrive
+     * 
+     */
+    struct LateReplies
+    {
+        uint8_t count = 0;
+        /// @brief after this time point the device is not expected to answer them any more
+        std::chrono::steady_clock::time_point deadline;
+    };
+
+    /// @brief late replies indexed by the address of the device
+    std::array<LateReplies, 256> _lateReplies {};
+
+    /**
+     * @brief Send the request and wait for the reply, retrying according to the policy of the operation
+     * 
+     * @param op operation the request belongs to
+     * @param request request to send
+     * @param timeoutUs timeout of a single attempt in microseconds
+     * @param expected message ids accepted as the reply
+     * @param reply message to read the reply into
+     * @param sentNs TX timestamp of the request of the successful attempt in nanoseconds, may be nullptr
+     * @return Result<void> nothing if the reply was received, the reason of the failure of the attempts otherwise
+     */
+    Result<void> transact(
+        const MasterOperation op,
+        const Message &request,
+        const uint64_t timeoutUs,
+        const std::initializer_list<msgid_t> expected,
+        Message &reply,
+        int64_t *sentNs = nullptr
+    );
+
+    /**
+     * @brief Read messages until the reply from the device arrives, discarding stale and foreign frames
+     * 
+     * A corrupted frame or ACK_NOK of the device end the wait right away, other
+     * replies of the device are passed to the handlers like foreign frames.
+     * 
+     * @param received set to true if the reply of the device, its ACK_NOK or a corrupted frame was received
+     * @return Result<void> nothing if the reply was received before the deadline, the reason otherwise
+     */
+    Result<void> awaitReply(
+        const address_t device_addr,
+        const std::initializer_list<msgid_t> &expected,
+        const std::chrono::steady_clock::time_point deadline,
+        Message &reply,
+        bool &received
+    );
+
+    /**
+     * @brief Wait for the late replies of the device before the next request is sent to it
+     * 
+     * Without a sequence number a late reply can not be told from the reply to the next
+     * request, so the late replies are received and passed to the handlers first. The wait
+     * ends when all of them arrived or at their deadline.
+     */
+    void drainLateReplies(const address_t device_addr);
+
+    /// @brief a frame of the device arrived outside of its transaction, one late reply less to wait for
+    void countLateReply(const address_t device_addr);
 
 public:
     /**
@@ -58,16 +205,46 @@ public:
 
     void setTimeout(const uint32_t timeoutUs);
 
+    /// @brief Address the master sends from
+    address_t getAddr() const;
+
+    /**
+     * @brief Set the retry policy of an operation
+     * 
+     * Reads are retried by default, pings and writes are not. A write is repeated
+     * only if its policy is marked idempotent or if the request could not be sent.
+     * 
+     * @param op operation to set the policy for
+     * @param policy retry policy
+     */
+    void setRetryPolicy(const MasterOperation op, const retry_policy_t &policy);
+
+    /**
+     * @brief Get the retry policy of an operation
+     * 
+     * @param op operation
+     * @return retry_policy_t current policy
+     */
+    retry_policy_t getRetryPolicy(const MasterOperation op) const;
+
     /**
      * @brief Ping a device on the bus
      * 
      * @param device_addr device address
-     * @param timeoutUs timeout in microseconds
      * @return ping_reply_t with the ping reply
-     * @throw std::runtime_error if the ping fails
+     * @throw TimeoutError if the device does not reply
+     * @throw std::runtime_error if the reply is invalid
      */
     ping_reply_t ping(address_t device_addr);
 
+    /**
+     * @brief Ping a device on the bus without throwing
+     * 
+     * @param device_addr device address
+     * @return Result<ping_reply_t> the ping reply or the reason of the failure
+     */
+    Result<ping_reply_t> tryPing(address_t device_addr);
+
     /**
      * @brief Broadcast a message to all devices on the bus
      * 
@@ -101,10 +278,76 @@ public:
     void broadcast(const msgid_t msgid);
 
 
+    /**
+     * @brief Write the same memory block to many devices with one broadcast WRITE
+     * 
+     * The broadcast is verified by reading the block back, from every leaf or from a
+     * random sample of them. If a sampled leaf disagrees, all leaves are read back.
+     * Only the leaves which disagree or do not reply get an acknowledged write.
+     * 
+     * @param leaves devices which are expected to apply the write
+     * @param mem_addr memory address of the block
+     * @param data block to write
+     * @param size size of the block, up to MAX_WRITE_SIZE
+     * @param sample number of leaves to read back, 0 to read back all of them
+     * @return broadcast_write_report_t verified, repaired and failed leaves, each leaf in one of them at most
+     * @throw std::invalid_argument if the block does not fit into one WRITE
+     */
+    broadcast_write_report_t broadcastWrite(
+        const std::vector<address_t> &leaves,
+        const uint16_t mem_addr,
+        const uint8_t *data,
+        const uint8_t size,
+        const size_t sample = 0
+    );
+
+    template<class T>
+    broadcast_write_report_t broadcastWriteValue(
+        const std::vector<address_t> &leaves,
+        const uint16_t mem_addr,
+        const T value,
+        const size_t sample = 0
+    )
+    {
+        return broadcastWrite(leaves, mem_addr, (uint8_t*)&value, sizeof(T), sample);
+    }
+
+
+    /**
+     * @brief Send a message which has no reply, eg. a data block of a bulk transfer
+     * 
+     * @param message message to send
+     * @return true if the message was sent
+     */
+    bool post(const Message &message);
+
+    /**
+     * @brief Send a request and wait for its reply, retrying according to the OP_CUSTOM policy
+     * 
+     * Building block for protocols on top of the master. ACK_NOK of the device ends the
+     * request with ERROR_NOK unless it is expected.
+     * 
+     * @param request request to send
+     * @param expected message ids accepted as the reply
+     * @param reply message to read the reply into
+     * @param timeoutUs timeout of one attempt in microseconds, 0 for the timeout of the master
+     * @return Result<void> nothing if the reply was received, the reason of the failure otherwise
+     */
+    Result<void> tryRequest(
+        const Message &request,
+        const std::initializer_list<msgid_t> expected,
+        Message &reply,
+        const uint32_t timeoutUs = 0
+    );
+
+
     /**
      * @brief Synchronize all devices on the bus with SYNC packet
+     * 
+     * @return int64_t steady clock TX timestamp of the SYNC in nanoseconds, the reference
+     * of the sampling instants estimated by ClockCorrelator
      */
-    void sync();
+    int64_t sync();
 
 
     /**
@@ -113,7 +356,9 @@ public:
      * @param device_addr 
      * @param mem_addr 
      * @param size 
-     * @return std::vector<uint8_t> memory block
+     * @return std::vector<uint8_t> memory block of size bytes
+     * @throw TimeoutError if no reply arrived within the retry policy
+     * @throw std::runtime_error if the reply is invalid or of a different size
      */
     std::vector<uint8_t> readMemory(
         address_t device_addr, 
@@ -121,6 +366,104 @@ public:
         const uint8_t size
     );
 
+    /**
+     * @brief Read a block of memory from a device into a caller buffer
+     * 
+     * @overload
+     * @param data buffer of size bytes receiving the memory block
+     * @param timeoutUs timeout of one attempt in microseconds, 0 for the timeout of the master
+     * @throw TimeoutError if no reply arrived within the retry policy
+     * @throw std::runtime_error if the reply is invalid or of a different size
+     */
+    void readMemory(
+        address_t device_addr, 
+        const uint16_t mem_addr, 
+        const uint8_t size,
+        uint8_t *data,
+        const uint32_t timeoutUs = 0
+    );
+
+    /**
+     * @brief Read a block of memory from a device without throwing
+     * 
+     * @return Result<std::vector<uint8_t>> memory block of size bytes or the reason of the
+     * failure, ERROR_REPLY_SIZE for a reply of a different size
+     */
+    Result<std::vector<uint8_t>> tryReadMemory(
+        address_t device_addr, 
+        const uint16_t mem_addr, 
+        const uint8_t size
+    );
+
+    /**
+     * @brief Read a block of memory from a device into a caller buffer without throwing
+     * 
+     * @overload
+     * @param data buffer of size bytes receiving the memory block
+     * @param timeoutUs timeout of one attempt in microseconds, 0 for the timeout of the master
+     * @return Result<void> nothing on success, the reason of the failure otherwise
+     */
+    Result<void> tryReadMemory(
+        address_t device_addr, 
+        const uint16_t mem_addr, 
+        const uint8_t size,
+        uint8_t *data,
+        const uint32_t timeoutUs = 0
+    );
+
+    /**
+     * @brief Read several ranges of memory of a device, one READ_MULTI per frame worth of ranges
+     * 
+     * Adjacent ranges are merged, ranges which do not fit into one reply are split
+     * over as many requests as needed.
+     * 
+     * @param device_addr 
+     * @param ranges ranges to read
+     * @return std::vector<uint8_t> the ranges back to back, in the order of ranges
+     * @throw TimeoutError if no reply arrived within the retry policy
+     * @throw std::runtime_error if the reply is invalid or the device refused the read
+     */
+    std::vector<uint8_t> readMulti(
+        address_t device_addr, 
+        const std::vector<memory_range_t> &ranges
+    );
+
+    /**
+     * @brief Read several ranges of memory of a device into a caller buffer
+     * 
+     * @overload
+     * @param data buffer receiving the ranges back to back, as large as the ranges together
+     * @param timeoutUs timeout of one attempt in microseconds, 0 for the timeout of the master
+     */
+    void readMulti(
+        address_t device_addr, 
+        const std::vector<memory_range_t> &ranges,
+        uint8_t *data,
+        const uint32_t timeoutUs = 0
+    );
+
+    /**
+     * @brief Read several ranges of memory of a device into a caller buffer without throwing
+     * 
+     * @param data buffer receiving the ranges back to back, as large as the ranges together
+     * @param timeoutUs timeout of one attempt in microseconds, 0 for the timeout of the master
+     * @return Result<void> nothing on success, the reason of the first failed request otherwise,
+     * ERROR_NOK also if the device does not know READ_MULTI
+     */
+    Result<void> tryReadMulti(
+        address_t device_addr, 
+        const std::vector<memory_range_t> &ranges,
+        uint8_t *data,
+        const uint32_t timeoutUs = 0
+    );
+
+    /**
+     * @brief Write a block of memory of a device
+     * 
+     * @return true if the device acknowledged the write
+     * @return false if the device refused the write
+     * @throw TimeoutError if the device does not reply
+     */
     bool writeMemory(
         address_t device_addr, 
         const uint16_t mem_addr, 
@@ -128,14 +471,42 @@ public:
         const uint8_t size
     );
 
+    /**
+     * @brief Write a block of memory of a device without throwing
+     * 
+     * @return Result<void> nothing if the device acknowledged the write, ERROR_NOK if it refused it
+     */
+    Result<void> tryWriteMemory(
+        address_t device_addr, 
+        const uint16_t mem_addr, 
+        const uint8_t *data, 
+        const uint8_t size
+    );
+
     template<class T>
     T readValue(
         address_t device_addr, 
         const uint16_t mem_addr
     )
     {
-        std::vector<uint8_t> data = readMemory(device_addr, mem_addr, sizeof(T));
-        return *(T*)data.data();
+        T value;
+        readMemory(device_addr, mem_addr, sizeof(T), (uint8_t*)&value);
+        return value;
+    }
+
+    template<class T>
+    Result<T> tryReadValue(
+        address_t device_addr, 
+        const uint16_t mem_addr
+    )
+    {
+        T value;
+        Result<void> read = tryReadMemory(device_addr, mem_addr, sizeof(T), (uint8_t*)&value);
+        if(!read)
+        {
+            return std::unexpected(read.error());
+        }
+        return value;
     }
 
     template<class T>
@@ -148,6 +519,16 @@ public:
         return writeMemory(device_addr, mem_addr, (uint8_t*)&value, sizeof(T));
     }
 
+    template<class T>
+    Result<void> tryWriteValue(
+        address_t device_addr, 
+        const uint16_t mem_addr, 
+        const T value
+    )
+    {
+        return tryWriteMemory(device_addr, mem_addr, (uint8_t*)&value, sizeof(T));
+    }
+
 };
     
 } // namespace Xerxes
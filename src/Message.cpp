@@ -21,6 +21,7 @@ Message::Message(const Packet &packet)
     msgIdRaw.msgid_8.msgid_l = packet.at(4);
     msgIdRaw.msgid_8.msgid_h = packet.at(5);
     this->msgId = msgIdRaw.msgid_16;
+    this->timestampNs = packet.getTimestamp();
 
     for(uint16_t i=2; i<packet.size()-1; i++)
     {
@@ -141,4 +142,40 @@ bool packetIsValidMessage(const Packet &packet)
 }
 
 
+const char *msgIdName(const uint16_t msgId)
+{
+    switch(msgId)
+    {
+        case MSGID_PING: return "MSGID_PING";
+        case MSGID_PING_REPLY: return "MSGID_PING_REPLY";
+        case MSGID_ACK_OK: return "MSGID_ACK_OK";
+        case MSGID_ACK_NOK: return "MSGID_ACK_NOK";
+        case MSGID_SLEEP: return "MSGID_SLEEP";
+        case MSGID_GET_INFO: return "MSGID_GET_INFO";
+        case MSGID_INFO: return "MSGID_INFO";
+        case MSGID_RESET_HARD: return "MSGID_RESET_HARD";
+        case MSGID_RESET_SOFT: return "MSGID_RESET_SOFT";
+        case MSGID_FETCH_MEASUREMENT: return "MSGID_FETCH_MEASUREMENT";
+        case MSGID_SYNC: return "MSGID_SYNC";
+        case MSGID_WRITE: return "MSGID_WRITE";
+        case MSGID_READ: return "MSGID_READ";
+        case MSGID_READ_VALUE: return "MSGID_READ_VALUE";
+        case MSGID_READ_MULTI: return "MSGID_READ_MULTI";
+        case MSGID_BULK_BEGIN: return "MSGID_BULK_BEGIN";
+        case MSGID_BULK_DATA: return "MSGID_BULK_DATA";
+        case MSGID_BULK_QUERY: return "MSGID_BULK_QUERY";
+        case MSGID_BULK_STATUS: return "MSGID_BULK_STATUS";
+        case MSGID_BULK_COMMIT: return "MSGID_BULK_COMMIT";
+        case MSGID_BULK_ABORT: return "MSGID_BULK_ABORT";
+        case MSGID_PRESSURE: return "MSGID_PRESSURE";
+        case MSGID_STRAIN_24BIT: return "MSGID_STRAIN_24BIT";
+        case MSGID_PULSES: return "MSGID_PULSES";
+        case MSGID_DISTANCE_22MM: return "MSGID_DISTANCE_22MM";
+        case MSGID_DISTANCE_225MM: return "MSGID_DISTANCE_225MM";
+        case MSGID_ANGLE_DEG_XY: return "MSGID_ANGLE_DEG_XY";
+        default: return "MSGID_UNKNOWN";
+    }
+}
+
+
 } // namespace Xerxes
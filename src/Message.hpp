@@ -25,6 +25,8 @@ public:
     uint8_t dstAddr;
     /// @brief Message id of the message
     uint16_t msgId;
+    /// @brief Steady clock time the message was received in nanoseconds, 0 for a message to send
+    int64_t timestampNs = 0;
 
     /**
      * @brief Construct a new Message object
@@ -120,6 +122,15 @@ public:
 bool packetIsValidMessage(const Packet &packet);
 
 
+/**
+ * @brief Get the name of the message id as defined in MessageId.h
+ * 
+ * @param msgId message id
+ * @return const char* name of the message id, "MSGID_UNKNOWN" if not defined
+ */
+const char *msgIdName(const uint16_t msgId);
+
+
 } // namespace Xerxes
 
 #endif // !__MESSAGE_HPP
\ No newline at end of file
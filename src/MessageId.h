@@ -89,6 +89,43 @@ const msgid_t MSGID_WRITE                         = 0x0200;
  */            
 const msgid_t MSGID_READ                          = 0x0201;
 const msgid_t MSGID_READ_VALUE                    = 0x0202;
+
+/** Read several disjoint ranges of device registers in one request
+ * The request prototype is <MSGID_READ_MULTI> <uint16_t REG_ID_1> <LEN_1> ... <uint16_t REG_ID_N> <LEN_N>
+ * The reply is MSGID_READ_VALUE with the ranges back to back in the order of the request,
+ * MSGID_ACK_NOK if a range is out of bounds or the ranges do not fit into one reply
+ */
+const msgid_t MSGID_READ_MULTI                    = 0x0203;
+
+
+/** Start a bulk transfer of an image, eg. firmware or a lookup table
+ * The request prototype is <MSGID_BULK_BEGIN> <uint32_t SIZE> <uint8_t BLOCK_SIZE> <uint32_t CRC32>
+ * The reply is MSGID_ACK_OK, MSGID_ACK_NOK if the image does not fit
+ */
+const msgid_t MSGID_BULK_BEGIN                    = 0x0210;
+
+/** Block of a bulk transfer, no reply
+ * The message prototype is <MSGID_BULK_DATA> <uint16_t BLOCK> <uint16_t CRC16> <BYTE_1> ... <BYTE_BLOCK_SIZE>
+ */
+const msgid_t MSGID_BULK_DATA                     = 0x0211;
+
+/** Ask which blocks of a bulk transfer arrived
+ * The request prototype is <MSGID_BULK_QUERY> <uint16_t FIRST_BLOCK> <uint16_t BLOCKS>
+ */
+const msgid_t MSGID_BULK_QUERY                    = 0x0212;
+
+/** Reply to MSGID_BULK_QUERY, bit i of the bitmap is set if block FIRST_BLOCK + i arrived
+ * The reply prototype is <MSGID_BULK_STATUS> <uint16_t FIRST_BLOCK> <uint16_t BLOCKS> <uint32_t BUSY_US> <BITMAP>
+ */
+const msgid_t MSGID_BULK_STATUS                   = 0x0213;
+
+/** Finish a bulk transfer, the device verifies the CRC32 of the whole image
+ * The reply is MSGID_ACK_OK, MSGID_ACK_NOK if a block is missing or the CRC32 does not match
+ */
+const msgid_t MSGID_BULK_COMMIT                   = 0x0214;
+
+/** Abandon a bulk transfer, the reply is MSGID_ACK_OK */
+const msgid_t MSGID_BULK_ABORT                    = 0x0215;
     
 /** Pressure value w/o temperature*/    
 const msgid_t MSGID_PRESSURE                      = 0x0400;
@@ -0,0 +1,64 @@
+#include "MessageQueue.hpp"
+#include <chrono>
+
+namespace Xerxes
+{
+
+
+MessageQueue::MessageQueue(const size_t capacity) : _slots(capacity)
+{
+}
+
+
+MessageQueue::~MessageQueue()
+{
+}
+
+
+bool MessageQueue::push(const Message &message)
+{
+    {
+        std::lock_guard<std::mutex> guard(_lock);
+        if(_count == _slots.size())
+        {
+            _dropped++;
+            return false;
+        }
+        // assignment reuses the buffer of the slot
+        _slots[(_head + _count) % _slots.size()] = message;
+        _count++;
+    }
+    _ready.notify_one();
+    return true;
+}
+
+
+bool MessageQueue::pop(Message &message, const uint64_t timeoutUs)
+{
+    std::unique_lock<std::mutex> guard(_lock);
+    if(!_ready.wait_for(guard, std::chrono::microseconds(timeoutUs), [this]{ return _count > 0; }))
+    {
+        return false;
+    }
+    std::swap(message, _slots[_head]);
+    _head = (_head + 1) % _slots.size();
+    _count--;
+    return true;
+}
+
+
+size_t MessageQueue::size() const
+{
+    std::lock_guard<std::mutex> guard(_lock);
+    return _count;
+}
+
+
+uint64_t MessageQueue::dropped() const
+{
+    std::lock_guard<std::mutex> guard(_lock);
+    return _dropped;
+}
+
+
+} // namespace Xerxes
@@ -0,0 +1,70 @@
+#ifndef __MESSAGE_QUEUE_HPP
+#define __MESSAGE_QUEUE_HPP
+
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <stddef.h>
+#include <vector>
+#include "Message.hpp"
+
+namespace Xerxes
+{
+
+
+/**
+ * @brief Bounded queue handing messages over from the receive thread to a consumer
+ *
+ * The slots are allocated up front and reused, a message arriving to a full queue is
+ * dropped and counted so the receive thread never blocks.
+ */
+class MessageQueue
+{
+private:
+    std::vector<Message> _slots;
+    size_t _head = 0;
+    size_t _count = 0;
+    uint64_t _dropped = 0;
+
+    mutable std::mutex _lock;
+    std::condition_variable _ready;
+
+public:
+    /**
+     * @brief Construct a new Message Queue object
+     *
+     * @param capacity maximal number of waiting messages
+     */
+    MessageQueue(const size_t capacity);
+    ~MessageQueue();
+
+    /**
+     * @brief Add a message, never blocks
+     *
+     * @param message message to add
+     * @return true if the message was queued
+     * @return false if the queue is full and the message was dropped
+     */
+    bool push(const Message &message);
+
+    /**
+     * @brief Take the oldest message, wait for one if the queue is empty
+     *
+     * @param message message to read into
+     * @param timeoutUs timeout in microseconds
+     * @return true if a message was taken
+     * @return false if the queue stayed empty
+     */
+    bool pop(Message &message, const uint64_t timeoutUs);
+
+    /// @brief Number of waiting messages
+    size_t size() const;
+
+    /// @brief Number of messages dropped because the queue was full
+    uint64_t dropped() const;
+};
+
+
+} // namespace Xerxes
+
+#endif // !__MESSAGE_QUEUE_HPP
@@ -0,0 +1,380 @@
+#include "Metrics.hpp"
+#include <bit>
+#include <cinttypes>
+#include <cstdio>
+#include <fstream>
+
+namespace Xerxes
+{
+
+
+uint64_t HistogramSnapshot::percentile(const double q) const
+{
+    if(count == 0)
+    {
+        return 0;
+    }
+
+    // rank of the value, 1 based
+    uint64_t rank = (uint64_t)(q * (double)count);
+    if(rank < 1)
+    {
+        rank = 1;
+    }
+    if(rank > count)
+    {
+        rank = count;
+    }
+
+    uint64_t seen = 0;
+    for(size_t i = 0; i < HISTOGRAM_BUCKETS; i++)
+    {
+        seen += buckets[i];
+        if(seen >= rank)
+        {
+            return LatencyHistogram::bucketUpperBound(i);
+        }
+    }
+
+    return LatencyHistogram::bucketUpperBound(HISTOGRAM_BUCKETS - 1);
+}
+
+
+size_t LatencyHistogram::bucketOf(const uint64_t value)
+{
+    if(value < HISTOGRAM_SUB_BUCKETS)
+    {
+        return value;
+    }
+
+    const size_t msb = std::bit_width(value) - 1;
+    const size_t shift = msb - 3;
+    return (msb - 2) * HISTOGRAM_SUB_BUCKETS + ((value >> shift) & (HISTOGRAM_SUB_BUCKETS - 1));
+}
+
+
+uint64_t LatencyHistogram::bucketUpperBound(const size_t bucket)
+{
+    if(bucket < HISTOGRAM_SUB_BUCKETS)
+    {
+        return bucket;
+    }
+
+    const size_t msb = bucket / HISTOGRAM_SUB_BUCKETS + 2;
+    const size_t shift = msb - 3;
+    const uint64_t lower = (uint64_t)(HISTOGRAM_SUB_BUCKETS + bucket % HISTOGRAM_SUB_BUCKETS) << shift;
+    return lower + (((uint64_t)1 << shift) - 1);
+}
+
+
+void LatencyHistogram::record(const uint64_t value)
+{
+    _buckets[bucketOf(value)].fetch_add(1, std::memory_order_relaxed);
+}
+
+
+HistogramSnapshot LatencyHistogram::snapshot() const
+{
+    HistogramSnapshot snap;
+    for(size_t i = 0; i < HISTOGRAM_BUCKETS; i++)
+    {
+        snap.buckets[i] = _buckets[i].load(std::memory_order_relaxed);
+        snap.count += snap.buckets[i];
+    }
+    return snap;
+}
+
+
+static CountersSnapshot copyCounters(const TransportCounters &counters)
+{
+    CountersSnapshot snap;
+    snap.requests = counters.requests.load(std::memory_order_relaxed);
+    snap.timeouts = counters.timeouts.load(std::memory_order_relaxed);
+    snap.checksumErrors = counters.checksumErrors.load(std::memory_order_relaxed);
+    snap.unexpectedReplies = counters.unexpectedReplies.load(std::memory_order_relaxed);
+    snap.bytesSent = counters.bytesSent.load(std::memory_order_relaxed);
+    snap.bytesReceived = counters.bytesReceived.load(std::memory_order_relaxed);
+    snap.rtt = counters.rtt.snapshot();
+    return snap;
+}
+
+
+static bool hasTraffic(const CountersSnapshot &snap)
+{
+    return snap.requests || snap.timeouts || snap.checksumErrors || snap.unexpectedReplies ||
+        snap.bytesSent || snap.bytesReceived;
+}
+
+
+TransportMetrics::TransportMetrics()
+{
+}
+
+
+TransportMetrics::~TransportMetrics()
+{
+}
+
+
+TransportCounters &TransportMetrics::messageCounters(const msgid_t msgId)
+{
+    const uint32_t key = (uint32_t)msgId + 1;
+    // message ids are clustered in the low bits of both bytes
+    size_t slot = (msgId ^ (msgId >> 5)) % METRICS_MSGID_SLOTS;
+
+    for(size_t probe = 0; probe < METRICS_MSGID_SLOTS; probe++)
+    {
+        uint32_t current = _msgIdKeys[slot].load(std::memory_order_acquire);
+        if(current == key)
+        {
+            return _messages[slot];
+        }
+        if(current == 0)
+        {
+            if(_msgIdKeys[slot].compare_exchange_strong(current, key, std::memory_order_acq_rel))
+            {
+                return _messages[slot];
+            }
+            if(current == key)
+            {
+                // claimed by another thread in the meantime
+                return _messages[slot];
+            }
+        }
+        slot = (slot + 1) % METRICS_MSGID_SLOTS;
+    }
+
+    return _otherMessages;
+}
+
+
+void TransportMetrics::onRequest(const uint8_t address, const msgid_t msgId)
+{
+    _addresses[address].requests.fetch_add(1, std::memory_order_relaxed);
+    messageCounters(msgId).requests.fetch_add(1, std::memory_order_relaxed);
+}
+
+
+void TransportMetrics::onTimeout(const uint8_t address, const msgid_t msgId)
+{
+    _addresses[address].timeouts.fetch_add(1, std::memory_order_relaxed);
+    messageCounters(msgId).timeouts.fetch_add(1, std::memory_order_relaxed);
+}
+
+
+void TransportMetrics::onChecksumError(const uint8_t address)
+{
+    _addresses[address].checksumErrors.fetch_add(1, std::memory_order_relaxed);
+}
+
+
+void TransportMetrics::onUnexpectedReply(const uint8_t address, const msgid_t msgId)
+{
+    _addresses[address].unexpectedReplies.fetch_add(1, std::memory_order_relaxed);
+    messageCounters(msgId).unexpectedReplies.fetch_add(1, std::memory_order_relaxed);
+}
+
+
+void TransportMetrics::onBytesSent(const uint8_t address, const msgid_t msgId, const size_t bytes)
+{
+    _addresses[address].bytesSent.fetch_add(bytes, std::memory_order_relaxed);
+    messageCounters(msgId).bytesSent.fetch_add(bytes, std::memory_order_relaxed);
+}
+
+
+void TransportMetrics::onBytesReceived(const uint8_t address, const msgid_t msgId, const size_t bytes)
+{
+    _addresses[address].bytesReceived.fetch_add(bytes, std::memory_order_relaxed);
+    messageCounters(msgId).bytesReceived.fetch_add(bytes, std::memory_order_relaxed);
+}
+
+
+void TransportMetrics::onRoundTrip(const uint8_t address, const msgid_t msgId, const uint64_t rttNs)
+{
+    _addresses[address].rtt.record(rttNs);
+    messageCounters(msgId).rtt.record(rttNs);
+}
+
+
+MetricsSnapshot TransportMetrics::snapshot() const
+{
+    MetricsSnapshot snap;
+
+    for(size_t addr = 0; addr < _addresses.size(); addr++)
+    {
+        CountersSnapshot counters = copyCounters(_addresses[addr]);
+        if(hasTraffic(counters))
+        {
+            snap.addresses.emplace_back((uint8_t)addr, counters);
+        }
+    }
+
+    for(size_t slot = 0; slot < METRICS_MSGID_SLOTS; slot++)
+    {
+        uint32_t key = _msgIdKeys[slot].load(std::memory_order_acquire);
+        if(key != 0)
+        {
+            snap.messages.emplace_back((msgid_t)(key - 1), copyCounters(_messages[slot]));
+        }
+    }
+
+    snap.otherMessages = copyCounters(_otherMessages);
+
+    return snap;
+}
+
+
+/// @brief Labelled counters to be exported
+typedef std::pair<std::string, const CountersSnapshot *> labelled_counters_t;
+
+
+static void appendCounter(
+    std::string &out,
+    const char *name,
+    const std::vector<labelled_counters_t> &entries,
+    uint64_t CountersSnapshot::*member
+)
+{
+    char line[256];
+
+    snprintf(line, sizeof(line), "# TYPE %s counter\n", name);
+    out += line;
+    for(const auto &[label, counters] : entries)
+    {
+        snprintf(line, sizeof(line), "%s{%s} %" PRIu64 "\n", name, label.c_str(), counters->*member);
+        out += line;
+    }
+}
+
+
+/// @brief counters and round trip times of one family, eg. xerxes_leaf_requests_total
+static void appendFamily(std::string &out, const std::string &family, const std::vector<labelled_counters_t> &entries)
+{
+    appendCounter(out, (family + "_requests_total").c_str(), entries, &CountersSnapshot::requests);
+    appendCounter(out, (family + "_timeouts_total").c_str(), entries, &CountersSnapshot::timeouts);
+    appendCounter(out, (family + "_checksum_errors_total").c_str(), entries, &CountersSnapshot::checksumErrors);
+    appendCounter(out, (family + "_unexpected_replies_total").c_str(), entries, &CountersSnapshot::unexpectedReplies);
+    appendCounter(out, (family + "_bytes_sent_total").c_str(), entries, &CountersSnapshot::bytesSent);
+    appendCounter(out, (family + "_bytes_received_total").c_str(), entries, &CountersSnapshot::bytesReceived);
+
+    char line[256];
+    const double quantiles[] = {0.5, 0.99, 0.999};
+    const char *name = family.c_str();
+    snprintf(line, sizeof(line), "# TYPE %s_rtt_seconds summary\n", name);
+    out += line;
+    for(const auto &[label, counters] : entries)
+    {
+        for(const double q : quantiles)
+        {
+            snprintf(
+                line, sizeof(line), "%s_rtt_seconds{%s,quantile=\"%g\"} %.9f\n",
+                name, label.c_str(), q, (double)counters->rtt.percentile(q) * 1e-9
+            );
+            out += line;
+        }
+        snprintf(line, sizeof(line), "%s_rtt_seconds_count{%s} %" PRIu64 "\n", name, label.c_str(), counters->rtt.count);
+        out += line;
+    }
+}
+
+
+std::string TransportMetrics::toPrometheus(const MetricsSnapshot &snapshot)
+{
+    std::vector<labelled_counters_t> leaves;
+    std::vector<labelled_counters_t> messages;
+    char label[32];
+
+    for(const auto &[addr, counters] : snapshot.addresses)
+    {
+        snprintf(label, sizeof(label), "address=\"%u\"", addr);
+        leaves.emplace_back(label, &counters);
+    }
+    for(const auto &[id, counters] : snapshot.messages)
+    {
+        snprintf(label, sizeof(label), "msgid=\"0x%04x\"", id);
+        messages.emplace_back(label, &counters);
+    }
+    if(hasTraffic(snapshot.otherMessages))
+    {
+        messages.emplace_back("msgid=\"other\"", &snapshot.otherMessages);
+    }
+
+    // every request is counted once per leaf and once per message id, so the two views
+    // go to separate families and a sum over a family counts it once
+    std::string out;
+    appendFamily(out, "xerxes_leaf", leaves);
+    appendFamily(out, "xerxes_msgid", messages);
+    return out;
+}
+
+
+static void appendJson(std::string &out, const CountersSnapshot &counters)
+{
+    char buf[512];
+    snprintf(
+        buf, sizeof(buf),
+        "\"requests\":%" PRIu64 ",\"timeouts\":%" PRIu64 ",\"checksum_errors\":%" PRIu64 ",\"unexpected_replies\":%" PRIu64 ","
+        "\"bytes_sent\":%" PRIu64 ",\"bytes_received\":%" PRIu64 ","
+        "\"rtt_ns\":{\"count\":%" PRIu64 ",\"p50\":%" PRIu64 ",\"p99\":%" PRIu64 ",\"p999\":%" PRIu64 "}",
+        counters.requests, counters.timeouts, counters.checksumErrors, counters.unexpectedReplies,
+        counters.bytesSent, counters.bytesReceived, counters.rtt.count,
+        counters.rtt.percentile(0.5), counters.rtt.percentile(0.99), counters.rtt.percentile(0.999)
+    );
+    out += buf;
+}
+
+
+std::string TransportMetrics::toJson(const MetricsSnapshot &snapshot)
+{
+    std::string out = "{\"addresses\":[";
+    char buf[32];
+
+    for(size_t i = 0; i < snapshot.addresses.size(); i++)
+    {
+        snprintf(buf, sizeof(buf), "%s{\"address\":%u,", i ? "," : "", snapshot.addresses[i].first);
+        out += buf;
+        appendJson(out, snapshot.addresses[i].second);
+        out += "}";
+    }
+
+    out += "],\"messages\":[";
+    for(size_t i = 0; i < snapshot.messages.size(); i++)
+    {
+        snprintf(buf, sizeof(buf), "%s{\"msgid\":%u,", i ? "," : "", snapshot.messages[i].first);
+        out += buf;
+        appendJson(out, snapshot.messages[i].second);
+        out += "}";
+    }
+
+    out += "],\"other_messages\":{";
+    appendJson(out, snapshot.otherMessages);
+    out += "}}\n";
+
+    return out;
+}
+
+
+bool TransportMetrics::writeFile(const std::string &path, const bool json) const
+{
+    const MetricsSnapshot snap = snapshot();
+    const std::string text = json ? toJson(snap) : toPrometheus(snap);
+    const std::string tmp_path = path + ".tmp";
+
+    {
+        std::ofstream file(tmp_path, std::ios::out | std::ios::trunc);
+        if(!file)
+        {
+            return false;
+        }
+        file << text;
+        if(!file)
+        {
+            return false;
+        }
+    }
+
+    return std::rename(tmp_path.c_str(), path.c_str()) == 0;
+}
+
+
+} // namespace Xerxes
@@ -0,0 +1,196 @@
+#ifndef __METRICS_HPP
+#define __METRICS_HPP
+
+#include <atomic>
+#include <array>
+#include <vector>
+#include <string>
+#include <cstdint>
+#include <stddef.h>
+#include "MessageId.h"
+
+namespace Xerxes
+{
+
+
+/// @brief Number of sub-buckets per power of two of the latency histogram
+constexpr size_t HISTOGRAM_SUB_BUCKETS = 8;
+
+/// @brief Number of buckets of the latency histogram, covers the whole uint64_t range
+constexpr size_t HISTOGRAM_BUCKETS = (64 - 2) * HISTOGRAM_SUB_BUCKETS;
+
+/// @brief Number of distinct message ids tracked by the metrics, the rest is folded into one slot
+constexpr size_t METRICS_MSGID_SLOTS = 64;
+
+
+/**
+ * @brief Copy of the latency histogram
+ *
+ */
+struct HistogramSnapshot
+{
+    /// @brief number of values in each bucket
+    std::array<uint64_t, HISTOGRAM_BUCKETS> buckets {};
+    /// @brief total number of values
+    uint64_t count = 0;
+
+    /**
+     * @brief Estimate the quantile of the recorded values
+     *
+     * @param q quantile in range 0..1
+     * @return uint64_t upper bound of the bucket holding the quantile, 0 if empty
+     */
+    uint64_t percentile(const double q) const;
+};
+
+
+/**
+ * @brief Lock-free log-linear histogram (HDR-style) of latencies
+ *
+ * Each power of two is split into HISTOGRAM_SUB_BUCKETS buckets, so the relative
+ * error of a reported value is at most 1/HISTOGRAM_SUB_BUCKETS.
+ */
+class LatencyHistogram
+{
+private:
+    std::array<std::atomic<uint64_t>, HISTOGRAM_BUCKETS> _buckets {};
+public:
+    /**
+     * @brief Record a value, safe to call from any thread
+     *
+     * @param value latency, usually in nanoseconds
+     */
+    void record(const uint64_t value);
+
+    /// @brief Copy the histogram, does not block the writers
+    HistogramSnapshot snapshot() const;
+
+    /// @brief Index of the bucket the value falls into
+    static size_t bucketOf(const uint64_t value);
+
+    /// @brief Highest value falling into the bucket
+    static uint64_t bucketUpperBound(const size_t bucket);
+};
+
+
+/**
+ * @brief Transport counters of one address or message id
+ *
+ */
+struct TransportCounters
+{
+    std::atomic<uint64_t> requests {0};
+    std::atomic<uint64_t> timeouts {0};
+    std::atomic<uint64_t> checksumErrors {0};
+    std::atomic<uint64_t> unexpectedReplies {0};
+    std::atomic<uint64_t> bytesSent {0};
+    std::atomic<uint64_t> bytesReceived {0};
+    /// @brief round trip times in nanoseconds
+    LatencyHistogram rtt;
+};
+
+
+/**
+ * @brief Plain copy of TransportCounters
+ *
+ */
+struct CountersSnapshot
+{
+    uint64_t requests = 0;
+    uint64_t timeouts = 0;
+    uint64_t checksumErrors = 0;
+    uint64_t unexpectedReplies = 0;
+    uint64_t bytesSent = 0;
+    uint64_t bytesReceived = 0;
+    HistogramSnapshot rtt;
+};
+
+
+/**
+ * @brief Consistent-enough copy of the whole registry for export
+ *
+ */
+struct MetricsSnapshot
+{
+    /// @brief counters of the addresses with any traffic
+    std::vector<std::pair<uint8_t, CountersSnapshot>> addresses;
+    /// @brief counters of the message ids with any traffic
+    std::vector<std::pair<msgid_t, CountersSnapshot>> messages;
+    /// @brief counters of message ids which did not fit into the table
+    CountersSnapshot otherMessages;
+};
+
+
+/**
+ * @brief Per-address and per-message id transport metrics of one bus
+ *
+ * All updates are relaxed atomic increments, so the polling thread never waits for
+ * a reader. The registry is large (about 1.3MB), allocate it on the heap.
+ */
+class TransportMetrics
+{
+private:
+    std::array<TransportCounters, 256> _addresses;
+
+    /// @brief msgid + 1 of each slot, 0 for a free slot
+    std::array<std::atomic<uint32_t>, METRICS_MSGID_SLOTS> _msgIdKeys {};
+    std::array<TransportCounters, METRICS_MSGID_SLOTS> _messages;
+    TransportCounters _otherMessages;
+
+    /// @brief find or claim the slot of the message id
+    TransportCounters &messageCounters(const msgid_t msgId);
+
+public:
+    TransportMetrics();
+    ~TransportMetrics();
+
+    /// @brief A request was put on the bus
+    void onRequest(const uint8_t address, const msgid_t msgId);
+
+    /// @brief No reply to the request arrived in time
+    void onTimeout(const uint8_t address, const msgid_t msgId);
+
+    /// @brief A frame with a bad checksum was received, most likely from the address
+    void onChecksumError(const uint8_t address);
+
+    /// @brief A reply nobody was waiting for was received and discarded
+    void onUnexpectedReply(const uint8_t address, const msgid_t msgId);
+
+    /// @brief A frame of the given size was sent to the address
+    void onBytesSent(const uint8_t address, const msgid_t msgId, const size_t bytes);
+
+    /// @brief A frame of the given size was received from the address
+    void onBytesReceived(const uint8_t address, const msgid_t msgId, const size_t bytes);
+
+    /// @brief A request was answered after rttNs nanoseconds
+    void onRoundTrip(const uint8_t address, const msgid_t msgId, const uint64_t rttNs);
+
+    /**
+     * @brief Copy all counters, safe to call from any thread
+     *
+     * @return MetricsSnapshot copy of the counters with any traffic
+     */
+    MetricsSnapshot snapshot() const;
+
+    /// @brief Format the snapshot in Prometheus text exposition format, the per leaf and the per
+    /// message id counters go to the xerxes_leaf_* and xerxes_msgid_* families
+    static std::string toPrometheus(const MetricsSnapshot &snapshot);
+
+    /// @brief Format the snapshot as JSON
+    static std::string toJson(const MetricsSnapshot &snapshot);
+
+    /**
+     * @brief Export the metrics into a file, replaced atomically so a scraper never reads a partial file
+     *
+     * @param path destination file
+     * @param json true for JSON, false for Prometheus text format
+     * @return true if the file was written
+     * @return false on I/O error
+     */
+    bool writeFile(const std::string &path, const bool json) const;
+};
+
+
+} // namespace Xerxes
+
+#endif // !__METRICS_HPP
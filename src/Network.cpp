@@ -1,4 +1,5 @@
 #include "Network.hpp"
+#include <cstring>
 
 
 namespace Xerxes
@@ -14,4 +15,17 @@ Network::~Network()
 }
 
 
+size_t Network::readRaw(const uint64_t timeoutUs, uint8_t *buffer, const size_t size)
+{
+    Packet packet;
+    if(!readData(timeoutUs, packet))
+    {
+        return 0;
+    }
+    const size_t length = packet.size() < size ? packet.size() : size;
+    memcpy(buffer, packet.data(), length);
+    return length;
+}
+
+
 } // namespace Xerxes
\ No newline at end of file
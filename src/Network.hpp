@@ -40,12 +40,31 @@ public:
     /**
      * @brief Read data from the network - overload this function to implement the network interface
      * 
+     * Implementations with kernel or hardware receive timestamps (SO_TIMESTAMPNS, serial
+     * drivers) should store them in the packet with Packet::setTimestamp() on the steady
+     * clock, see realtimeToSteadyNs(). Packets left without a timestamp are stamped by the
+     * protocol when they are read.
+     * 
      * @param timeoutUs timeout in microseconds
      * @param packet packet to read the data to
      * @return true if the packet was read successfully
      * @return false if the packet was not read successfully
      */
     virtual bool readData(const uint64_t timeoutUs, Packet &packet) = 0;
+
+    /**
+     * @brief Read raw bytes from the network as they arrive, without framing
+     * 
+     * Used by passive listeners which reconstruct the frames themselves. The default
+     * implementation reads one packet with readData(), overload it for byte streams
+     * like serial ports.
+     * 
+     * @param timeoutUs timeout in microseconds
+     * @param buffer buffer to read into
+     * @param size size of the buffer, at least 256 bytes for the default implementation
+     * @return size_t number of bytes read, 0 on timeout
+     */
+    virtual size_t readRaw(const uint64_t timeoutUs, uint8_t *buffer, const size_t size);
 };
 
 
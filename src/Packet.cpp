@@ -79,6 +79,16 @@ namespace Xerxes
         _data = data;
     }
 
+    void Packet::setTimestamp(const int64_t timestampNs)
+    {
+        _timestampNs = timestampNs;
+    }
+
+    int64_t Packet::getTimestamp() const
+    {
+        return _timestampNs;
+    }
+
     bool Packet::isValidPacket() const
     {
         if (_data[0] != SOH)
@@ -35,6 +35,9 @@ private:
 
     /// @brief Size of the packet
     size_t _size;
+
+    /// @brief Steady clock time the packet was received in nanoseconds, 0 if not known
+    int64_t _timestampNs = 0;
 public:
     /**
      * @brief Construct a new Packet object
@@ -72,6 +75,19 @@ public:
 
     const uint8_t *data() const;
 
+    /**
+     * @brief Set the time the packet was received
+     * 
+     * Network implementations with hardware or kernel timestamps set it when reading the
+     * packet, otherwise the protocol stamps the packet as soon as it gets it.
+     * 
+     * @param timestampNs steady clock time in nanoseconds, see steadyNowNs()
+     */
+    void setTimestamp(const int64_t timestampNs);
+
+    /// @brief Get the time the packet was received in nanoseconds, 0 if not known
+    int64_t getTimestamp() const;
+
     /**
      * @brief Get the empty packet with SOH, LEN and checksum precalcualted
      * 
@@ -1,4 +1,5 @@
 #include "Protocol.hpp"
+#include "Clock.hpp"
 
 namespace Xerxes
 {
@@ -12,29 +13,169 @@ Protocol::~Protocol()
 {
 }
 
+void Protocol::setMetrics(TransportMetrics *metrics)
+{
+    _metrics = metrics;
+}
+
+
+TransportMetrics *Protocol::getMetrics() const
+{
+    return _metrics;
+}
+
+
+void Protocol::setTrace(FrameTrace *trace)
+{
+    _trace = trace;
+}
+
+
 bool Protocol::sendMessage(Message &message) const
 {
-    return xn->sendData(message.toPacket());
+    return sendMessage(static_cast<const Message &>(message));
 }
 
 
 bool Protocol::sendMessage(const Message &message) const
 {
-    return xn->sendData(message.toPacket());
+    const Packet packet = message.toPacket();
+    _lastDestination = message.dstAddr;
+
+    const int64_t sentNs = steadyNowNs();
+    bool sent = xn->sendData(packet);
+    if(sent)
+    {
+        _lastSentNs = sentNs;
+    }
+    if(sent && _trace != nullptr)
+    {
+        _trace->record(TRACE_TX, packet.data(), packet.size(), sentNs);
+    }
+    if(sent && _metrics != nullptr)
+    {
+        _metrics->onBytesSent(message.dstAddr, message.msgId, packet.size());
+    }
+    return sent;
+}
+
+
+int64_t Protocol::lastSentNs() const
+{
+    return _lastSentNs;
 }
 
 
 bool Protocol::readMessage(Message &message, const uint64_t timeoutUs)
+{
+    return receive(message, timeoutUs) == READ_OK;
+}
+
+
+ReadStatus Protocol::receive(Message &message, const uint64_t timeoutUs)
 {
     Packet packet = Packet();
     
-    if(xn->readData(timeoutUs, packet))
-    {        
-        message = Message(packet);
-        return true;
+    if(!xn->readData(timeoutUs, packet))
+    {
+        return READ_TIMEOUT;
+    }
+    if(packet.getTimestamp() == 0)
+    {
+        packet.setTimestamp(steadyNowNs());
+    }
+
+    if(!packetIsValidMessage(packet) || !packet.isValidPacket())
+    {
+        if(_trace != nullptr)
+        {
+            _trace->record(TRACE_RX_CORRUPTED, packet.data(), packet.size(), packet.getTimestamp());
+        }
+        if(_metrics != nullptr)
+        {
+            _metrics->onChecksumError(_lastDestination);
+        }
+        return READ_CORRUPTED;
+    }
+
+    if(_trace != nullptr)
+    {
+        _trace->record(TRACE_RX, packet.data(), packet.size(), packet.getTimestamp());
+    }
+
+    message = Message(packet);
+    if(_metrics != nullptr)
+    {
+        _metrics->onBytesReceived(message.srcAddr, message.msgId, packet.size());
+    }
+    return READ_OK;
+}
+
+void Protocol::onMessage(const msgid_t msgId, message_handler_t handler)
+{
+    std::unique_ptr<HandlerPage> &page = _msgIdHandlers[msgId >> 8];
+    if(page == nullptr)
+    {
+        page = std::make_unique<HandlerPage>();
+    }
+    (*page)[msgId & 0xff] = std::move(handler);
+}
+
+
+void Protocol::onMessage(const msgid_t msgId, MessageQueue &queue)
+{
+    onMessage(msgId, [&queue](const Message &message){ queue.push(message); });
+}
+
+
+void Protocol::onSource(const uint8_t srcAddr, message_handler_t handler)
+{
+    _sourceHandlers[srcAddr] = std::move(handler);
+}
+
+
+void Protocol::onSource(const uint8_t srcAddr, MessageQueue &queue)
+{
+    onSource(srcAddr, [&queue](const Message &message){ queue.push(message); });
+}
+
+
+bool Protocol::dispatch(const Message &message) const
+{
+    bool handled = false;
+
+    const std::unique_ptr<HandlerPage> &page = _msgIdHandlers[message.msgId >> 8];
+    if(page != nullptr && (*page)[message.msgId & 0xff])
+    {
+        (*page)[message.msgId & 0xff](message);
+        handled = true;
     }
 
-    return false;
+    const message_handler_t &source = _sourceHandlers[message.srcAddr];
+    if(source)
+    {
+        source(message);
+        handled = true;
+    }
+    return handled;
 }
 
+
+size_t Protocol::poll(const uint64_t timeoutUs)
+{
+    size_t received = 0;
+    Message message;
+    ReadStatus status;
+    while((status = receive(message, timeoutUs)) != READ_TIMEOUT)
+    {
+        if(status == READ_OK)
+        {
+            dispatch(message);
+            received++;
+        }
+    }
+    return received;
+}
+
+
 } // namespace Xerxes
\ No newline at end of file
@@ -3,11 +3,39 @@
 
 #include "Network.hpp"
 #include "Message.hpp"
+#include "Metrics.hpp"
+#include "Trace.hpp"
+#include "MessageQueue.hpp"
+#include <array>
+#include <functional>
+#include <memory>
 
 namespace Xerxes
 {
     
 
+/**
+ * @brief Result of reading a message from the network
+ * 
+ */
+enum ReadStatus : uint8_t
+{
+    /// @brief a valid message was read
+    READ_OK = 0,
+    /// @brief nothing was received in time
+    READ_TIMEOUT,
+    /// @brief a frame was received but it is not a valid message
+    READ_CORRUPTED
+};
+
+
+/**
+ * @brief Handler of messages which are not a reply awaited by the master
+ * 
+ */
+typedef std::function<void(const Message &)> message_handler_t;
+
+
 /**
  * @brief Protocol class
  * 
@@ -21,10 +49,47 @@ private:
      * 
      */
     Network *xn;
+
+    /// @brief transport metrics of the bus, may be nullptr
+    TransportMetrics *_metrics = nullptr;
+
+    /// @brief frame trace of the bus, may be nullptr
+    FrameTrace *_trace = nullptr;
+
+    /// @brief destination of the last sent message, a corrupted frame is most likely its reply
+    mutable uint8_t _lastDestination = 0;
+
+    /// @brief TX timestamp of the last sent message
+    mutable int64_t _lastSentNs = 0;
+
+    typedef std::array<message_handler_t, 256> HandlerPage;
+
+    /// @brief handlers by message id, a page of 256 ids per high byte allocated on registration
+    std::array<std::unique_ptr<HandlerPage>, 256> _msgIdHandlers;
+
+    /// @brief handlers by source address
+    std::array<message_handler_t, 256> _sourceHandlers;
 public:
     Protocol(Network *network);
     ~Protocol();
 
+    /**
+     * @brief Attach the transport metrics registry of the bus
+     * 
+     * @param metrics registry to update, nullptr to disable metrics
+     */
+    void setMetrics(TransportMetrics *metrics);
+
+    /// @brief Get the attached transport metrics registry, nullptr if none
+    TransportMetrics *getMetrics() const;
+
+    /**
+     * @brief Attach the frame trace of the bus, every sent and received frame is recorded
+     * 
+     * @param trace trace to record into, nullptr to disable tracing
+     */
+    void setTrace(FrameTrace *trace);
+
     /**
      * @brief Send a message over the network
      * 
@@ -37,15 +102,83 @@ public:
     /// @overload 
     bool sendMessage(const Message &message) const;
 
+    /**
+     * @brief Get the TX timestamp of the last sent message
+     * 
+     * Taken right before the frame is handed to the network, on the same steady clock as
+     * the RX timestamps of the received messages.
+     * 
+     * @return int64_t steady clock time in nanoseconds, see steadyNowNs()
+     */
+    int64_t lastSentNs() const;
+
     /**
      * @brief Read a message from the network interface
      * 
      * @param message message to read into
      * @param timeoutUs timeout in microseconds
      * @return true if a message was read successfully
-     * @return false if a message was not read successfully
+     * @return false if no message was read or the received frame was corrupted
      */
     bool readMessage(Message &message, const uint64_t timeoutUs);
+
+    /**
+     * @brief Read a message from the network interface, telling a missing frame from a corrupted one
+     * 
+     * @param message message to read into
+     * @param timeoutUs timeout in microseconds
+     * @return ReadStatus result of the read
+     */
+    ReadStatus receive(Message &message, const uint64_t timeoutUs);
+
+    /**
+     * @brief Register the handler of a message id
+     * 
+     * Handlers are called by dispatch() on the receive thread, register them before
+     * the receiving starts.
+     * 
+     * @param msgId message id to handle
+     * @param handler handler to call, empty to remove the handler
+     */
+    void onMessage(const msgid_t msgId, message_handler_t handler);
+
+    /**
+     * @brief Hand the messages of a message id over to a bounded queue
+     * 
+     * @overload
+     * @param msgId message id to handle
+     * @param queue queue to push the messages into, must outlive the registration
+     */
+    void onMessage(const msgid_t msgId, MessageQueue &queue);
+
+    /**
+     * @brief Register the handler of all messages from a source address
+     * 
+     * @param srcAddr source address to handle
+     * @param handler handler to call, empty to remove the handler
+     */
+    void onSource(const uint8_t srcAddr, message_handler_t handler);
+
+    /// @overload
+    void onSource(const uint8_t srcAddr, MessageQueue &queue);
+
+    /**
+     * @brief Call the handlers of a message, the message id handler first
+     * 
+     * @param message received message
+     * @return true if at least one handler was called
+     */
+    bool dispatch(const Message &message) const;
+
+    /**
+     * @brief Receive and dispatch messages until nothing arrives within the timeout
+     * 
+     * Serves a receive thread of a bus with no master waiting for replies.
+     * 
+     * @param timeoutUs timeout of waiting for one message in microseconds
+     * @return size_t number of received messages
+     */
+    size_t poll(const uint64_t timeoutUs);
 };
 
 
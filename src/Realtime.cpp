@@ -0,0 +1,176 @@
+#include "Realtime.hpp"
+#include "Clock.hpp"
+#include <algorithm>
+#include <alloca.h>
+#include <cstdlib>
+#include <cstring>
+#include <malloc.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+namespace Xerxes
+{
+
+
+/// @brief let the sibling hyper-thread run while spinning
+static inline void cpuRelax()
+{
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#elif defined(__aarch64__)
+    asm volatile("yield");
+#endif
+}
+
+
+void prefault(void *buffer, const size_t size)
+{
+    const size_t page = sysconf(_SC_PAGESIZE);
+    volatile uint8_t *bytes = (volatile uint8_t *)buffer;
+    for(size_t offset = 0; offset < size; offset += page)
+    {
+        bytes[offset] = bytes[offset];
+    }
+    // an unaligned buffer ends on one more page
+    if(size > 0)
+    {
+        bytes[size - 1] = bytes[size - 1];
+    }
+}
+
+
+static void prefaultStack(const size_t size)
+{
+    // the barrier keeps the compiler from dropping the writes to the dead buffer
+    uint8_t *stack = (uint8_t *)alloca(size);
+    memset(stack, 0, size);
+    asm volatile("" : : "r"(stack) : "memory");
+}
+
+
+RealtimeStatus enterRealtime(const RealtimeOptions &options)
+{
+    RealtimeStatus status;
+
+    if(options.cpu >= 0)
+    {
+        cpu_set_t cpus;
+        CPU_ZERO(&cpus);
+        CPU_SET(options.cpu, &cpus);
+        status.affinity = pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus) == 0;
+    }
+
+    if(options.priority > 0)
+    {
+        sched_param param {};
+        param.sched_priority = options.priority;
+        status.scheduler = pthread_setschedparam(pthread_self(), SCHED_FIFO, &param) == 0;
+    }
+
+    if(options.lockMemory)
+    {
+        status.memoryLocked = mlockall(MCL_CURRENT | MCL_FUTURE) == 0;
+        // freed memory stays with the process, so new packets do not fault
+        mallopt(M_TRIM_THRESHOLD, -1);
+        mallopt(M_MMAP_MAX, 0);
+    }
+
+    if(options.prefaultStack > 0)
+    {
+        prefaultStack(options.prefaultStack);
+    }
+    if(options.prefaultHeap > 0)
+    {
+        void *heap = malloc(options.prefaultHeap);
+        if(heap != nullptr)
+        {
+            memset(heap, 0, options.prefaultHeap);
+            free(heap);
+        }
+    }
+
+    return status;
+}
+
+
+BusyPollNetwork::BusyPollNetwork(Network &inner, const uint32_t spinUs) :
+    _inner(inner), _spinUs(spinUs)
+{
+}
+
+
+BusyPollNetwork::~BusyPollNetwork()
+{
+}
+
+
+bool BusyPollNetwork::sendData(const Packet &toSend) const
+{
+    return _inner.sendData(toSend);
+}
+
+
+bool BusyPollNetwork::readData(const uint64_t timeoutUs, Packet &packet)
+{
+    const int64_t start = steadyNowNs();
+    const int64_t spinNs = (int64_t)std::min<uint64_t>(_spinUs, timeoutUs) * 1000;
+    do
+    {
+        if(_inner.readData(0, packet))
+        {
+            _spinHits++;
+            return true;
+        }
+        cpuRelax();
+    } while(steadyNowNs() - start < spinNs);
+
+    const int64_t spentUs = (steadyNowNs() - start) / 1000;
+    if((uint64_t)spentUs >= timeoutUs)
+    {
+        return false;
+    }
+    _blockingReads++;
+    return _inner.readData(timeoutUs - spentUs, packet);
+}
+
+
+size_t BusyPollNetwork::readRaw(const uint64_t timeoutUs, uint8_t *buffer, const size_t size)
+{
+    const int64_t start = steadyNowNs();
+    const int64_t spinNs = (int64_t)std::min<uint64_t>(_spinUs, timeoutUs) * 1000;
+    do
+    {
+        const size_t length = _inner.readRaw(0, buffer, size);
+        if(length > 0)
+        {
+            _spinHits++;
+            return length;
+        }
+        cpuRelax();
+    } while(steadyNowNs() - start < spinNs);
+
+    const int64_t spentUs = (steadyNowNs() - start) / 1000;
+    if((uint64_t)spentUs >= timeoutUs)
+    {
+        return 0;
+    }
+    _blockingReads++;
+    return _inner.readRaw(timeoutUs - spentUs, buffer, size);
+}
+
+
+uint64_t BusyPollNetwork::spinHits() const
+{
+    return _spinHits;
+}
+
+
+uint64_t BusyPollNetwork::blockingReads() const
+{
+    return _blockingReads;
+}
+
+
+} // namespace Xerxes
@@ -0,0 +1,107 @@
+#ifndef __REALTIME_HPP
+#define __REALTIME_HPP
+
+#include <cstdint>
+#include <stddef.h>
+#include "Network.hpp"
+
+namespace Xerxes
+{
+
+
+/**
+ * @brief Settings of the real-time mode of the thread which talks to the bus
+ *
+ */
+struct RealtimeOptions
+{
+    /// @brief SCHED_FIFO priority 1..99, 0 to keep the scheduler of the thread
+    int priority = 80;
+    /// @brief CPU to pin the thread to, -1 to keep its affinity
+    int cpu = -1;
+    /// @brief lock all current and future pages of the process into RAM
+    bool lockMemory = true;
+    /// @brief bytes of stack touched up front, so the thread does not fault on it later
+    size_t prefaultStack = 256 * 1024;
+    /// @brief bytes of heap touched up front for the buffers of the packets
+    size_t prefaultHeap = 1024 * 1024;
+};
+
+
+/**
+ * @brief Settings which took effect, the others usually need CAP_SYS_NICE or CAP_IPC_LOCK
+ *
+ */
+struct RealtimeStatus
+{
+    bool scheduler = false;
+    bool affinity = false;
+    bool memoryLocked = false;
+};
+
+
+/**
+ * @brief Switch the calling thread to the real-time mode
+ *
+ * Sets SCHED_FIFO and the CPU affinity of the thread, locks the memory of the process,
+ * keeps the allocator from returning memory to the kernel and pre-faults the stack and
+ * the heap, so the receive path neither waits for the scheduler nor for page faults.
+ * Settings which can not be applied are skipped, check the returned status.
+ *
+ * @param options settings to apply
+ * @return RealtimeStatus settings which took effect
+ */
+RealtimeStatus enterRealtime(const RealtimeOptions &options = {});
+
+
+/**
+ * @brief Touch every page of a buffer so later accesses do not fault
+ *
+ * @param buffer buffer to pre-fault, its content is kept
+ * @param size size of the buffer
+ */
+void prefault(void *buffer, const size_t size);
+
+
+/**
+ * @brief Network which spins on a non-blocking read before it blocks
+ *
+ * A reader blocked in readData() is woken by the kernel when the reply arrives, which
+ * on a loaded machine adds tens to hundreds of microseconds of jitter. This network
+ * polls the inner network with a zero timeout for up to spinUs first, trading a busy
+ * CPU for a reply detected as soon as it arrives. Pair it with enterRealtime() on a
+ * dedicated CPU.
+ */
+class BusyPollNetwork : public Network
+{
+private:
+    Network &_inner;
+    uint32_t _spinUs;
+    uint64_t _spinHits = 0;
+    uint64_t _blockingReads = 0;
+
+public:
+    /**
+     * @brief Wrap a network
+     *
+     * @param inner network to read from, it must return at once when the timeout is 0
+     * @param spinUs time to spin before falling back to a blocking read, in microseconds
+     */
+    BusyPollNetwork(Network &inner, const uint32_t spinUs);
+    ~BusyPollNetwork();
+
+    bool sendData(const Packet &toSend) const override;
+    bool readData(const uint64_t timeoutUs, Packet &packet) override;
+    size_t readRaw(const uint64_t timeoutUs, uint8_t *buffer, const size_t size) override;
+
+    /// @brief Reads which got their data while spinning
+    uint64_t spinHits() const;
+
+    /// @brief Reads which spun in vain and fell back to a blocking read
+    uint64_t blockingReads() const;
+};
+
+
+} // namespace Xerxes
+
+#endif // !__REALTIME_HPP
@@ -0,0 +1,295 @@
+#ifndef __REGISTERS_HPP
+#define __REGISTERS_HPP
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <stddef.h>
+#include "MemoryMap.h"
+
+namespace Xerxes
+{
+
+
+/**
+ * @brief Data type of a register
+ *
+ */
+enum RegisterType : uint8_t
+{
+    REG_FLOAT = 0,
+    REG_UINT8,
+    REG_UINT32,
+    REG_INT32,
+    REG_UINT64
+};
+
+
+/**
+ * @brief Memory region of a register, decides how long a write takes
+ *
+ */
+enum RegisterRegion : uint8_t
+{
+    /// @brief stored in flash, survives reset
+    REGION_NON_VOLATILE = 0,
+    /// @brief RAM, updated by the device
+    REGION_VOLATILE,
+    /// @brief RAM, written by the device only
+    REGION_READ_ONLY
+};
+
+
+/**
+ * @brief Access of the master to a register
+ *
+ */
+enum RegisterAccess : uint8_t
+{
+    ACCESS_READ = 0,
+    ACCESS_READ_WRITE
+};
+
+
+/// @brief Largest memory block read with a single READ, the frame limit minus the header and checksum
+constexpr uint8_t MAX_READ_SIZE = 248;
+
+/// @brief Largest memory block written with a single WRITE, the offset takes 2 bytes of the payload
+constexpr uint8_t MAX_WRITE_SIZE = MAX_READ_SIZE - 2;
+
+/// @brief Most ranges in a single READ_MULTI, each takes 3 bytes of the request
+constexpr uint8_t READ_MULTI_MAX_RANGES = MAX_READ_SIZE / 3;
+
+/// @brief Timeout of a write to the flash of a device in microseconds
+constexpr uint32_t FLASH_WRITE_TIMEOUT_US = 100000;
+
+/// @brief Timeout of a write to the RAM of a device in microseconds
+constexpr uint32_t RAM_WRITE_TIMEOUT_US = 10000;
+
+
+template<class T> constexpr RegisterType registerTypeOf();
+template<> constexpr RegisterType registerTypeOf<float>() { return REG_FLOAT; }
+template<> constexpr RegisterType registerTypeOf<uint8_t>() { return REG_UINT8; }
+template<> constexpr RegisterType registerTypeOf<uint32_t>() { return REG_UINT32; }
+template<> constexpr RegisterType registerTypeOf<int32_t>() { return REG_INT32; }
+template<> constexpr RegisterType registerTypeOf<uint64_t>() { return REG_UINT64; }
+
+
+/**
+ * @brief Untyped description of a register, used by tools which list the memory map
+ *
+ */
+struct RegisterDescriptor
+{
+    const char *name;
+    uint16_t offset;
+    uint8_t size;
+    RegisterType type;
+    RegisterRegion region;
+    RegisterAccess access;
+};
+
+
+/**
+ * @brief Register of a device with its C++ type
+ *
+ * Pass the constants in Registers as template arguments to the Leaf accessors, the
+ * value type, the access check and the write timeout are then resolved at compile time.
+ *
+ * @tparam T type of the register value
+ */
+template<class T>
+struct Register
+{
+    using type = T;
+
+    const char *name;
+    uint16_t offset;
+    RegisterRegion region;
+    RegisterAccess access;
+
+    static constexpr uint8_t size = sizeof(T);
+
+    /// @brief Offset one past the end of the register
+    constexpr uint16_t end() const
+    {
+        return offset + size;
+    }
+
+    constexpr RegisterDescriptor descriptor() const
+    {
+        return RegisterDescriptor{name, offset, size, registerTypeOf<T>(), region, access};
+    }
+};
+
+
+/**
+ * @brief Region of the memory at the offset
+ *
+ * @param offset offset in the device memory
+ * @return RegisterRegion region holding the offset
+ */
+constexpr RegisterRegion regionOf(const uint16_t offset)
+{
+    if(offset < VOLATILE_OFFSET)
+    {
+        return REGION_NON_VOLATILE;
+    }
+    else if(offset < READ_ONLY_OFFSET)
+    {
+        return REGION_VOLATILE;
+    }
+    return REGION_READ_ONLY;
+}
+
+
+/**
+ * @brief Timeout of a write to the region
+ *
+ * @param region region written to
+ * @return uint32_t timeout in microseconds, flash writes take much longer
+ */
+constexpr uint32_t writeTimeoutUs(const RegisterRegion region)
+{
+    return region == REGION_NON_VOLATILE ? FLASH_WRITE_TIMEOUT_US : RAM_WRITE_TIMEOUT_US;
+}
+
+
+/**
+ * @brief Registers of the memory map of a device, see MemoryMap.h
+ *
+ */
+namespace Registers
+{
+
+#define XERXES_REGISTER(type, name, offset, region, access) \
+    inline constexpr Register<type> name{#name, offset, region, access}
+
+// non volatile range
+XERXES_REGISTER(float, GAIN_PV0, GAIN_PV0_OFFSET, REGION_NON_VOLATILE, ACCESS_READ_WRITE);
+XERXES_REGISTER(float, GAIN_PV1, GAIN_PV1_OFFSET, REGION_NON_VOLATILE, ACCESS_READ_WRITE);
+XERXES_REGISTER(float, GAIN_PV2, GAIN_PV2_OFFSET, REGION_NON_VOLATILE, ACCESS_READ_WRITE);
+XERXES_REGISTER(float, GAIN_PV3, GAIN_PV3_OFFSET, REGION_NON_VOLATILE, ACCESS_READ_WRITE);
+XERXES_REGISTER(float, OFFSET_PV0, OFFSET_PV0_OFFSET, REGION_NON_VOLATILE, ACCESS_READ_WRITE);
+XERXES_REGISTER(float, OFFSET_PV1, OFFSET_PV1_OFFSET, REGION_NON_VOLATILE, ACCESS_READ_WRITE);
+XERXES_REGISTER(float, OFFSET_PV2, OFFSET_PV2_OFFSET, REGION_NON_VOLATILE, ACCESS_READ_WRITE);
+XERXES_REGISTER(float, OFFSET_PV3, OFFSET_PV3_OFFSET, REGION_NON_VOLATILE, ACCESS_READ_WRITE);
+XERXES_REGISTER(uint32_t, DESIRED_CYCLE_TIME, OFFSET_DESIRED_CYCLE_TIME, REGION_NON_VOLATILE, ACCESS_READ_WRITE);
+XERXES_REGISTER(uint8_t, CONFIG_BITS, OFFSET_CONFIG_BITS, REGION_NON_VOLATILE, ACCESS_READ_WRITE);
+XERXES_REGISTER(uint8_t, ADDRESS, OFFSET_ADDRESS, REGION_NON_VOLATILE, ACCESS_READ_WRITE);
+XERXES_REGISTER(uint32_t, CONFIG_VAL0, CONFIG_VAL0_OFFSET, REGION_NON_VOLATILE, ACCESS_READ_WRITE);
+XERXES_REGISTER(uint32_t, CONFIG_VAL1, CONFIG_VAL1_OFFSET, REGION_NON_VOLATILE, ACCESS_READ_WRITE);
+XERXES_REGISTER(uint32_t, CONFIG_VAL2, CONFIG_VAL2_OFFSET, REGION_NON_VOLATILE, ACCESS_READ_WRITE);
+XERXES_REGISTER(uint32_t, CONFIG_VAL3, CONFIG_VAL3_OFFSET, REGION_NON_VOLATILE, ACCESS_READ_WRITE);
+
+// volatile range, the measured values and statistics are written by the device
+XERXES_REGISTER(float, PV0, PV0_OFFSET, REGION_VOLATILE, ACCESS_READ);
+XERXES_REGISTER(float, PV1, PV1_OFFSET, REGION_VOLATILE, ACCESS_READ);
+XERXES_REGISTER(float, PV2, PV2_OFFSET, REGION_VOLATILE, ACCESS_READ);
+XERXES_REGISTER(float, PV3, PV3_OFFSET, REGION_VOLATILE, ACCESS_READ);
+XERXES_REGISTER(float, MEAN_PV0, MEAN_PV0_OFFSET, REGION_VOLATILE, ACCESS_READ);
+XERXES_REGISTER(float, MEAN_PV1, MEAN_PV1_OFFSET, REGION_VOLATILE, ACCESS_READ);
+XERXES_REGISTER(float, MEAN_PV2, MEAN_PV2_OFFSET, REGION_VOLATILE, ACCESS_READ);
+XERXES_REGISTER(float, MEAN_PV3, MEAN_PV3_OFFSET, REGION_VOLATILE, ACCESS_READ);
+XERXES_REGISTER(float, STDDEV_PV0, STDDEV_PV0_OFFSET, REGION_VOLATILE, ACCESS_READ);
+XERXES_REGISTER(float, STDDEV_PV1, STDDEV_PV1_OFFSET, REGION_VOLATILE, ACCESS_READ);
+XERXES_REGISTER(float, STDDEV_PV2, STDDEV_PV2_OFFSET, REGION_VOLATILE, ACCESS_READ);
+XERXES_REGISTER(float, STDDEV_PV3, STDDEV_PV3_OFFSET, REGION_VOLATILE, ACCESS_READ);
+XERXES_REGISTER(float, MIN_PV0, MIN_PV0_OFFSET, REGION_VOLATILE, ACCESS_READ);
+XERXES_REGISTER(float, MIN_PV1, MIN_PV1_OFFSET, REGION_VOLATILE, ACCESS_READ);
+XERXES_REGISTER(float, MIN_PV2, MIN_PV2_OFFSET, REGION_VOLATILE, ACCESS_READ);
+XERXES_REGISTER(float, MIN_PV3, MIN_PV3_OFFSET, REGION_VOLATILE, ACCESS_READ);
+XERXES_REGISTER(float, MAX_PV0, MAX_PV0_OFFSET, REGION_VOLATILE, ACCESS_READ);
+XERXES_REGISTER(float, MAX_PV1, MAX_PV1_OFFSET, REGION_VOLATILE, ACCESS_READ);
+XERXES_REGISTER(float, MAX_PV2, MAX_PV2_OFFSET, REGION_VOLATILE, ACCESS_READ);
+XERXES_REGISTER(float, MAX_PV3, MAX_PV3_OFFSET, REGION_VOLATILE, ACCESS_READ);
+XERXES_REGISTER(uint32_t, DV0, DV0_OFFSET, REGION_VOLATILE, ACCESS_READ_WRITE);
+XERXES_REGISTER(uint32_t, DV1, DV1_OFFSET, REGION_VOLATILE, ACCESS_READ_WRITE);
+XERXES_REGISTER(uint32_t, DV2, DV2_OFFSET, REGION_VOLATILE, ACCESS_READ_WRITE);
+XERXES_REGISTER(uint32_t, DV3, DV3_OFFSET, REGION_VOLATILE, ACCESS_READ_WRITE);
+XERXES_REGISTER(float, AV0, AV0_OFFSET, REGION_VOLATILE, ACCESS_READ_WRITE);
+XERXES_REGISTER(float, AV1, AV1_OFFSET, REGION_VOLATILE, ACCESS_READ_WRITE);
+XERXES_REGISTER(float, AV2, AV2_OFFSET, REGION_VOLATILE, ACCESS_READ_WRITE);
+XERXES_REGISTER(float, AV3, AV3_OFFSET, REGION_VOLATILE, ACCESS_READ_WRITE);
+XERXES_REGISTER(int32_t, SV0, SV0_OFFSET, REGION_VOLATILE, ACCESS_READ_WRITE);
+XERXES_REGISTER(int32_t, SV1, SV1_OFFSET, REGION_VOLATILE, ACCESS_READ_WRITE);
+XERXES_REGISTER(int32_t, SV2, SV2_OFFSET, REGION_VOLATILE, ACCESS_READ_WRITE);
+XERXES_REGISTER(int32_t, SV3, SV3_OFFSET, REGION_VOLATILE, ACCESS_READ_WRITE);
+XERXES_REGISTER(uint32_t, MEM_UNLOCKED, MEM_UNLOCKED_OFFSET, REGION_VOLATILE, ACCESS_READ_WRITE);
+
+// read only range
+XERXES_REGISTER(uint64_t, STATUS, STATUS_OFFSET, REGION_READ_ONLY, ACCESS_READ);
+XERXES_REGISTER(uint64_t, ERROR, ERROR_OFFSET, REGION_READ_ONLY, ACCESS_READ);
+XERXES_REGISTER(uint64_t, UID, UID_OFFSET, REGION_READ_ONLY, ACCESS_READ);
+XERXES_REGISTER(uint32_t, NET_CYCLE_TIME, OFFSET_NET_CYCLE_TIME, REGION_READ_ONLY, ACCESS_READ);
+
+#undef XERXES_REGISTER
+
+
+/// @brief All registers ordered by offset
+inline constexpr auto all = std::to_array<RegisterDescriptor>({
+    GAIN_PV0.descriptor(), GAIN_PV1.descriptor(), GAIN_PV2.descriptor(), GAIN_PV3.descriptor(),
+    OFFSET_PV0.descriptor(), OFFSET_PV1.descriptor(), OFFSET_PV2.descriptor(), OFFSET_PV3.descriptor(),
+    DESIRED_CYCLE_TIME.descriptor(), CONFIG_BITS.descriptor(), ADDRESS.descriptor(),
+    CONFIG_VAL0.descriptor(), CONFIG_VAL1.descriptor(), CONFIG_VAL2.descriptor(), CONFIG_VAL3.descriptor(),
+    PV0.descriptor(), PV1.descriptor(), PV2.descriptor(), PV3.descriptor(),
+    MEAN_PV0.descriptor(), MEAN_PV1.descriptor(), MEAN_PV2.descriptor(), MEAN_PV3.descriptor(),
+    STDDEV_PV0.descriptor(), STDDEV_PV1.descriptor(), STDDEV_PV2.descriptor(), STDDEV_PV3.descriptor(),
+    MIN_PV0.descriptor(), MIN_PV1.descriptor(), MIN_PV2.descriptor(), MIN_PV3.descriptor(),
+    MAX_PV0.descriptor(), MAX_PV1.descriptor(), MAX_PV2.descriptor(), MAX_PV3.descriptor(),
+    DV0.descriptor(), DV1.descriptor(), DV2.descriptor(), DV3.descriptor(),
+    AV0.descriptor(), AV1.descriptor(), AV2.descriptor(), AV3.descriptor(),
+    SV0.descriptor(), SV1.descriptor(), SV2.descriptor(), SV3.descriptor(),
+    MEM_UNLOCKED.descriptor(),
+    STATUS.descriptor(), ERROR.descriptor(), UID.descriptor(), NET_CYCLE_TIME.descriptor(),
+});
+
+} // namespace Registers
+
+
+namespace detail
+{
+
+constexpr bool registerMapIsConsistent()
+{
+    for(size_t i = 0; i < Registers::all.size(); i++)
+    {
+        const RegisterDescriptor &r = Registers::all[i];
+        if(regionOf(r.offset) != r.region || regionOf(r.offset + r.size - 1) != r.region)
+        {
+            return false;
+        }
+        if(i > 0 && Registers::all[i - 1].offset + Registers::all[i - 1].size > r.offset)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+} // namespace detail
+
+static_assert(detail::registerMapIsConsistent(), "registers must be ordered, must not overlap and must lie in their region");
+
+
+/**
+ * @brief Memory span covering several registers, for reading them with one READ
+ *
+ * @tparam regs registers to read, in any order
+ */
+template<const auto &... regs>
+struct RegisterSpan
+{
+    static_assert(sizeof...(regs) > 0, "at least one register is required");
+
+    static constexpr uint16_t offset = std::min({regs.offset...});
+    static constexpr uint16_t end = std::max({regs.end()...});
+    static constexpr uint16_t size = end - offset;
+
+    static_assert(size <= MAX_READ_SIZE, "registers do not fit into a single read");
+};
+
+
+} // namespace Xerxes
+
+#endif // !__REGISTERS_HPP
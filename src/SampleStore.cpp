@@ -0,0 +1,331 @@
+#include "SampleStore.hpp"
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace Xerxes
+{
+
+
+static size_t segmentSize(const uint32_t capacity)
+{
+    return sizeof(SegmentHeader) + (size_t)capacity * (sizeof(int64_t) + sizeof(double));
+}
+
+
+/// @brief read the header of an open segment file and check it describes the file
+static bool readHeader(const int fd, const struct stat &st, SegmentHeader &header)
+{
+    if(pread(fd, &header, sizeof(header), 0) != sizeof(header))
+    {
+        return false;
+    }
+    // a truncated file or a corrupt header would map the samples past the end of the file
+    return memcmp(header.magic, SEGMENT_FILE_MAGIC, sizeof(SEGMENT_FILE_MAGIC)) == 0 &&
+        header.version == SEGMENT_FILE_VERSION &&
+        header.capacity > 0 &&
+        header.count <= header.capacity &&
+        (size_t)st.st_size >= segmentSize(header.capacity);
+}
+
+
+Segment::Segment(uint8_t *map, const size_t mapSize, const bool writable) :
+    _map(map), _mapSize(mapSize), _writable(writable)
+{
+    _header = (SegmentHeader *)_map;
+    _timestamps = (int64_t *)(_map + sizeof(SegmentHeader));
+    _values = (double *)(_map + sizeof(SegmentHeader) + (size_t)_header->capacity * sizeof(int64_t));
+}
+
+
+Segment::~Segment()
+{
+    if(_map != nullptr)
+    {
+        munmap(_map, _mapSize);
+    }
+}
+
+
+std::unique_ptr<Segment> Segment::create(const std::string &path, const SeriesKey &key, const uint32_t capacity)
+{
+    if(capacity == 0)
+    {
+        throw std::invalid_argument("Segment capacity must not be zero.");
+    }
+
+    int fd = ::open(path.c_str(), O_RDWR | O_CREAT, 0644);
+    if(fd < 0)
+    {
+        throw std::runtime_error("Can not create segment " + path);
+    }
+
+    struct stat st;
+    if(fstat(fd, &st) != 0)
+    {
+        close(fd);
+        throw std::runtime_error("Can not create segment " + path);
+    }
+    const bool exists = st.st_size >= (off_t)sizeof(SegmentHeader);
+
+    uint32_t cap = capacity;
+    if(exists)
+    {
+        // continue an existing segment with its own capacity
+        SegmentHeader header;
+        if(!readHeader(fd, st, header))
+        {
+            close(fd);
+            throw std::runtime_error("Not a segment file " + path);
+        }
+        cap = header.capacity;
+    }
+
+    const size_t size = segmentSize(cap);
+    if(!exists && ftruncate(fd, size) != 0)
+    {
+        close(fd);
+        throw std::runtime_error("Can not allocate segment " + path);
+    }
+
+    void *map = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if(map == MAP_FAILED)
+    {
+        throw std::runtime_error("Can not map segment " + path);
+    }
+
+    if(!exists)
+    {
+        SegmentHeader *header = (SegmentHeader *)map;
+        memcpy(header->magic, SEGMENT_FILE_MAGIC, sizeof(SEGMENT_FILE_MAGIC));
+        header->version = SEGMENT_FILE_VERSION;
+        header->bus = key.bus;
+        header->leaf = key.leaf;
+        header->offset = key.offset;
+        header->capacity = cap;
+        header->count = 0;
+    }
+
+    return std::unique_ptr<Segment>(new Segment((uint8_t *)map, size, true));
+}
+
+
+std::unique_ptr<Segment> Segment::open(const std::string &path)
+{
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if(fd < 0)
+    {
+        throw std::runtime_error("Can not open segment " + path);
+    }
+
+    struct stat st;
+    SegmentHeader header;
+    if(fstat(fd, &st) != 0 || !readHeader(fd, st, header))
+    {
+        close(fd);
+        throw std::runtime_error("Not a segment file " + path);
+    }
+
+    const size_t size = segmentSize(header.capacity);
+    void *map = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if(map == MAP_FAILED)
+    {
+        throw std::runtime_error("Can not map segment " + path);
+    }
+
+    return std::unique_ptr<Segment>(new Segment((uint8_t *)map, size, false));
+}
+
+
+bool Segment::append(const int64_t timestampNs, const double value)
+{
+    std::atomic_ref<uint32_t> count(_header->count);
+    const uint32_t n = count.load(std::memory_order_relaxed);
+    if(!_writable || n >= _header->capacity)
+    {
+        return false;
+    }
+
+    _timestamps[n] = timestampNs;
+    _values[n] = value;
+    // publish the sample to readers mapping the same file
+    count.store(n + 1, std::memory_order_release);
+    return true;
+}
+
+
+size_t Segment::size() const
+{
+    return std::atomic_ref<uint32_t>(_header->count).load(std::memory_order_acquire);
+}
+
+
+size_t Segment::capacity() const
+{
+    return _header->capacity;
+}
+
+
+SeriesKey Segment::key() const
+{
+    return SeriesKey{_header->bus, _header->leaf, _header->offset};
+}
+
+
+const int64_t *Segment::timestamps() const
+{
+    return _timestamps;
+}
+
+
+const double *Segment::values() const
+{
+    return _values;
+}
+
+
+std::pair<size_t, size_t> Segment::range(const int64_t fromNs, const int64_t toNs) const
+{
+    const int64_t *begin = _timestamps;
+    const int64_t *end = _timestamps + size();
+
+    const int64_t *first = std::lower_bound(begin, end, fromNs);
+    const int64_t *last = std::upper_bound(first, end, toNs);
+    return {(size_t)(first - begin), (size_t)(last - begin)};
+}
+
+
+void Segment::sync() const
+{
+    msync(_map, _mapSize, MS_ASYNC);
+}
+
+
+SeriesWriter::SeriesWriter(const std::string &dir, const SeriesKey &key, const uint32_t capacity) :
+    _dir(dir), _key(key), _capacity(capacity)
+{
+    if(_capacity == 0)
+    {
+        throw std::invalid_argument("Segment capacity must not be zero.");
+    }
+
+    // continue after the last existing segment of the series
+    std::vector<std::string> existing = SampleStore::segments(dir, key);
+    if(!existing.empty())
+    {
+        _index = existing.size() - 1;
+    }
+
+    _segment = Segment::create(SampleStore::segmentPath(_dir, _key, _index), _key, _capacity);
+    if(_segment->size() > 0)
+    {
+        _last = _segment->timestamps()[_segment->size() - 1];
+    }
+}
+
+
+SeriesWriter::~SeriesWriter()
+{
+}
+
+
+void SeriesWriter::append(const int64_t timestampNs, const double value)
+{
+    if(timestampNs < _last)
+    {
+        throw std::invalid_argument("Sample timestamp goes back in time.");
+    }
+
+    if(!_segment->append(timestampNs, value))
+    {
+        _segment->sync();
+        _index++;
+        _segment = Segment::create(SampleStore::segmentPath(_dir, _key, _index), _key, _capacity);
+        _segment->append(timestampNs, value);
+    }
+    _last = timestampNs;
+}
+
+
+void SeriesWriter::sync() const
+{
+    _segment->sync();
+}
+
+
+SampleStore::SampleStore(const std::string &dir, const uint32_t segmentCapacity) :
+    _dir(dir), _capacity(segmentCapacity)
+{
+    if(_capacity == 0)
+    {
+        throw std::invalid_argument("Segment capacity must not be zero.");
+    }
+}
+
+
+SampleStore::~SampleStore()
+{
+    sync();
+}
+
+
+SeriesWriter &SampleStore::series(const SeriesKey &key)
+{
+    auto it = _series.find(key.id());
+    if(it == _series.end())
+    {
+        it = _series.emplace(key.id(), std::make_unique<SeriesWriter>(_dir, key, _capacity)).first;
+    }
+    return *it->second;
+}
+
+
+void SampleStore::append(const SeriesKey &key, const int64_t timestampNs, const double value)
+{
+    series(key).append(timestampNs, value);
+}
+
+
+void SampleStore::sync() const
+{
+    for(const auto &[id, writer] : _series)
+    {
+        writer->sync();
+    }
+}
+
+
+std::string SampleStore::segmentPath(const std::string &dir, const SeriesKey &key, const uint32_t index)
+{
+    char name[64];
+    snprintf(name, sizeof(name), "/b%03u-l%03u-o%04u-%06u.xseg", key.bus, key.leaf, key.offset, index);
+    return dir + name;
+}
+
+
+std::vector<std::string> SampleStore::segments(const std::string &dir, const SeriesKey &key)
+{
+    std::vector<std::string> paths;
+    struct stat st;
+    for(uint32_t index = 0;; index++)
+    {
+        std::string path = segmentPath(dir, key, index);
+        if(stat(path.c_str(), &st) != 0)
+        {
+            break;
+        }
+        paths.push_back(path);
+    }
+    return paths;
+}
+
+
+} // namespace Xerxes
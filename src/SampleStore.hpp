@@ -0,0 +1,246 @@
+#ifndef __SAMPLE_STORE_HPP
+#define __SAMPLE_STORE_HPP
+
+#include <cstdint>
+#include <stddef.h>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace Xerxes
+{
+
+
+/// @brief Magic bytes at the beginning of a segment file
+constexpr char SEGMENT_FILE_MAGIC[4] = {'X', 'S', 'E', 'G'};
+
+/// @brief Version of the segment file format
+constexpr uint8_t SEGMENT_FILE_VERSION = 1;
+
+
+/**
+ * @brief Identification of a series of samples: bus, leaf address and register offset (MemoryMap.h)
+ *
+ */
+struct SeriesKey
+{
+    uint8_t bus;
+    uint8_t leaf;
+    uint16_t offset;
+
+    /// @brief Key packed into one integer
+    constexpr uint32_t id() const
+    {
+        return (uint32_t)bus << 24 | (uint32_t)leaf << 16 | offset;
+    }
+};
+
+
+/**
+ * @brief Header of a segment file
+ *
+ */
+struct SegmentHeader
+{
+    char magic[4];
+    uint8_t version;
+    uint8_t bus;
+    uint8_t leaf;
+    uint8_t reserved;
+    uint16_t offset;
+    uint16_t reserved2;
+    /// @brief maximal number of samples in the segment
+    uint32_t capacity;
+    /// @brief number of samples written, updated with release semantics after each sample
+    uint32_t count;
+    uint8_t padding[44];
+};
+
+static_assert(sizeof(SegmentHeader) == 64, "segment header must be 64 bytes");
+
+
+/**
+ * @brief One memory-mapped segment file of a series
+ *
+ * The file holds two fixed-width columns after the header:
+ * HEADER (64B) | TIMESTAMP_NS int64[capacity] | VALUE double[capacity]
+ *
+ * Samples are appended in timestamp order, so time ranges are found by binary search.
+ * Readers map the file read-only and use the columns in place.
+ */
+class Segment
+{
+private:
+    uint8_t *_map = nullptr;
+    size_t _mapSize = 0;
+    bool _writable = false;
+
+    SegmentHeader *_header = nullptr;
+    int64_t *_timestamps = nullptr;
+    double *_values = nullptr;
+
+    Segment(uint8_t *map, const size_t mapSize, const bool writable);
+
+public:
+    Segment(const Segment &) = delete;
+    Segment &operator=(const Segment &) = delete;
+    ~Segment();
+
+    /**
+     * @brief Create a new segment file, an existing file is opened for appending instead
+     *
+     * @param path segment file
+     * @param key series the segment belongs to
+     * @param capacity maximal number of samples
+     * @return std::unique_ptr<Segment> writable segment
+     * @throw std::invalid_argument if the capacity is zero
+     * @throw std::runtime_error if the file can not be created or mapped, or an existing
+     * file is not a segment, has another version or is shorter than its header says
+     */
+    static std::unique_ptr<Segment> create(const std::string &path, const SeriesKey &key, const uint32_t capacity);
+
+    /**
+     * @brief Map an existing segment file read-only
+     *
+     * @param path segment file
+     * @return std::unique_ptr<Segment> read-only segment
+     * @throw std::runtime_error if the file can not be mapped, is not a segment, has another
+     * version or is shorter than its header says
+     */
+    static std::unique_ptr<Segment> open(const std::string &path);
+
+    /**
+     * @brief Append a sample, only for segments returned by create()
+     *
+     * @param timestampNs timestamp, not lower than the last one
+     * @param value sample value
+     * @return true if the sample was stored
+     * @return false if the segment is full
+     */
+    bool append(const int64_t timestampNs, const double value);
+
+    /// @brief Number of samples visible in the segment
+    size_t size() const;
+
+    /// @brief Maximal number of samples of the segment
+    size_t capacity() const;
+
+    SeriesKey key() const;
+
+    /// @brief Timestamp column, size() values
+    const int64_t *timestamps() const;
+
+    /// @brief Value column, size() values
+    const double *values() const;
+
+    /**
+     * @brief Find samples in a time range by binary search
+     *
+     * @param fromNs first timestamp included
+     * @param toNs last timestamp included
+     * @return std::pair<size_t, size_t> index of the first sample and one past the last sample
+     */
+    std::pair<size_t, size_t> range(const int64_t fromNs, const int64_t toNs) const;
+
+    /// @brief Write the mapped data to the disk
+    void sync() const;
+};
+
+
+/**
+ * @brief Append-only writer of one series, rolls over to a new segment when full
+ *
+ */
+class SeriesWriter
+{
+private:
+    std::string _dir;
+    SeriesKey _key;
+    uint32_t _capacity;
+    uint32_t _index = 0;
+    int64_t _last = INT64_MIN;
+    std::unique_ptr<Segment> _segment;
+
+public:
+    /**
+     * @brief Open the series, appending continues in its last segment
+     *
+     * @param dir existing directory of the segment files
+     * @param key series to write
+     * @param capacity number of samples per new segment file
+     * @throw std::invalid_argument if the capacity is zero
+     * @throw std::runtime_error if the last segment can not be created or opened
+     */
+    SeriesWriter(const std::string &dir, const SeriesKey &key, const uint32_t capacity);
+    ~SeriesWriter();
+
+    /**
+     * @brief Append a sample, allocates only when a new segment is started
+     *
+     * @param timestampNs timestamp, must not be lower than the previous one
+     * @param value sample value
+     * @throw std::invalid_argument if the timestamp goes back in time
+     */
+    void append(const int64_t timestampNs, const double value);
+
+    /// @brief Write the current segment to the disk
+    void sync() const;
+};
+
+
+/**
+ * @brief Column-oriented store of polled values, one directory of segment files
+ *
+ * Segments are named b<bus>-l<leaf>-o<offset>-<index>.xseg, indices start at 0.
+ */
+class SampleStore
+{
+private:
+    std::string _dir;
+    uint32_t _capacity;
+    std::unordered_map<uint32_t, std::unique_ptr<SeriesWriter>> _series;
+
+public:
+    /**
+     * @brief Construct a new Sample Store object
+     *
+     * @param dir existing directory of the segment files
+     * @param segmentCapacity number of samples per segment file
+     * @throw std::invalid_argument if the capacity is zero
+     */
+    SampleStore(const std::string &dir, const uint32_t segmentCapacity = 1 << 20);
+    ~SampleStore();
+
+    /**
+     * @brief Get the writer of a series, keep the reference to skip the lookup in the poll loop
+     *
+     * @param key series
+     * @return SeriesWriter& writer of the series, created on the first use
+     */
+    SeriesWriter &series(const SeriesKey &key);
+
+    /// @brief Append a sample to a series
+    void append(const SeriesKey &key, const int64_t timestampNs, const double value);
+
+    /// @brief Write all open segments to the disk
+    void sync() const;
+
+    /// @brief Path of the segment file of a series
+    static std::string segmentPath(const std::string &dir, const SeriesKey &key, const uint32_t index);
+
+    /**
+     * @brief List the segment files of a series in time order
+     *
+     * @param dir directory of the store
+     * @param key series
+     * @return std::vector<std::string> paths of the existing segments
+     */
+    static std::vector<std::string> segments(const std::string &dir, const SeriesKey &key);
+};
+
+
+} // namespace Xerxes
+
+#endif // !__SAMPLE_STORE_HPP
@@ -0,0 +1,155 @@
+#include "SimulatedBus.hpp"
+#include <algorithm>
+#include <stdexcept>
+#include <thread>
+
+namespace Xerxes
+{
+
+
+SimulatedBus::SimulatedBus(const size_t queueDepth) : _queue(queueDepth)
+{
+    _attached.reserve(_leaves.size());
+}
+
+
+SimulatedBus::~SimulatedBus()
+{
+}
+
+
+void SimulatedBus::attach(LeafEngine &leaf)
+{
+    std::lock_guard<std::mutex> guard(_lock);
+    if(leaf.address() == BROADCAST_ADDR || _leaves[leaf.address()] != nullptr)
+    {
+        throw std::invalid_argument("Address of the leaf is not available.");
+    }
+    _leaves[leaf.address()] = &leaf;
+    _attached.push_back(&leaf);
+}
+
+
+void SimulatedBus::detach(const uint8_t address)
+{
+    std::lock_guard<std::mutex> guard(_lock);
+    LeafEngine *leaf = _leaves[address];
+    if(leaf != nullptr)
+    {
+        _leaves[address] = nullptr;
+        _attached.erase(std::find(_attached.begin(), _attached.end(), leaf));
+    }
+}
+
+
+LeafEngine *SimulatedBus::leaf(const uint8_t address) const
+{
+    std::lock_guard<std::mutex> guard(_lock);
+    return _leaves[address];
+}
+
+
+void SimulatedBus::setTurnaroundUs(const uint32_t turnaroundUs)
+{
+    std::lock_guard<std::mutex> guard(_lock);
+    _turnaroundUs = turnaroundUs;
+}
+
+
+uint64_t SimulatedBus::dropped() const
+{
+    std::lock_guard<std::mutex> guard(_lock);
+    return _dropped;
+}
+
+
+void SimulatedBus::serve(LeafEngine &leaf, const uint8_t *frame, const size_t length) const
+{
+    if(_count == _queue.size())
+    {
+        // the reply still has to be served, it changes the leaf state
+        uint8_t discard[MAX_FRAME_SIZE];
+        _dropped += leaf.handle(frame, length, discard) > 0;
+        return;
+    }
+
+    QueuedFrame &slot = _queue[(_head + _count) % _queue.size()];
+    const size_t replyLength = leaf.handle(frame, length, slot.data);
+    if(replyLength > 0)
+    {
+        slot.length = replyLength;
+        slot.readyAt = std::chrono::steady_clock::now() + std::chrono::microseconds(_turnaroundUs);
+        _count++;
+    }
+}
+
+
+bool SimulatedBus::sendData(const Packet &toSend) const
+{
+    if(toSend.size() < 4)
+    {
+        return false;
+    }
+
+    std::unique_lock<std::mutex> guard(_lock);
+    const uint8_t destination = toSend.at(3);
+    if(destination == BROADCAST_ADDR)
+    {
+        for(LeafEngine *leaf : _attached)
+        {
+            serve(*leaf, toSend.data(), toSend.size());
+        }
+    }
+    else if(_leaves[destination] != nullptr)
+    {
+        serve(*_leaves[destination], toSend.data(), toSend.size());
+    }
+    guard.unlock();
+
+    _ready.notify_all();
+    return true;
+}
+
+
+bool SimulatedBus::readData(const uint64_t timeoutUs, Packet &packet)
+{
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::microseconds(timeoutUs);
+
+    std::unique_lock<std::mutex> guard(_lock);
+    if(!_ready.wait_until(guard, deadline, [this]{ return _count > 0; }))
+    {
+        return false;
+    }
+
+    // the reply is not on the wire before the turnaround time of the device
+    const QueuedFrame &slot = _queue[_head];
+    if(slot.readyAt > deadline)
+    {
+        guard.unlock();
+        std::this_thread::sleep_until(deadline);
+        return false;
+    }
+    if(slot.readyAt > std::chrono::steady_clock::now())
+    {
+        const auto readyAt = slot.readyAt;
+        guard.unlock();
+        std::this_thread::sleep_until(readyAt);
+        guard.lock();
+        if(_count == 0)
+        {
+            // taken by another reader meanwhile
+            return false;
+        }
+    }
+
+    const QueuedFrame &ready = _queue[_head];
+    packet.setData(std::vector<uint8_t>(ready.data, ready.data + ready.length));
+    // like a kernel timestamp, the time the reply arrived rather than when it was read
+    packet.setTimestamp(std::chrono::duration_cast<std::chrono::nanoseconds>(ready.readyAt.time_since_epoch()).count());
+    _head = (_head + 1) % _queue.size();
+    _count--;
+    return true;
+}
+
+
+} // namespace Xerxes
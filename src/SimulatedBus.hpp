@@ -0,0 +1,84 @@
+#ifndef __SIMULATED_BUS_HPP
+#define __SIMULATED_BUS_HPP
+
+#include <array>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <stddef.h>
+#include <vector>
+#include "Network.hpp"
+#include "LeafEngine.hpp"
+
+namespace Xerxes
+{
+
+
+/**
+ * @brief Network hosting leaf engines in the same process
+ *
+ * Every frame sent by the master is served by the addressed leaf engine (all of them for
+ * a broadcast) and the replies are queued for readData(). Used to test and benchmark the
+ * master side without hardware. The reply queue is a fixed ring of frames, the bus does
+ * not allocate once constructed except for the Packet handed to the reader.
+ */
+class SimulatedBus : public Network
+{
+private:
+    struct QueuedFrame
+    {
+        std::chrono::steady_clock::time_point readyAt;
+        uint8_t length;
+        uint8_t data[MAX_FRAME_SIZE];
+    };
+
+    std::array<LeafEngine *, 256> _leaves {};
+    std::vector<LeafEngine *> _attached;
+    uint32_t _turnaroundUs = 0;
+
+    mutable std::mutex _lock;
+    mutable std::condition_variable _ready;
+    mutable std::vector<QueuedFrame> _queue;
+    mutable size_t _head = 0;
+    mutable size_t _count = 0;
+    mutable uint64_t _dropped = 0;
+
+    void serve(LeafEngine &leaf, const uint8_t *frame, const size_t length) const;
+
+public:
+    /**
+     * @brief Construct a new Simulated Bus object
+     *
+     * @param queueDepth number of replies which may wait for readData(), more are dropped
+     */
+    SimulatedBus(const size_t queueDepth = 256);
+    ~SimulatedBus();
+
+    /**
+     * @brief Attach a leaf engine at its address, it must outlive the bus or be detached
+     *
+     * @throw std::invalid_argument if the address is taken or is the broadcast address
+     */
+    void attach(LeafEngine &leaf);
+
+    /// @brief Detach the leaf engine at the address
+    void detach(const uint8_t address);
+
+    /// @brief Leaf engine at the address, nullptr if none
+    LeafEngine *leaf(const uint8_t address) const;
+
+    /// @brief Delay of every reply in microseconds, models the reaction time of a device
+    void setTurnaroundUs(const uint32_t turnaroundUs);
+
+    /// @brief Number of replies dropped because the queue was full
+    uint64_t dropped() const;
+
+    bool sendData(const Packet &toSend) const override;
+    bool readData(const uint64_t timeoutUs, Packet &packet) override;
+};
+
+
+} // namespace Xerxes
+
+#endif // !__SIMULATED_BUS_HPP
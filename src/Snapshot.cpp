@@ -0,0 +1,108 @@
+#include "Snapshot.hpp"
+#include "MemoryMap.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <thread>
+
+namespace Xerxes
+{
+
+
+/// @brief size of the volatile range PV0..SV3 read in one transaction
+constexpr uint8_t VOLATILE_BLOCK_SIZE = SV3_OFFSET + 4 - PV0_OFFSET;
+
+static_assert(VOLATILE_BLOCK_SIZE == 128, "volatile range must be PV0..SV3");
+
+
+size_t BusSnapshot::leaves() const
+{
+    return missed.size();
+}
+
+
+static void allocate(BusSnapshot &snapshot, const size_t leaves)
+{
+    snapshot.pv.assign(leaves * SNAPSHOT_VALUES, NAN);
+    snapshot.dv.assign(leaves * SNAPSHOT_VALUES, 0);
+    snapshot.av.assign(leaves * SNAPSHOT_VALUES, NAN);
+    snapshot.sv.assign(leaves * SNAPSHOT_VALUES, 0);
+    snapshot.missed.assign(leaves, 1);
+    snapshot.missedCount = leaves;
+}
+
+
+SnapshotReader::SnapshotReader(Master &master, const std::vector<address_t> &leaves, const uint32_t settleUs) :
+    _master(master), _leaves(leaves), _settleUs(settleUs)
+{
+    allocate(_buffers[0], leaves.size());
+    allocate(_buffers[1], leaves.size());
+}
+
+
+SnapshotReader::~SnapshotReader()
+{
+}
+
+
+const BusSnapshot &SnapshotReader::capture()
+{
+    BusSnapshot &snapshot = _buffers[_current ^ 1];
+
+    snapshot.syncTimestampNs = _master.sync();
+    snapshot.sequence = ++_sequence;
+    snapshot.missedCount = 0;
+
+    if(_settleUs > 0)
+    {
+        std::this_thread::sleep_for(std::chrono::microseconds(_settleUs));
+    }
+
+    uint8_t block[VOLATILE_BLOCK_SIZE];
+    for(size_t leaf = 0; leaf < _leaves.size(); leaf++)
+    {
+        const size_t first = leaf * SNAPSHOT_VALUES;
+        if(!_master.tryReadMemory(_leaves[leaf], PV0_OFFSET, VOLATILE_BLOCK_SIZE, block))
+        {
+            // the leaf missed the cycle, do not leave values of an older cycle behind
+            std::fill_n(snapshot.pv.begin() + first, SNAPSHOT_VALUES, NAN);
+            std::fill_n(snapshot.dv.begin() + first, SNAPSHOT_VALUES, 0);
+            std::fill_n(snapshot.av.begin() + first, SNAPSHOT_VALUES, NAN);
+            std::fill_n(snapshot.sv.begin() + first, SNAPSHOT_VALUES, 0);
+            snapshot.missed[leaf] = 1;
+            snapshot.missedCount++;
+            continue;
+        }
+
+        memcpy(&snapshot.pv[first], block + (PV0_OFFSET - PV0_OFFSET), SNAPSHOT_VALUES * sizeof(float));
+        memcpy(&snapshot.dv[first], block + (DV0_OFFSET - PV0_OFFSET), SNAPSHOT_VALUES * sizeof(uint32_t));
+        memcpy(&snapshot.av[first], block + (AV0_OFFSET - PV0_OFFSET), SNAPSHOT_VALUES * sizeof(float));
+        memcpy(&snapshot.sv[first], block + (SV0_OFFSET - PV0_OFFSET), SNAPSHOT_VALUES * sizeof(int32_t));
+        snapshot.missed[leaf] = 0;
+    }
+
+    _current ^= 1;
+    return snapshot;
+}
+
+
+const BusSnapshot &SnapshotReader::current() const
+{
+    return _buffers[_current];
+}
+
+
+const BusSnapshot &SnapshotReader::previous() const
+{
+    return _buffers[_current ^ 1];
+}
+
+
+const std::vector<address_t> &SnapshotReader::leaves() const
+{
+    return _leaves;
+}
+
+
+} // namespace Xerxes
@@ -0,0 +1,97 @@
+#ifndef __SNAPSHOT_HPP
+#define __SNAPSHOT_HPP
+
+#include <vector>
+#include <cstdint>
+#include <stddef.h>
+#include "Master.hpp"
+
+namespace Xerxes
+{
+
+
+/// @brief Number of values of each kind (PV, DV, AV, SV) of a leaf
+constexpr size_t SNAPSHOT_VALUES = 4;
+
+
+/**
+ * @brief Values of all leaves sampled at the same SYNC
+ *
+ * Every kind of value is one contiguous array ordered by leaf, PV0..PV3 of the first
+ * leaf followed by PV0..PV3 of the second leaf and so on (see ProcessStatistics::channel).
+ * Process and additional values of a leaf which missed the cycle are NaN, its discrete
+ * and signed values are 0.
+ */
+struct BusSnapshot
+{
+    /// @brief number of the cycle, starts at 1
+    uint64_t sequence = 0;
+    /// @brief steady clock TX timestamp of the SYNC broadcast in nanoseconds, see ClockCorrelator
+    int64_t syncTimestampNs = 0;
+    /// @brief process values PV0..PV3
+    std::vector<float> pv;
+    /// @brief discrete values DV0..DV3
+    std::vector<uint32_t> dv;
+    /// @brief additional values AV0..AV3
+    std::vector<float> av;
+    /// @brief signed values SV0..SV3
+    std::vector<int32_t> sv;
+    /// @brief 1 for every leaf which did not reply in this cycle
+    std::vector<uint8_t> missed;
+    /// @brief number of leaves which did not reply in this cycle
+    size_t missedCount = 0;
+
+    /// @brief Number of leaves
+    size_t leaves() const;
+};
+
+
+/**
+ * @brief Takes consistent snapshots of the volatile values of the leaves on a bus
+ *
+ * A cycle broadcasts SYNC and then reads PV0..SV3 of every leaf with a single READ.
+ * Two snapshot buffers are allocated up front and used alternately, so a cycle does not
+ * allocate and the previous snapshot stays valid for change detection.
+ */
+class SnapshotReader
+{
+private:
+    Master &_master;
+    std::vector<address_t> _leaves;
+    uint32_t _settleUs;
+    BusSnapshot _buffers[2];
+    size_t _current = 0;
+    uint64_t _sequence = 0;
+
+public:
+    /**
+     * @brief Construct a new Snapshot Reader object
+     *
+     * @param master master of the bus
+     * @param leaves addresses of the leaves, the index in this list is the leaf index
+     * @param settleUs pause between SYNC and the first read, lets the leaves finish the measurement
+     */
+    SnapshotReader(Master &master, const std::vector<address_t> &leaves, const uint32_t settleUs = 0);
+    ~SnapshotReader();
+
+    /**
+     * @brief Run one cycle: SYNC and read all leaves
+     *
+     * @return const BusSnapshot& the new snapshot, valid until the next but one capture()
+     */
+    const BusSnapshot &capture();
+
+    /// @brief Snapshot of the last cycle
+    const BusSnapshot &current() const;
+
+    /// @brief Snapshot of the cycle before the last one
+    const BusSnapshot &previous() const;
+
+    /// @brief Addresses of the leaves
+    const std::vector<address_t> &leaves() const;
+};
+
+
+} // namespace Xerxes
+
+#endif // !__SNAPSHOT_HPP
@@ -0,0 +1,286 @@
+#include "Sniffer.hpp"
+#include "MessageId.h"
+#include "Clock.hpp"
+#include <cstring>
+#include <stdexcept>
+
+namespace Xerxes
+{
+
+
+/// @brief Timeout of one raw read, bounds the time stop() waits for the reader
+constexpr uint64_t SNIFFER_READ_TIMEOUT_US = 10000;
+
+/// @brief Number of message ids, the statistics are kept for all of them
+constexpr size_t MSGID_SPACE = 0x10000;
+
+
+FrameReassembler::FrameReassembler()
+{
+    _stream.reserve(SNIFFER_CHUNK_SIZE + MAX_FRAME_SIZE);
+}
+
+
+FrameReassembler::~FrameReassembler()
+{
+}
+
+
+void FrameReassembler::reset()
+{
+    _stats.skippedBytes += _stream.size();
+    _stream.clear();
+}
+
+
+const ReassemblerStats &FrameReassembler::stats() const
+{
+    return _stats;
+}
+
+
+static bool isRequest(const msgid_t msgId)
+{
+    return msgId == MSGID_PING || msgId == MSGID_GET_INFO || msgId == MSGID_READ || msgId == MSGID_READ_MULTI ||
+        msgId == MSGID_WRITE;
+}
+
+
+Sniffer::Sniffer(const size_t ringSize) :
+    _chunks(ringSize),
+    _frames(ringSize),
+    _leaves(std::make_unique<LeafCounters[]>(256)),
+    _msgFrames(std::make_unique<std::atomic<uint64_t>[]>(MSGID_SPACE)),
+    _msgBytes(std::make_unique<std::atomic<uint64_t>[]>(MSGID_SPACE))
+{
+}
+
+
+Sniffer::~Sniffer()
+{
+    stop();
+}
+
+
+void Sniffer::setFrameHandler(std::function<void(const SniffedFrame &)> handler)
+{
+    _frameHandler = std::move(handler);
+}
+
+
+void Sniffer::startPipeline()
+{
+    if(_running.exchange(true))
+    {
+        throw std::runtime_error("Sniffer is already running.");
+    }
+    _readerDone = false;
+    _decoderDone = false;
+    _decoder = std::thread(&Sniffer::decodeLoop, this);
+    _aggregator = std::thread(&Sniffer::aggregateLoop, this);
+}
+
+
+void Sniffer::start(Network &network)
+{
+    startPipeline();
+    _reader = std::thread(&Sniffer::readLoop, this, std::ref(network));
+}
+
+
+void Sniffer::start()
+{
+    startPipeline();
+}
+
+
+void Sniffer::push(const uint8_t *bytes, size_t length, const uint64_t timestampNs)
+{
+    while(length > 0)
+    {
+        RawChunk *chunk;
+        while((chunk = _chunks.claim()) == nullptr)
+        {
+            std::this_thread::yield();
+        }
+        chunk->timestampNs = timestampNs;
+        chunk->length = length < SNIFFER_CHUNK_SIZE ? length : SNIFFER_CHUNK_SIZE;
+        memcpy(chunk->data, bytes, chunk->length);
+        bytes += chunk->length;
+        length -= chunk->length;
+        _chunks.publish();
+    }
+}
+
+
+void Sniffer::stop()
+{
+    if(!_running.exchange(false))
+    {
+        return;
+    }
+
+    // each stage drains its input once the stage before it is done
+    if(_reader.joinable())
+    {
+        _reader.join();
+    }
+    _readerDone = true;
+    _decoder.join();
+    _aggregator.join();
+}
+
+
+void Sniffer::readLoop(Network &network)
+{
+    uint8_t buffer[SNIFFER_CHUNK_SIZE];
+    while(_running.load(std::memory_order_relaxed))
+    {
+        const size_t length = network.readRaw(SNIFFER_READ_TIMEOUT_US, buffer, sizeof(buffer));
+        if(length > 0)
+        {
+            push(buffer, length, steadyNowNs());
+        }
+    }
+}
+
+
+void Sniffer::decodeLoop()
+{
+    while(true)
+    {
+        RawChunk *chunk = _chunks.front();
+        if(chunk == nullptr)
+        {
+            if(_readerDone.load(std::memory_order_acquire) && _chunks.front() == nullptr)
+            {
+                break;
+            }
+            std::this_thread::yield();
+            continue;
+        }
+
+        const uint64_t timestampNs = chunk->timestampNs;
+        _reassembler.push(chunk->data, chunk->length, [&](const uint8_t *data, const size_t length)
+        {
+            SniffedFrame *frame;
+            while((frame = _frames.claim()) == nullptr)
+            {
+                std::this_thread::yield();
+            }
+            frame->timestampNs = timestampNs;
+            frame->length = length;
+            memcpy(frame->data, data, length);
+            _frames.publish();
+        });
+        _bytes.fetch_add(chunk->length, std::memory_order_relaxed);
+        _chunks.release();
+
+        const ReassemblerStats &stats = _reassembler.stats();
+        _frameCount.store(stats.frames, std::memory_order_relaxed);
+        _resyncs.store(stats.resyncs, std::memory_order_relaxed);
+        _skippedBytes.store(stats.skippedBytes, std::memory_order_relaxed);
+    }
+    _decoderDone.store(true, std::memory_order_release);
+}
+
+
+void Sniffer::aggregateLoop()
+{
+    while(true)
+    {
+        SniffedFrame *frame = _frames.front();
+        if(frame == nullptr)
+        {
+            if(_decoderDone.load(std::memory_order_acquire) && _frames.front() == nullptr)
+            {
+                break;
+            }
+            std::this_thread::yield();
+            continue;
+        }
+        aggregate(*frame);
+        _frames.release();
+    }
+}
+
+
+void Sniffer::aggregate(const SniffedFrame &frame)
+{
+    const uint8_t src = frame.data[2];
+    const uint8_t dst = frame.data[3];
+    const msgid_t msgId = frame.data[4] | frame.data[5] << 8;
+
+    _msgFrames[msgId].fetch_add(1, std::memory_order_relaxed);
+    _msgBytes[msgId].fetch_add(frame.length, std::memory_order_relaxed);
+
+    if(isRequest(msgId))
+    {
+        if(dst == BROADCAST_ADDR)
+        {
+            return;
+        }
+        PendingRequest &pending = _pending[dst];
+        if(pending.waiting)
+        {
+            _leaves[dst].unanswered.fetch_add(1, std::memory_order_relaxed);
+        }
+        pending = PendingRequest{frame.timestampNs, src, true};
+        _leaves[dst].requests.fetch_add(1, std::memory_order_relaxed);
+    }
+    else
+    {
+        PendingRequest &pending = _pending[src];
+        if(pending.waiting && pending.requester == dst)
+        {
+            pending.waiting = false;
+            _leaves[src].replies.fetch_add(1, std::memory_order_relaxed);
+            _leaves[src].responseNs.record(frame.timestampNs - pending.timestampNs);
+        }
+    }
+
+    if(_frameHandler)
+    {
+        _frameHandler(frame);
+    }
+}
+
+
+SnifferStats Sniffer::snapshot() const
+{
+    SnifferStats stats;
+    stats.bytes = _bytes.load(std::memory_order_relaxed);
+    stats.reassembler.frames = _frameCount.load(std::memory_order_relaxed);
+    stats.reassembler.resyncs = _resyncs.load(std::memory_order_relaxed);
+    stats.reassembler.skippedBytes = _skippedBytes.load(std::memory_order_relaxed);
+
+    for(size_t address = 0; address < 256; address++)
+    {
+        const LeafCounters &counters = _leaves[address];
+        if(counters.requests.load(std::memory_order_relaxed) == 0)
+        {
+            continue;
+        }
+        SnifferLeafStats leaf;
+        leaf.requests = counters.requests.load(std::memory_order_relaxed);
+        leaf.replies = counters.replies.load(std::memory_order_relaxed);
+        leaf.unanswered = counters.unanswered.load(std::memory_order_relaxed);
+        leaf.responseNs = counters.responseNs.snapshot();
+        stats.leaves.emplace_back((uint8_t)address, leaf);
+    }
+
+    for(size_t msgId = 0; msgId < MSGID_SPACE; msgId++)
+    {
+        const uint64_t frames = _msgFrames[msgId].load(std::memory_order_relaxed);
+        if(frames > 0)
+        {
+            stats.messages.push_back(SnifferMessageStats{
+                (msgid_t)msgId, frames, _msgBytes[msgId].load(std::memory_order_relaxed)
+            });
+        }
+    }
+    return stats;
+}
+
+
+} // namespace Xerxes
@@ -0,0 +1,382 @@
+#ifndef __SNIFFER_HPP
+#define __SNIFFER_HPP
+
+#include <array>
+#include <atomic>
+#include <bit>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <stddef.h>
+#include <thread>
+#include <utility>
+#include <vector>
+#include "Network.hpp"
+#include "Metrics.hpp"
+#include "Trace.hpp"
+
+namespace Xerxes
+{
+
+
+/// @brief Shortest valid frame: SOH | LEN | SRC | DST | MSGID_L | MSGID_H | CHECKSUM
+constexpr size_t MIN_FRAME_SIZE = 7;
+
+/// @brief Size of a chunk of raw bytes handed from the reader to the decoder
+constexpr size_t SNIFFER_CHUNK_SIZE = 1024;
+
+
+/**
+ * @brief Counters of the frame reassembler
+ *
+ */
+struct ReassemblerStats
+{
+    /// @brief valid frames found
+    uint64_t frames = 0;
+    /// @brief candidate frames rejected by length or checksum, each costs a resynchronisation
+    uint64_t resyncs = 0;
+    /// @brief bytes which are not part of any valid frame
+    uint64_t skippedBytes = 0;
+};
+
+
+/**
+ * @brief Reconstructs frames from a raw byte stream
+ *
+ * Looks for SOH, takes LEN and verifies the checksum once LEN bytes arrived. A candidate
+ * which fails is dropped by a single byte and the search for SOH restarts right after
+ * its SOH, so a frame hidden behind a spurious SOH or a truncated frame is still found.
+ */
+class FrameReassembler
+{
+private:
+    std::vector<uint8_t> _stream;
+    ReassemblerStats _stats;
+
+public:
+    FrameReassembler();
+    ~FrameReassembler();
+
+    /**
+     * @brief Add received bytes and report the frames they complete
+     *
+     * @param bytes received bytes
+     * @param length number of bytes
+     * @param onFrame called with (const uint8_t *frame, size_t length) for every valid frame
+     */
+    template<class F>
+    void push(const uint8_t *bytes, const size_t length, F &&onFrame)
+    {
+        _stream.insert(_stream.end(), bytes, bytes + length);
+
+        const uint8_t *buffer = _stream.data();
+        const size_t size = _stream.size();
+        size_t pos = 0;
+        while(true)
+        {
+            while(pos < size && buffer[pos] != SOH)
+            {
+                pos++;
+                _stats.skippedBytes++;
+            }
+            if(size - pos < 2)
+            {
+                break;
+            }
+
+            const size_t frameLength = buffer[pos + 1];
+            if(frameLength < MIN_FRAME_SIZE)
+            {
+                pos++;
+                _stats.resyncs++;
+                _stats.skippedBytes++;
+                continue;
+            }
+            if(size - pos < frameLength)
+            {
+                // wait for the rest of the frame
+                break;
+            }
+
+            uint8_t checksum = 0;
+            for(size_t i = 0; i < frameLength; i++)
+            {
+                checksum += buffer[pos + i];
+            }
+            if(checksum == 0)
+            {
+                onFrame(buffer + pos, frameLength);
+                _stats.frames++;
+                pos += frameLength;
+            }
+            else
+            {
+                pos++;
+                _stats.resyncs++;
+                _stats.skippedBytes++;
+            }
+        }
+        _stream.erase(_stream.begin(), _stream.begin() + pos);
+    }
+
+    /// @brief Drop the bytes of an incomplete frame, eg. after a gap in the stream
+    void reset();
+
+    const ReassemblerStats &stats() const;
+};
+
+
+/**
+ * @brief Frame found by the sniffer
+ *
+ */
+struct SniffedFrame
+{
+    /// @brief steady clock time of the chunk holding the last byte of the frame in nanoseconds
+    uint64_t timestampNs;
+    uint8_t length;
+    /// @brief raw bytes SOH..CHECKSUM
+    uint8_t data[MAX_FRAME_SIZE];
+};
+
+
+/**
+ * @brief Request and reply statistics of one leaf seen by the sniffer
+ *
+ */
+struct SnifferLeafStats
+{
+    uint64_t requests = 0;
+    uint64_t replies = 0;
+    /// @brief requests followed by another request to the leaf before any reply
+    uint64_t unanswered = 0;
+    /// @brief time between the request and the reply in nanoseconds
+    HistogramSnapshot responseNs;
+};
+
+
+/**
+ * @brief Frames and bytes of one message id seen by the sniffer
+ *
+ */
+struct SnifferMessageStats
+{
+    msgid_t msgId;
+    uint64_t frames;
+    uint64_t bytes;
+};
+
+
+/**
+ * @brief Copy of the statistics of the sniffer
+ *
+ */
+struct SnifferStats
+{
+    uint64_t bytes = 0;
+    ReassemblerStats reassembler;
+    /// @brief leaves with at least one request, ordered by address
+    std::vector<std::pair<uint8_t, SnifferLeafStats>> leaves;
+    /// @brief message ids seen at least once, ordered by message id
+    std::vector<SnifferMessageStats> messages;
+};
+
+
+namespace detail
+{
+
+/**
+ * @brief Single producer, single consumer ring of fixed slots
+ *
+ */
+template<class T>
+class SpscRing
+{
+private:
+    std::unique_ptr<T[]> _slots;
+    size_t _mask;
+    alignas(64) std::atomic<size_t> _head {0};
+    alignas(64) std::atomic<size_t> _tail {0};
+
+public:
+    /// @param capacity number of slots, rounded up to a power of two
+    SpscRing(const size_t capacity);
+
+    /// @brief Slot to fill, nullptr if the ring is full
+    T *claim();
+    /// @brief Publish the slot returned by claim()
+    void publish();
+    /// @brief Oldest published slot, nullptr if the ring is empty
+    T *front();
+    /// @brief Release the slot returned by front()
+    void release();
+};
+
+
+template<class T>
+SpscRing<T>::SpscRing(const size_t capacity)
+{
+    const size_t size = std::bit_ceil(capacity < 2 ? 2 : capacity);
+    _slots = std::make_unique<T[]>(size);
+    _mask = size - 1;
+}
+
+
+template<class T>
+T *SpscRing<T>::claim()
+{
+    const size_t head = _head.load(std::memory_order_relaxed);
+    if(head - _tail.load(std::memory_order_acquire) > _mask)
+    {
+        return nullptr;
+    }
+    return &_slots[head & _mask];
+}
+
+
+template<class T>
+void SpscRing<T>::publish()
+{
+    _head.store(_head.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+}
+
+
+template<class T>
+T *SpscRing<T>::front()
+{
+    const size_t tail = _tail.load(std::memory_order_relaxed);
+    if(tail == _head.load(std::memory_order_acquire))
+    {
+        return nullptr;
+    }
+    return &_slots[tail & _mask];
+}
+
+
+template<class T>
+void SpscRing<T>::release()
+{
+    _tail.store(_tail.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+}
+
+} // namespace detail
+
+
+/**
+ * @brief Passive listener of a bus
+ *
+ * Reconstructs the frames on a bus it does not control, pairs requests with replies to
+ * measure the response time of each leaf and counts the traffic per message id. The work
+ * is split into a pipeline of threads connected by lock-free rings:
+ *
+ *     reader (Network::readRaw) -> decoder (FrameReassembler) -> aggregator (statistics)
+ *
+ * For offline processing, eg. of a raw dump of a serial port, start the pipeline without
+ * a network and push() the bytes, this runs as fast as the decoder allows.
+ *
+ * A request is PING, GET_INFO, READ or WRITE, its reply is any frame coming back from the
+ * addressed leaf to the requester.
+ */
+class Sniffer
+{
+private:
+    struct RawChunk
+    {
+        uint64_t timestampNs;
+        size_t length;
+        uint8_t data[SNIFFER_CHUNK_SIZE];
+    };
+
+    struct PendingRequest
+    {
+        uint64_t timestampNs;
+        uint8_t requester;
+        bool waiting;
+    };
+
+    struct LeafCounters
+    {
+        std::atomic<uint64_t> requests {0};
+        std::atomic<uint64_t> replies {0};
+        std::atomic<uint64_t> unanswered {0};
+        LatencyHistogram responseNs;
+    };
+
+    detail::SpscRing<RawChunk> _chunks;
+    detail::SpscRing<SniffedFrame> _frames;
+
+    std::thread _reader;
+    std::thread _decoder;
+    std::thread _aggregator;
+    std::atomic<bool> _running {false};
+    std::atomic<bool> _readerDone {false};
+    std::atomic<bool> _decoderDone {false};
+
+    FrameReassembler _reassembler;
+    std::atomic<uint64_t> _bytes {0};
+    std::atomic<uint64_t> _frameCount {0};
+    std::atomic<uint64_t> _resyncs {0};
+    std::atomic<uint64_t> _skippedBytes {0};
+
+    std::array<PendingRequest, 256> _pending {};
+    std::unique_ptr<LeafCounters[]> _leaves;
+    std::unique_ptr<std::atomic<uint64_t>[]> _msgFrames;
+    std::unique_ptr<std::atomic<uint64_t>[]> _msgBytes;
+
+    std::function<void(const SniffedFrame &)> _frameHandler;
+
+    void readLoop(Network &network);
+    void decodeLoop();
+    void aggregateLoop();
+    void aggregate(const SniffedFrame &frame);
+    void startPipeline();
+
+public:
+    /**
+     * @brief Construct a new Sniffer object
+     *
+     * @param ringSize number of slots of each ring between the threads
+     */
+    Sniffer(const size_t ringSize = 1024);
+
+    /// @brief Stops the pipeline
+    ~Sniffer();
+
+    /**
+     * @brief Call the handler for every frame, on the aggregator thread
+     *
+     * @param handler handler to call, eg. to write the frames into a capture, set it before start()
+     */
+    void setFrameHandler(std::function<void(const SniffedFrame &)> handler);
+
+    /**
+     * @brief Start listening on a network
+     *
+     * @param network network to read the raw bytes from, must outlive the sniffer
+     */
+    void start(Network &network);
+
+    /// @brief Start the decoder and aggregator only, feed them with push()
+    void start();
+
+    /**
+     * @brief Feed raw bytes to a sniffer started without a network, waits while the pipeline is full
+     *
+     * @param bytes raw bytes
+     * @param length number of bytes
+     * @param timestampNs time of the last byte in nanoseconds
+     */
+    void push(const uint8_t *bytes, size_t length, const uint64_t timestampNs);
+
+    /// @brief Stop reading and wait until everything read so far is processed
+    void stop();
+
+    /// @brief Copy the statistics, safe to call while running
+    SnifferStats snapshot() const;
+};
+
+
+} // namespace Xerxes
+
+#endif // !__SNIFFER_HPP
@@ -0,0 +1,227 @@
+#include "Statistics.hpp"
+#include <cmath>
+#include <limits>
+
+namespace Xerxes
+{
+
+
+ProcessStatistics::ProcessStatistics(
+    const size_t leaves,
+    const double ewmaAlpha,
+    const std::vector<double> &quantiles,
+    const double quantileStep
+) :
+    _channels(leaves * PV_COUNT),
+    _alpha(ewmaAlpha),
+    _eta(quantileStep),
+    _quantiles(quantiles),
+    _count(_channels),
+    _mean(_channels),
+    _m2(_channels),
+    _min(_channels),
+    _max(_channels),
+    _ewma(_channels),
+    _absdev(_channels),
+    _estimates(_channels * quantiles.size())
+{
+    reset();
+}
+
+
+ProcessStatistics::~ProcessStatistics()
+{
+}
+
+
+size_t ProcessStatistics::channels() const
+{
+    return _channels;
+}
+
+
+size_t ProcessStatistics::channel(const size_t leaf, const size_t pv)
+{
+    return leaf * PV_COUNT + pv;
+}
+
+
+// the kernels take restrict parameters so the compiler can vectorise them,
+// they are free of branches and missing samples (NaN) get weight 0
+
+static void updateMoments(
+    const size_t n,
+    const double alpha,
+    const float *__restrict samples,
+    double *__restrict count,
+    double *__restrict mean,
+    double *__restrict m2,
+    double *__restrict absdev,
+    double *__restrict ewma
+)
+{
+    for(size_t i = 0; i < n; i++)
+    {
+        const double x = samples[i];
+        const bool valid = !std::isnan(x);
+        const double w = valid ? 1.0 : 0.0;
+        const double v = valid ? x : 0.0;
+
+        const double c = count[i] + w;
+        // 1/c for a valid sample, 0 for a missing one
+        const double inv = w / (c + (1.0 - w));
+        const double delta = v - mean[i];
+        const double new_mean = mean[i] + delta * inv;
+        m2[i] += w * delta * (v - new_mean);
+        absdev[i] += (std::fabs(v - new_mean) - absdev[i]) * inv;
+        mean[i] = new_mean;
+        count[i] = c;
+
+        // the first sample initialises the average
+        const double a = (c == 1.0) ? 1.0 : alpha;
+        ewma[i] += w * a * (v - ewma[i]);
+    }
+}
+
+
+static void updateRange(
+    const size_t n,
+    const float *__restrict samples,
+    double *__restrict min,
+    double *__restrict max
+)
+{
+    for(size_t i = 0; i < n; i++)
+    {
+        // NaN compares false, a missing sample keeps the old values
+        const double x = samples[i];
+        const double lo = min[i];
+        const double hi = max[i];
+        min[i] = x < lo ? x : lo;
+        max[i] = x > hi ? x : hi;
+    }
+}
+
+
+static void updateQuantile(
+    const size_t n,
+    const double p,
+    const double eta,
+    const float *__restrict samples,
+    const double *__restrict count,
+    const double *__restrict absdev,
+    double *__restrict est
+)
+{
+    for(size_t i = 0; i < n; i++)
+    {
+        const double x = samples[i];
+        const bool valid = !std::isnan(x);
+        const double v = valid ? x : est[i];
+
+        // the first sample initialises the estimate
+        const double first = (count[i] == 1.0) ? 1.0 : 0.0;
+        const double step = eta * absdev[i] * (v > est[i] ? p : p - 1.0);
+        est[i] = first * v + (1.0 - first) * (est[i] + (valid ? step : 0.0));
+    }
+}
+
+
+void ProcessStatistics::update(const float *samples)
+{
+    updateMoments(
+        _channels, _alpha, samples,
+        _count.data(), _mean.data(), _m2.data(), _absdev.data(), _ewma.data()
+    );
+    updateRange(_channels, samples, _min.data(), _max.data());
+
+    for(size_t q = 0; q < _quantiles.size(); q++)
+    {
+        updateQuantile(
+            _channels, _quantiles[q], _eta, samples,
+            _count.data(), _absdev.data(), _estimates.data() + q * _channels
+        );
+    }
+}
+
+
+void ProcessStatistics::reset()
+{
+    for(size_t i = 0; i < _channels; i++)
+    {
+        reset(i);
+    }
+}
+
+
+void ProcessStatistics::reset(const size_t channel)
+{
+    _count[channel] = 0;
+    _mean[channel] = 0;
+    _m2[channel] = 0;
+    _min[channel] = std::numeric_limits<double>::infinity();
+    _max[channel] = -std::numeric_limits<double>::infinity();
+    _ewma[channel] = 0;
+    _absdev[channel] = 0;
+    for(size_t q = 0; q < _quantiles.size(); q++)
+    {
+        _estimates[q * _channels + channel] = 0;
+    }
+}
+
+
+uint64_t ProcessStatistics::count(const size_t channel) const
+{
+    return (uint64_t)_count[channel];
+}
+
+
+double ProcessStatistics::mean(const size_t channel) const
+{
+    return _mean[channel];
+}
+
+
+double ProcessStatistics::variance(const size_t channel) const
+{
+    return _count[channel] > 1 ? _m2[channel] / (_count[channel] - 1) : 0.0;
+}
+
+
+double ProcessStatistics::stddev(const size_t channel) const
+{
+    return std::sqrt(variance(channel));
+}
+
+
+double ProcessStatistics::min(const size_t channel) const
+{
+    return _min[channel];
+}
+
+
+double ProcessStatistics::max(const size_t channel) const
+{
+    return _max[channel];
+}
+
+
+double ProcessStatistics::ewma(const size_t channel) const
+{
+    return _ewma[channel];
+}
+
+
+double ProcessStatistics::quantile(const size_t channel, const size_t index) const
+{
+    return _estimates[index * _channels + channel];
+}
+
+
+const double *ProcessStatistics::means() const
+{
+    return _mean.data();
+}
+
+
+} // namespace Xerxes
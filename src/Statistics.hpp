@@ -0,0 +1,110 @@
+#ifndef __STATISTICS_HPP
+#define __STATISTICS_HPP
+
+#include <vector>
+#include <cstdint>
+#include <stddef.h>
+
+namespace Xerxes
+{
+
+
+/// @brief Number of process values (PV0..PV3) of a leaf
+constexpr size_t PV_COUNT = 4;
+
+
+/**
+ * @brief Online statistics of process values of many leaves
+ *
+ * Replaces the on-device MEAN/STDDEV/MIN/MAX_PV* registers with statistics computed on
+ * the host from the polled PV0..PV3 samples. Every statistic is stored as one contiguous
+ * array over all channels (channel = leaf index * PV_COUNT + pv), and update() runs the
+ * same branch-free arithmetic over all of them so the compiler can vectorise it.
+ *
+ * Computed per channel:
+ * - count, mean and variance (Welford)
+ * - minimum and maximum
+ * - exponentially weighted moving average
+ * - quantile estimates (frugal streaming sketch, step scaled by the mean absolute deviation)
+ */
+class ProcessStatistics
+{
+private:
+    size_t _channels;
+    double _alpha;
+    double _eta;
+    std::vector<double> _quantiles;
+
+    std::vector<double> _count;
+    std::vector<double> _mean;
+    std::vector<double> _m2;
+    std::vector<double> _min;
+    std::vector<double> _max;
+    std::vector<double> _ewma;
+    /// @brief mean absolute deviation, scales the step of the quantile estimator
+    std::vector<double> _absdev;
+    /// @brief estimates of all quantiles, _quantiles.size() arrays of _channels values
+    std::vector<double> _estimates;
+
+public:
+    /**
+     * @brief Construct a new Process Statistics object
+     *
+     * @param leaves number of leaves, each contributes PV_COUNT channels
+     * @param ewmaAlpha smoothing factor of the moving average, 0..1
+     * @param quantiles quantiles to estimate, each in range 0..1
+     * @param quantileStep step of the quantile estimator relative to the mean absolute deviation
+     */
+    ProcessStatistics(
+        const size_t leaves,
+        const double ewmaAlpha = 0.1,
+        const std::vector<double> &quantiles = {0.5, 0.99},
+        const double quantileStep = 0.05
+    );
+    ~ProcessStatistics();
+
+    /// @brief Number of channels
+    size_t channels() const;
+
+    /// @brief Index of the channel of a process value of a leaf
+    static size_t channel(const size_t leaf, const size_t pv);
+
+    /**
+     * @brief Feed one sample of every channel
+     *
+     * @param samples channels() samples ordered by channel, NaN for a missing sample
+     */
+    void update(const float *samples);
+
+    /// @brief Forget the statistics of all channels
+    void reset();
+
+    /// @brief Forget the statistics of one channel
+    void reset(const size_t channel);
+
+    uint64_t count(const size_t channel) const;
+    double mean(const size_t channel) const;
+    /// @brief sample variance, 0 for less than 2 samples
+    double variance(const size_t channel) const;
+    double stddev(const size_t channel) const;
+    double min(const size_t channel) const;
+    double max(const size_t channel) const;
+    double ewma(const size_t channel) const;
+
+    /**
+     * @brief Get the quantile estimate of the channel
+     *
+     * @param channel channel index
+     * @param index index of the quantile in the list given to the constructor
+     * @return double estimate of the quantile
+     */
+    double quantile(const size_t channel, const size_t index) const;
+
+    /// @brief Contiguous array of the means of all channels
+    const double *means() const;
+};
+
+
+} // namespace Xerxes
+
+#endif // !__STATISTICS_HPP
@@ -0,0 +1,347 @@
+#include "Stress.hpp"
+#include "Clock.hpp"
+#include "MessageId.h"
+#include "Sniffer.hpp"
+#include <algorithm>
+#include <cstring>
+
+namespace Xerxes
+{
+
+
+/// @brief Frames after the expected one searched for a decoded frame, covers the frames lost in between
+constexpr size_t MATCH_WINDOW = 64;
+
+/// @brief Size of the raw reads of NoisyNetwork from the inner network
+constexpr size_t NOISY_READ_SIZE = 1024;
+
+
+/// @brief xorshift64*, fast enough to draw a number for every byte of the stream
+static uint32_t xorshift(uint64_t &state)
+{
+    state ^= state >> 12;
+    state ^= state << 25;
+    state ^= state >> 27;
+    return (uint32_t)((state * 0x2545F4914F6CDD1DULL) >> 32);
+}
+
+
+/// @brief Probability scaled to the range of the generator, compared against a draw
+static uint32_t threshold(const double rate)
+{
+    if(rate <= 0)
+    {
+        return 0;
+    }
+    if(rate >= 1)
+    {
+        return UINT32_MAX;
+    }
+    return (uint32_t)(rate * 4294967296.0);
+}
+
+
+NoiseInjector::NoiseInjector(const NoiseProfile &profile) :
+    _profile(profile),
+    // the state of xorshift must never be 0
+    _state(profile.seed ? profile.seed : 1),
+    _bitFlip(threshold(profile.bitFlipRate)),
+    _drop(threshold(profile.dropRate)),
+    _spuriousSoh(threshold(profile.spuriousSohRate)),
+    _truncate(threshold(profile.truncateRate))
+{
+}
+
+
+NoiseInjector::~NoiseInjector()
+{
+}
+
+
+uint32_t NoiseInjector::next()
+{
+    return xorshift(_state);
+}
+
+
+const NoiseProfile &NoiseInjector::profile() const
+{
+    return _profile;
+}
+
+
+size_t NoiseInjector::corruptBytes(const uint8_t *bytes, const size_t length, std::vector<uint8_t> &out)
+{
+    size_t faults = 0;
+    for(size_t i = 0; i < length; i++)
+    {
+        if(_spuriousSoh && next() < _spuriousSoh)
+        {
+            out.push_back(SOH);
+            faults++;
+        }
+        if(_drop && next() < _drop)
+        {
+            faults++;
+            continue;
+        }
+        uint8_t byte = bytes[i];
+        if(_bitFlip && next() < _bitFlip)
+        {
+            byte ^= 1 << (next() & 7);
+            faults++;
+        }
+        out.push_back(byte);
+    }
+    return faults;
+}
+
+
+bool NoiseInjector::corruptFrame(const uint8_t *frame, const size_t length, std::vector<uint8_t> &out)
+{
+    size_t sent = length;
+    if(_truncate && length > 2 && next() < _truncate)
+    {
+        // cut anywhere after LEN, the frame claims more bytes than follow
+        sent = 2 + next() % (length - 2);
+    }
+    const size_t faults = corruptBytes(frame, sent, out);
+    return faults > 0 || sent < length;
+}
+
+
+NoisyNetwork::NoisyNetwork(Network &inner, const NoiseProfile &profile) :
+    _inner(inner), _noise(profile)
+{
+}
+
+
+NoisyNetwork::~NoisyNetwork()
+{
+}
+
+
+bool NoisyNetwork::sendData(const Packet &toSend) const
+{
+    return _inner.sendData(toSend);
+}
+
+
+bool NoisyNetwork::readData(const uint64_t timeoutUs, Packet &packet)
+{
+    if(!_inner.readData(timeoutUs, packet))
+    {
+        return false;
+    }
+
+    _buffer.clear();
+    _noise.corruptFrame(packet.data(), packet.size(), _buffer);
+    const int64_t timestamp = packet.getTimestamp();
+    packet.setData(_buffer);
+    packet.setTimestamp(timestamp);
+    return true;
+}
+
+
+size_t NoisyNetwork::readRaw(const uint64_t timeoutUs, uint8_t *buffer, const size_t size)
+{
+    if(_buffer.empty())
+    {
+        uint8_t raw[NOISY_READ_SIZE];
+        const size_t length = _inner.readRaw(timeoutUs, raw, sizeof(raw));
+        _noise.corruptBytes(raw, length, _buffer);
+    }
+
+    // spurious SOH bytes make the corrupted data longer than the read, the rest waits for the next call
+    const size_t length = _buffer.size() < size ? _buffer.size() : size;
+    memcpy(buffer, _buffer.data(), length);
+    _buffer.erase(_buffer.begin(), _buffer.begin() + length);
+    return length;
+}
+
+
+double StressResult::throughputMBps() const
+{
+    return seconds > 0 ? (double)bytes / seconds / 1e6 : 0;
+}
+
+
+double StressResult::cleanRecovery() const
+{
+    return framesClean > 0 ? (double)cleanRecovered / (double)framesClean : 1;
+}
+
+
+double StressResult::resyncUsP99(const uint32_t baudRate) const
+{
+    return (double)frameTimeNs(resyncBytes.percentile(0.99), baudRate) / 1e3;
+}
+
+
+std::vector<std::string> StressResult::violations(const StressThresholds &thresholds) const
+{
+    std::vector<std::string> failed;
+    if(throughputMBps() < thresholds.minThroughputMBps)
+    {
+        failed.push_back("throughput " + std::to_string(throughputMBps()) + " MB/s below " + std::to_string(thresholds.minThroughputMBps));
+    }
+    if(cleanRecovery() < thresholds.minCleanRecovery)
+    {
+        failed.push_back("clean frame recovery " + std::to_string(cleanRecovery()) + " below " + std::to_string(thresholds.minCleanRecovery));
+    }
+    if(resyncBytes.percentile(0.99) > thresholds.maxResyncBytesP99)
+    {
+        failed.push_back("p99 resync distance " + std::to_string(resyncBytes.percentile(0.99)) + " bytes above " + std::to_string(thresholds.maxResyncBytesP99));
+    }
+    const double falseRatio = framesSent > 0 ? (double)falseFrames / (double)framesSent : 0;
+    if(falseRatio > thresholds.maxFalseFrameRatio)
+    {
+        failed.push_back("false frame ratio " + std::to_string(falseRatio) + " above " + std::to_string(thresholds.maxFalseFrameRatio));
+    }
+    return failed;
+}
+
+
+StressHarness::StressHarness(const NoiseProfile &profile, const size_t chunkSize) :
+    _profile(profile), _chunkSize(chunkSize ? chunkSize : 1)
+{
+}
+
+
+StressHarness::~StressHarness()
+{
+}
+
+
+/**
+ * @brief Append a random well-formed frame, mostly short requests and replies like a polled bus
+ *
+ */
+static void randomFrame(uint64_t &state, std::vector<uint8_t> &out)
+{
+    static constexpr msgid_t msgIds[] = {MSGID_PING, MSGID_PING_REPLY, MSGID_READ, MSGID_READ_VALUE, MSGID_WRITE, MSGID_ACK_OK, MSGID_SYNC};
+
+    const msgid_t msgId = msgIds[xorshift(state) % (sizeof(msgIds) / sizeof(msgIds[0]))];
+    size_t payload = 0;
+    if(msgId == MSGID_READ_VALUE || msgId == MSGID_WRITE)
+    {
+        // one in sixteen is a large block, the rest a few registers
+        payload = (xorshift(state) & 15) == 0 ? xorshift(state) % (MAX_FRAME_SIZE - MIN_FRAME_SIZE + 1) : 4 + xorshift(state) % 29;
+    }
+    else if(msgId == MSGID_READ)
+    {
+        payload = 3;
+    }
+    else if(msgId == MSGID_PING_REPLY)
+    {
+        payload = 3;
+    }
+
+    const size_t length = MIN_FRAME_SIZE + payload;
+    const size_t start = out.size();
+    out.push_back(SOH);
+    out.push_back((uint8_t)length);
+    out.push_back(xorshift(state) & 0xff);
+    out.push_back(xorshift(state) & 0xff);
+    out.push_back(msgId & 0xff);
+    out.push_back(msgId >> 8);
+    for(size_t i = 0; i < payload; i++)
+    {
+        out.push_back(xorshift(state) & 0xff);
+    }
+
+    uint8_t checksum = 0;
+    for(size_t i = start; i < out.size(); i++)
+    {
+        checksum += out[i];
+    }
+    out.push_back(~checksum + 1); // two's complement
+}
+
+
+StressResult StressHarness::run(const size_t frames)
+{
+    StressResult result;
+    result.framesSent = frames;
+
+    // ground truth: the clean frames and where each one starts in the corrupted stream
+    std::vector<uint8_t> clean;
+    std::vector<size_t> cleanOffset(frames);
+    std::vector<size_t> noisyOffset(frames);
+    std::vector<uint8_t> damaged(frames);
+    std::vector<uint8_t> stream;
+    clean.reserve(frames * 24);
+    stream.reserve(frames * 24);
+
+    uint64_t state = _profile.seed ^ 0x9E3779B97F4A7C15ULL;
+    NoiseInjector noise(_profile);
+    for(size_t i = 0; i < frames; i++)
+    {
+        cleanOffset[i] = clean.size();
+        randomFrame(state, clean);
+        noisyOffset[i] = stream.size();
+        damaged[i] = noise.corruptFrame(clean.data() + cleanOffset[i], clean.size() - cleanOffset[i], stream);
+        result.framesClean += !damaged[i];
+    }
+    result.bytes = stream.size();
+
+    // timed pass, the decoder alone
+    {
+        FrameReassembler reassembler;
+        uint64_t found = 0;
+        const int64_t start = steadyNowNs();
+        for(size_t pos = 0; pos < stream.size(); pos += _chunkSize)
+        {
+            const size_t length = std::min(_chunkSize, stream.size() - pos);
+            reassembler.push(stream.data() + pos, length, [&found](const uint8_t *, const size_t) { found++; });
+        }
+        result.seconds = (double)(steadyNowNs() - start) / 1e9;
+        result.resyncs = reassembler.stats().resyncs;
+        result.skippedBytes = reassembler.stats().skippedBytes;
+    }
+
+    // accounting pass, match every decoded frame against the frames sent
+    std::vector<uint8_t> recovered(frames);
+    FrameReassembler reassembler;
+    size_t expected = 0;
+    for(size_t pos = 0; pos < stream.size(); pos += _chunkSize)
+    {
+        const size_t length = std::min(_chunkSize, stream.size() - pos);
+        reassembler.push(stream.data() + pos, length, [&](const uint8_t *frame, const size_t frameLength) {
+            const size_t last = std::min(frames, expected + MATCH_WINDOW);
+            for(size_t i = expected; i < last; i++)
+            {
+                const size_t end = i + 1 < frames ? cleanOffset[i + 1] : clean.size();
+                if(end - cleanOffset[i] == frameLength && memcmp(clean.data() + cleanOffset[i], frame, frameLength) == 0)
+                {
+                    recovered[i] = 1;
+                    expected = i + 1;
+                    return;
+                }
+            }
+            result.falseFrames++;
+        });
+    }
+
+    LatencyHistogram resync;
+    size_t nextRecovered = frames;
+    for(size_t i = frames; i-- > 0;)
+    {
+        result.framesRecovered += recovered[i];
+        result.cleanRecovered += recovered[i] && !damaged[i];
+        if(damaged[i] && nextRecovered < frames)
+        {
+            resync.record(recovered[i] ? 0 : noisyOffset[nextRecovered] - noisyOffset[i]);
+        }
+        if(recovered[i])
+        {
+            nextRecovered = i;
+        }
+    }
+    result.framesLost = frames - result.framesRecovered;
+    result.resyncBytes = resync.snapshot();
+    return result;
+}
+
+
+} // namespace Xerxes
@@ -0,0 +1,204 @@
+#ifndef __STRESS_HPP
+#define __STRESS_HPP
+
+#include "Network.hpp"
+#include "Metrics.hpp"
+#include <cstdint>
+#include <stddef.h>
+#include <string>
+#include <vector>
+
+namespace Xerxes
+{
+
+
+/**
+ * @brief Rates of the faults injected into a byte stream
+ *
+ * Byte rates apply to every byte independently, the truncation rate to every frame.
+ */
+struct NoiseProfile
+{
+    /// @brief probability of a byte getting one bit flipped
+    double bitFlipRate = 0;
+    /// @brief probability of a byte being lost
+    double dropRate = 0;
+    /// @brief probability of a spurious SOH inserted before a byte
+    double spuriousSohRate = 0;
+    /// @brief probability of a frame being cut short, so LEN claims more bytes than were sent
+    double truncateRate = 0;
+    /// @brief seed of the pseudo random generator, equal seeds give equal noise
+    uint64_t seed = 1;
+};
+
+
+/**
+ * @brief Corrupts byte streams according to a NoiseProfile
+ *
+ */
+class NoiseInjector
+{
+private:
+    NoiseProfile _profile;
+    uint64_t _state;
+    /// @brief rates scaled to the 32 bit range of the generator
+    uint32_t _bitFlip, _drop, _spuriousSoh, _truncate;
+
+    uint32_t next();
+
+public:
+    NoiseInjector(const NoiseProfile &profile);
+    ~NoiseInjector();
+
+    const NoiseProfile &profile() const;
+
+    /**
+     * @brief Append a corrupted copy of one frame to the output
+     *
+     * @param frame bytes of the frame
+     * @param length number of bytes
+     * @param out stream the corrupted bytes are appended to
+     * @return true if any fault hit the frame
+     */
+    bool corruptFrame(const uint8_t *frame, const size_t length, std::vector<uint8_t> &out);
+
+    /**
+     * @brief Append a corrupted copy of raw bytes to the output, without truncation
+     *
+     * @param bytes bytes to corrupt
+     * @param length number of bytes
+     * @param out stream the corrupted bytes are appended to
+     * @return size_t number of faults injected
+     */
+    size_t corruptBytes(const uint8_t *bytes, const size_t length, std::vector<uint8_t> &out);
+};
+
+
+/**
+ * @brief Network corrupting everything received from another network
+ *
+ * Puts a receive path, eg. a Master over a SimulatedBus, onto a noisy line. Sent data
+ * passes unchanged.
+ */
+class NoisyNetwork : public Network
+{
+private:
+    Network &_inner;
+    NoiseInjector _noise;
+    std::vector<uint8_t> _buffer;
+
+public:
+    NoisyNetwork(Network &inner, const NoiseProfile &profile);
+    ~NoisyNetwork();
+
+    bool sendData(const Packet &toSend) const override;
+    bool readData(const uint64_t timeoutUs, Packet &packet) override;
+    size_t readRaw(const uint64_t timeoutUs, uint8_t *buffer, const size_t size) override;
+};
+
+
+/**
+ * @brief Minimum quality the decoder must keep on a noisy stream
+ *
+ */
+struct StressThresholds
+{
+    /// @brief decoded megabytes of the stream per second
+    double minThroughputMBps = 0;
+    /// @brief frames recovered of the frames untouched by the noise
+    double minCleanRecovery = 0.99;
+    /// @brief 99th percentile of the bytes between a fault and the next recovered frame
+    uint64_t maxResyncBytesP99 = 2 * 255;
+    /// @brief decoded frames which were never sent, per frame sent
+    double maxFalseFrameRatio = 0.001;
+};
+
+
+/**
+ * @brief Result of a stress run
+ *
+ */
+struct StressResult
+{
+    /// @brief frames put into the stream
+    uint64_t framesSent = 0;
+    /// @brief frames no fault hit
+    uint64_t framesClean = 0;
+    /// @brief clean frames the decoder found
+    uint64_t cleanRecovered = 0;
+    /// @brief frames the decoder found, including damaged ones which still passed
+    uint64_t framesRecovered = 0;
+    /// @brief frames sent and not found
+    uint64_t framesLost = 0;
+    /// @brief frames found which were never sent, eg. a random checksum match
+    uint64_t falseFrames = 0;
+    /// @brief bytes of the corrupted stream
+    uint64_t bytes = 0;
+    /// @brief decode time of the stream
+    double seconds = 0;
+    /// @brief counters of the decoder
+    uint64_t resyncs = 0;
+    uint64_t skippedBytes = 0;
+    /// @brief bytes from the start of a damaged frame to the start of the next recovered frame
+    HistogramSnapshot resyncBytes;
+
+    /// @brief decoded megabytes per second
+    double throughputMBps() const;
+
+    /// @brief clean frames recovered to clean frames sent
+    double cleanRecovery() const;
+
+    /**
+     * @brief Time to resync on a serial line, 99th percentile
+     *
+     * @param baudRate baud rate of the line
+     * @return double time in microseconds
+     */
+    double resyncUsP99(const uint32_t baudRate) const;
+
+    /**
+     * @brief Check the result against the thresholds
+     *
+     * @param thresholds minimum quality
+     * @return std::vector<std::string> description of each violated threshold, empty if all hold
+     */
+    std::vector<std::string> violations(const StressThresholds &thresholds) const;
+};
+
+
+/**
+ * @brief Stress harness of the stream decoder
+ *
+ * Builds a stream of random but well-formed frames, corrupts it with a NoiseInjector and
+ * runs it through FrameReassembler in chunks. The decoded frames are matched against the
+ * frames sent, so every recovered, lost and false frame is accounted for.
+ */
+class StressHarness
+{
+private:
+    NoiseProfile _profile;
+    size_t _chunkSize;
+
+public:
+    /**
+     * @brief Construct a new Stress Harness object
+     *
+     * @param profile noise to inject
+     * @param chunkSize number of bytes handed to the decoder at once, like one read of a serial port
+     */
+    StressHarness(const NoiseProfile &profile, const size_t chunkSize = 64);
+    ~StressHarness();
+
+    /**
+     * @brief Run the decoder over a corrupted stream of frames
+     *
+     * @param frames number of frames to send
+     * @return StressResult counters, throughput and resync distances
+     */
+    StressResult run(const size_t frames);
+};
+
+
+} // namespace Xerxes
+
+#endif // !__STRESS_HPP
@@ -0,0 +1,188 @@
+#include "Topology.hpp"
+#include "Clock.hpp"
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+namespace Xerxes
+{
+
+
+BusTopology::BusTopology(Master &master, const uint8_t busId, const uint8_t lostAfter) :
+    _master(master), _busId(busId), _lostAfter(lostAfter)
+{
+    for(size_t address = 0; address < BUS_ADDRESSES; address++)
+    {
+        _leaves[address] = Leaf((address_t)address, &master);
+    }
+    _lastPv.fill(NAN);
+    _addresses.reserve(BUS_ADDRESSES);
+}
+
+
+BusTopology::~BusTopology()
+{
+}
+
+
+uint8_t BusTopology::busId() const
+{
+    return _busId;
+}
+
+
+void BusTopology::add(const address_t address, const devid_t deviceId, const uint32_t timeoutUs)
+{
+    if(address == BROADCAST_ADDRESS)
+    {
+        throw std::invalid_argument("Broadcast address can not hold a leaf.");
+    }
+
+    _deviceId[address] = deviceId;
+    _timeoutUs[address] = timeoutUs;
+    if(_present[address])
+    {
+        return;
+    }
+
+    _present[address] = 1;
+    _failures[address] = 0;
+    _lastSeenNs[address] = 0;
+    std::fill_n(_lastPv.begin() + address * PV_COUNT, PV_COUNT, NAN);
+    _addresses.insert(std::upper_bound(_addresses.begin(), _addresses.end(), address), address);
+}
+
+
+void BusTopology::remove(const address_t address)
+{
+    if(!_present[address])
+    {
+        return;
+    }
+    _present[address] = 0;
+    _addresses.erase(std::lower_bound(_addresses.begin(), _addresses.end(), address));
+}
+
+
+size_t BusTopology::discover(const address_t first, const address_t last)
+{
+    size_t found = 0;
+    for(size_t address = first; address <= last && address < BROADCAST_ADDRESS; address++)
+    {
+        const Result<ping_reply_t> reply = _master.tryPing((address_t)address);
+        if(!reply)
+        {
+            // nobody at this address
+            continue;
+        }
+        add((address_t)address, reply->device_id, _timeoutUs[address]);
+        recordSuccess((address_t)address, steadyNowNs());
+        found++;
+    }
+    return found;
+}
+
+
+bool BusTopology::contains(const address_t address) const
+{
+    return _present[address];
+}
+
+
+Leaf &BusTopology::leaf(const address_t address)
+{
+    return _leaves[address];
+}
+
+
+const std::vector<address_t> &BusTopology::addresses() const
+{
+    return _addresses;
+}
+
+
+size_t BusTopology::size() const
+{
+    return _addresses.size();
+}
+
+
+devid_t BusTopology::deviceId(const address_t address) const
+{
+    return _deviceId[address];
+}
+
+
+uint32_t BusTopology::timeoutUs(const address_t address) const
+{
+    return _timeoutUs[address];
+}
+
+
+LeafHealth BusTopology::health(const address_t address) const
+{
+    if(!_present[address])
+    {
+        return HEALTH_ABSENT;
+    }
+    else if(_failures[address] == 0)
+    {
+        return HEALTH_OK;
+    }
+    else if(_failures[address] < _lostAfter)
+    {
+        return HEALTH_DEGRADED;
+    }
+    return HEALTH_LOST;
+}
+
+
+int64_t BusTopology::lastSeenNs(const address_t address) const
+{
+    return _lastSeenNs[address];
+}
+
+
+const float *BusTopology::lastValues(const address_t address) const
+{
+    return &_lastPv[address * PV_COUNT];
+}
+
+
+void BusTopology::recordSuccess(const address_t address, const int64_t timestampNs)
+{
+    _failures[address] = 0;
+    _lastSeenNs[address] = timestampNs;
+}
+
+
+void BusTopology::recordFailure(const address_t address)
+{
+    // saturate instead of wrapping back to healthy
+    _failures[address] += _failures[address] < UINT8_MAX;
+}
+
+
+size_t BusTopology::poll()
+{
+    using Span = RegisterSpan<Registers::PV0, Registers::PV1, Registers::PV2, Registers::PV3>;
+    static_assert(Span::size == PV_COUNT * sizeof(float), "PV0..PV3 must be contiguous");
+
+    size_t replied = 0;
+    for(const address_t address : _addresses)
+    {
+        float *values = &_lastPv[address * PV_COUNT];
+        if(!_master.tryReadMemory(address, Span::offset, Span::size, (uint8_t *)values, _timeoutUs[address]))
+        {
+            std::fill_n(values, PV_COUNT, NAN);
+            recordFailure(address);
+            continue;
+        }
+        recordSuccess(address, steadyNowNs());
+        replied++;
+    }
+    return replied;
+}
+
+
+} // namespace Xerxes
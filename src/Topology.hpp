@@ -0,0 +1,140 @@
+#ifndef __TOPOLOGY_HPP
+#define __TOPOLOGY_HPP
+
+#include <array>
+#include <vector>
+#include <cstdint>
+#include <stddef.h>
+#include "Leaf.hpp"
+#include "DeviceIds.h"
+#include "Statistics.hpp"
+
+namespace Xerxes
+{
+
+
+/// @brief Number of addresses of a bus, BROADCAST_ADDRESS included
+constexpr size_t BUS_ADDRESSES = 256;
+
+
+/**
+ * @brief Health of a leaf derived from its consecutive failures
+ *
+ */
+enum LeafHealth : uint8_t
+{
+    /// @brief no leaf at the address
+    HEALTH_ABSENT = 0,
+    /// @brief last transaction succeeded
+    HEALTH_OK,
+    /// @brief some consecutive transactions failed
+    HEALTH_DEGRADED,
+    /// @brief too many consecutive transactions failed
+    HEALTH_LOST
+};
+
+
+/**
+ * @brief Leaves of one bus, indexed by their address
+ *
+ * The leaves live in a flat array of BUS_ADDRESSES entries and their metadata in
+ * parallel arrays of the same size, so a lookup is a single index and a poll cycle walks
+ * contiguous memory. A sorted list of the present addresses drives the iteration.
+ * Large installations keep one BusTopology per bus, eg. in a std::vector.
+ */
+class BusTopology
+{
+private:
+    Master &_master;
+    uint8_t _busId;
+    uint8_t _lostAfter;
+
+    std::array<Leaf, BUS_ADDRESSES> _leaves;
+    std::array<uint8_t, BUS_ADDRESSES> _present {};
+    std::array<devid_t, BUS_ADDRESSES> _deviceId {};
+    /// @brief timeout of one attempt in microseconds, 0 for the timeout of the master
+    std::array<uint32_t, BUS_ADDRESSES> _timeoutUs {};
+    /// @brief number of consecutive failed transactions
+    std::array<uint8_t, BUS_ADDRESSES> _failures {};
+    /// @brief steady clock time of the last successful transaction in nanoseconds
+    std::array<int64_t, BUS_ADDRESSES> _lastSeenNs {};
+    /// @brief PV0..PV3 of the last poll, PV_COUNT values per address
+    std::array<float, BUS_ADDRESSES * PV_COUNT> _lastPv {};
+
+    /// @brief sorted addresses of the present leaves
+    std::vector<address_t> _addresses;
+
+public:
+    /**
+     * @brief Construct a new Bus Topology object with no leaves
+     *
+     * @param master master of the bus
+     * @param busId identification of the bus
+     * @param lostAfter number of consecutive failures after which a leaf is lost
+     */
+    BusTopology(Master &master, const uint8_t busId = 0, const uint8_t lostAfter = 3);
+    ~BusTopology();
+
+    uint8_t busId() const;
+
+    /**
+     * @brief Add a leaf to the bus, an existing leaf is updated
+     *
+     * @param address address of the leaf, not BROADCAST_ADDRESS
+     * @param deviceId device id of the leaf
+     * @param timeoutUs timeout of one attempt in microseconds, 0 for the timeout of the master
+     * @throw std::invalid_argument for the broadcast address
+     */
+    void add(const address_t address, const devid_t deviceId, const uint32_t timeoutUs = 0);
+
+    /// @brief Remove a leaf from the bus
+    void remove(const address_t address);
+
+    /**
+     * @brief Ping the addresses of a range and add every leaf which replies
+     *
+     * @param first first address to ping
+     * @param last last address to ping, included
+     * @return size_t number of leaves found
+     */
+    size_t discover(const address_t first = 0, const address_t last = BROADCAST_ADDRESS - 1);
+
+    bool contains(const address_t address) const;
+
+    /// @brief Leaf at the address, usable only if contains(address)
+    Leaf &leaf(const address_t address);
+
+    /// @brief Sorted addresses of the present leaves
+    const std::vector<address_t> &addresses() const;
+
+    /// @brief Number of present leaves
+    size_t size() const;
+
+    devid_t deviceId(const address_t address) const;
+    uint32_t timeoutUs(const address_t address) const;
+    LeafHealth health(const address_t address) const;
+    int64_t lastSeenNs(const address_t address) const;
+
+    /// @brief PV0..PV3 of the last poll of the leaf, NaN if the poll failed
+    const float *lastValues(const address_t address) const;
+
+    /// @brief Record a successful transaction with the leaf
+    void recordSuccess(const address_t address, const int64_t timestampNs);
+
+    /// @brief Record a failed transaction with the leaf
+    void recordFailure(const address_t address);
+
+    /**
+     * @brief Read PV0..PV3 of every present leaf into the last values
+     *
+     * Lost leaves are polled too, so they are found again once they recover.
+     *
+     * @return size_t number of leaves which replied
+     */
+    size_t poll();
+};
+
+
+} // namespace Xerxes
+
+#endif // !__TOPOLOGY_HPP
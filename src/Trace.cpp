@@ -0,0 +1,179 @@
+#include "Trace.hpp"
+#include "Clock.hpp"
+#include <bit>
+#include <cstring>
+#include <fstream>
+
+namespace Xerxes
+{
+
+
+FrameTrace::FrameTrace(const size_t capacity, const uint8_t busId) :
+    _slots(std::bit_ceil(capacity ? capacity : 1)), _mask(_slots.size() - 1), _busId(busId)
+{
+}
+
+
+FrameTrace::~FrameTrace()
+{
+}
+
+
+void FrameTrace::record(const TraceDirection direction, const uint8_t *frame, const size_t length, const int64_t timestampNs)
+{
+    const uint64_t timestamp = timestampNs != 0 ? timestampNs : steadyNowNs();
+
+    const uint64_t index = _head.load(std::memory_order_relaxed);
+    Slot &slot = _slots[index & _mask];
+
+    slot.seq.store(0, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    slot.timestampNs = timestamp;
+    slot.direction = direction;
+    slot.length = length < MAX_FRAME_SIZE ? length : MAX_FRAME_SIZE;
+    memcpy(slot.frame, frame, slot.length);
+
+    slot.seq.store(index + 1, std::memory_order_release);
+    _head.store(index + 1, std::memory_order_release);
+}
+
+
+uint64_t FrameTrace::recorded() const
+{
+    return _head.load(std::memory_order_acquire);
+}
+
+
+size_t FrameTrace::capacity() const
+{
+    return _slots.size();
+}
+
+
+void FrameTrace::clear()
+{
+    for(auto &slot : _slots)
+    {
+        slot.seq.store(0, std::memory_order_relaxed);
+    }
+    _head.store(0, std::memory_order_release);
+}
+
+
+static void putLe(std::vector<uint8_t> &out, const uint64_t value, const size_t bytes)
+{
+    for(size_t i = 0; i < bytes; i++)
+    {
+        out.push_back((uint8_t)(value >> (8 * i)));
+    }
+}
+
+
+static uint64_t getLe(const uint8_t *in, const size_t bytes)
+{
+    uint64_t value = 0;
+    for(size_t i = 0; i < bytes; i++)
+    {
+        value |= (uint64_t)in[i] << (8 * i);
+    }
+    return value;
+}
+
+
+bool FrameTrace::flush(const std::string &path) const
+{
+    const uint64_t head = recorded();
+    const uint64_t first = head > _slots.size() ? head - _slots.size() : 0;
+
+    std::vector<uint8_t> records;
+    records.reserve((head - first) * 32);
+    uint32_t count = 0;
+
+    Slot copy;
+    for(uint64_t index = first; index < head; index++)
+    {
+        const Slot &slot = _slots[index & _mask];
+
+        // seqlock read, skip the slot if the writer touched it meanwhile
+        const uint64_t seq = slot.seq.load(std::memory_order_acquire);
+        copy.timestampNs = slot.timestampNs;
+        copy.direction = slot.direction;
+        copy.length = slot.length;
+        memcpy(copy.frame, slot.frame, copy.length);
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if(seq != index + 1 || slot.seq.load(std::memory_order_relaxed) != seq)
+        {
+            continue;
+        }
+
+        putLe(records, copy.timestampNs, 8);
+        records.push_back(copy.direction);
+        records.push_back(copy.length);
+        records.insert(records.end(), copy.frame, copy.frame + copy.length);
+        count++;
+    }
+
+    std::vector<uint8_t> header(TRACE_FILE_MAGIC, TRACE_FILE_MAGIC + sizeof(TRACE_FILE_MAGIC));
+    header.push_back(TRACE_FILE_VERSION);
+    header.push_back(_busId);
+    putLe(header, 0, 2);
+    putLe(header, count, 4);
+
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    file.write((const char *)header.data(), header.size());
+    file.write((const char *)records.data(), records.size());
+    return (bool)file;
+}
+
+
+bool FrameTrace::read(const std::string &path, std::vector<TraceEntry> &entries, uint8_t &busId)
+{
+    std::ifstream file(path, std::ios::binary);
+    if(!file)
+    {
+        return false;
+    }
+
+    std::vector<uint8_t> data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    if(data.size() < 12 || memcmp(data.data(), TRACE_FILE_MAGIC, sizeof(TRACE_FILE_MAGIC)) != 0)
+    {
+        return false;
+    }
+    if(data[4] != TRACE_FILE_VERSION)
+    {
+        return false;
+    }
+
+    busId = data[5];
+    const uint32_t count = getLe(&data[8], 4);
+
+    size_t pos = 12;
+    for(uint32_t i = 0; i < count; i++)
+    {
+        if(pos + 10 > data.size())
+        {
+            return false;
+        }
+
+        TraceEntry entry;
+        entry.timestampNs = getLe(&data[pos], 8);
+        entry.direction = (TraceDirection)data[pos + 8];
+        const uint8_t length = data[pos + 9];
+        pos += 10;
+
+        if(pos + length > data.size())
+        {
+            return false;
+        }
+        entry.frame.assign(data.begin() + pos, data.begin() + pos + length);
+        pos += length;
+
+        entries.push_back(std::move(entry));
+    }
+
+    return true;
+}
+
+
+} // namespace Xerxes
@@ -0,0 +1,138 @@
+#ifndef __TRACE_HPP
+#define __TRACE_HPP
+
+#include <atomic>
+#include <vector>
+#include <string>
+#include <cstdint>
+#include <stddef.h>
+
+namespace Xerxes
+{
+
+
+/// @brief Maximal size of a xerxes frame, the LEN field is one byte
+constexpr size_t MAX_FRAME_SIZE = 255;
+
+/// @brief Magic bytes at the beginning of a trace file
+constexpr char TRACE_FILE_MAGIC[4] = {'X', 'T', 'R', 'C'};
+
+/// @brief Version of the trace file format
+constexpr uint8_t TRACE_FILE_VERSION = 1;
+
+
+/**
+ * @brief Direction of a traced frame
+ *
+ */
+enum TraceDirection : uint8_t
+{
+    /// @brief frame sent by this host
+    TRACE_TX = 0,
+    /// @brief valid frame received
+    TRACE_RX,
+    /// @brief frame received with a bad checksum or length
+    TRACE_RX_CORRUPTED
+};
+
+
+/**
+ * @brief One traced frame as decoded from a trace file
+ *
+ */
+struct TraceEntry
+{
+    /// @brief steady_clock timestamp in nanoseconds
+    uint64_t timestampNs;
+    TraceDirection direction;
+    /// @brief raw bytes SOH..CHECKSUM
+    std::vector<uint8_t> frame;
+};
+
+
+/**
+ * @brief Always-on trace of the frames on one bus
+ *
+ * Frames are copied into a preallocated ring, the oldest are overwritten when the ring
+ * is full. Recording takes a timestamp and a memcpy of the frame, nothing is allocated
+ * or formatted. The ring has a single writer (the bus thread); flush() may run on any
+ * thread and skips slots being overwritten at that moment.
+ *
+ * The trace file is little endian:
+ * header:  "XTRC" | VERSION u8 | BUS_ID u8 | RESERVED u16 | COUNT u32
+ * record:  TIMESTAMP_NS u64 | DIRECTION u8 | LEN u8 | FRAME[LEN]
+ */
+class FrameTrace
+{
+private:
+    struct Slot
+    {
+        /// @brief sequence number of the record + 1, 0 while the slot is written
+        std::atomic<uint64_t> seq {0};
+        uint64_t timestampNs;
+        uint8_t direction;
+        uint8_t length;
+        uint8_t frame[MAX_FRAME_SIZE];
+    };
+
+    std::vector<Slot> _slots;
+    /// @brief capacity - 1, the capacity is a power of two
+    size_t _mask;
+    /// @brief number of records written so far
+    std::atomic<uint64_t> _head {0};
+    uint8_t _busId;
+
+public:
+    /**
+     * @brief Construct a new Frame Trace object
+     *
+     * @param capacity number of frames kept in the ring, rounded up to a power of two
+     * @param busId identifier of the bus written into the trace file
+     */
+    FrameTrace(const size_t capacity, const uint8_t busId = 0);
+    ~FrameTrace();
+
+    /**
+     * @brief Record a frame, only the bus thread may call this
+     *
+     * @param direction direction of the frame
+     * @param frame raw bytes of the frame
+     * @param length number of bytes, frames longer than MAX_FRAME_SIZE are truncated
+     * @param timestampNs steady clock time of the frame in nanoseconds, 0 to take the current time
+     */
+    void record(const TraceDirection direction, const uint8_t *frame, const size_t length, const int64_t timestampNs = 0);
+
+    /// @brief Number of frames recorded since construction or clear()
+    uint64_t recorded() const;
+
+    /// @brief Capacity of the ring in frames
+    size_t capacity() const;
+
+    /// @brief Forget all recorded frames, only the bus thread may call this
+    void clear();
+
+    /**
+     * @brief Write the frames currently in the ring into a binary trace file, oldest first
+     *
+     * @param path destination file
+     * @return true if the file was written
+     * @return false on I/O error
+     */
+    bool flush(const std::string &path) const;
+
+    /**
+     * @brief Read a trace file written by flush()
+     *
+     * @param path trace file
+     * @param entries decoded frames are appended here
+     * @param busId bus identifier stored in the file
+     * @return true if the whole file was decoded
+     * @return false if the file is missing, not a trace or truncated
+     */
+    static bool read(const std::string &path, std::vector<TraceEntry> &entries, uint8_t &busId);
+};
+
+
+} // namespace Xerxes
+
+#endif // !__TRACE_HPP
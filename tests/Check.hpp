@@ -0,0 +1,20 @@
+#ifndef __CHECK_HPP
+#define __CHECK_HPP
+
+#include <cstdio>
+#include <cstdlib>
+
+
+/// @brief Fail the test with the failed condition and its location
+#define CHECK(condition) \
+    do \
+    { \
+        if(!(condition)) \
+        { \
+            fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #condition); \
+            exit(1); \
+        } \
+    } while(0)
+
+
+#endif // !__CHECK_HPP
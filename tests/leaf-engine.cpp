@@ -0,0 +1,96 @@
+#include "Check.hpp"
+#include "LeafEngine.hpp"
+#include "Message.hpp"
+#include "MessageId.h"
+#include "MemoryMap.h"
+#include <cstring>
+#include <vector>
+
+using namespace Xerxes;
+
+
+constexpr uint8_t MASTER_ADDRESS = 0xfe;
+constexpr uint8_t LEAF_ADDRESS = 1;
+
+
+/// @brief serve a checksum-valid request and return the message id of the reply, 0 for none
+static msgid_t serve(LeafEngine &leaf, const msgid_t msgId, const std::vector<uint8_t> &payload)
+{
+    const Packet packet = Message(MASTER_ADDRESS, LEAF_ADDRESS, msgId, payload).toPacket();
+    uint8_t reply[MAX_FRAME_SIZE];
+    const size_t length = leaf.handle(packet.data(), packet.size(), reply);
+    if(length == 0)
+    {
+        return 0;
+    }
+    CHECK(length >= 7 && reply[1] == length);
+    return reply[4] | reply[5] << 8;
+}
+
+
+/// @brief offsets whose end wraps around 16 bits are refused, not written past the register file
+static void wrappingWrite(LeafEngine &leaf)
+{
+    CHECK(serve(leaf, MSGID_WRITE, {0xff, 0xff, 0x55}) == MSGID_ACK_NOK);
+
+    std::vector<uint8_t> payload = {0xf0, 0xff};
+    payload.resize(2 + 32, 0x55);
+    CHECK(serve(leaf, MSGID_WRITE, payload) == MSGID_ACK_NOK);
+}
+
+
+/// @brief writes reaching into the read-only range are refused, the volatile range is kept
+static void writePastVolatile(LeafEngine &leaf)
+{
+    const uint16_t offset = READ_ONLY_OFFSET - 1;
+    uint8_t before[2];
+    memcpy(before, leaf.registers() + offset, sizeof(before));
+
+    CHECK(serve(leaf, MSGID_WRITE, {(uint8_t)(offset & 0xff), (uint8_t)(offset >> 8), 0x55, 0x55}) == MSGID_ACK_NOK);
+    CHECK(memcmp(before, leaf.registers() + offset, sizeof(before)) == 0);
+
+    CHECK(serve(leaf, MSGID_WRITE, {(uint8_t)(offset & 0xff), (uint8_t)(offset >> 8), 0x55}) == MSGID_ACK_OK);
+    CHECK(leaf.registers()[offset] == 0x55);
+}
+
+
+/// @brief requests with a payload of the wrong shape or reaching past the register file
+static void malformedReads(LeafEngine &leaf)
+{
+    CHECK(serve(leaf, MSGID_WRITE, {0x00}) == MSGID_ACK_NOK);
+    CHECK(serve(leaf, MSGID_READ, {0x00, 0x01}) == MSGID_ACK_NOK);
+    CHECK(serve(leaf, MSGID_READ, {0xff, 0xff, 0x01}) == MSGID_ACK_NOK);
+    CHECK(serve(leaf, MSGID_READ_MULTI, {0x00, 0x01, 0x04, 0xff, 0xff, 0x01}) == MSGID_ACK_NOK);
+    CHECK(serve(leaf, MSGID_READ_MULTI, {0x00, 0x01}) == MSGID_ACK_NOK);
+}
+
+
+/// @brief frames with a bad checksum or length are not served
+static void corruptedFrames(LeafEngine &leaf)
+{
+    const Packet packet = Message(MASTER_ADDRESS, LEAF_ADDRESS, MSGID_WRITE, {0x00, 0x01, 0x55}).toPacket();
+    std::vector<uint8_t> frame(packet.data(), packet.data() + packet.size());
+    uint8_t reply[MAX_FRAME_SIZE];
+
+    std::vector<uint8_t> checksum = frame;
+    checksum.back() ^= 0xff;
+    CHECK(leaf.handle(checksum.data(), checksum.size(), reply) == 0);
+
+    std::vector<uint8_t> length = frame;
+    length[1]++;
+    CHECK(leaf.handle(length.data(), length.size(), reply) == 0);
+
+    CHECK(leaf.handle(frame.data(), 5, reply) == 0);
+}
+
+
+int main()
+{
+    LeafEngine leaf(LEAF_ADDRESS, 0);
+
+    wrappingWrite(leaf);
+    writePastVolatile(leaf);
+    malformedReads(leaf);
+    corruptedFrames(leaf);
+    return 0;
+}
@@ -0,0 +1,152 @@
+#include "Check.hpp"
+#include "Master.hpp"
+#include "Registers.hpp"
+#include "SimulatedBus.hpp"
+#include <chrono>
+#include <cstring>
+
+using namespace Xerxes;
+
+
+constexpr address_t MASTER_ADDRESS = 0xfe;
+constexpr address_t LEAF_ADDRESS = 1;
+constexpr uint32_t TIMEOUT_US = 20000;
+
+
+/**
+ * @brief Bus which loses the next request on the wire, the leaf never sees it
+ *
+ */
+class LossyBus : public Network
+{
+private:
+    Network &_inner;
+    mutable bool _dropNext = false;
+
+public:
+    mutable uint32_t sent = 0;
+
+    LossyBus(Network &inner) : _inner(inner) {}
+
+    void dropNext()
+    {
+        _dropNext = true;
+    }
+
+    bool sendData(const Packet &toSend) const override
+    {
+        sent++;
+        if(_dropNext)
+        {
+            _dropNext = false;
+            return true;
+        }
+        return _inner.sendData(toSend);
+    }
+
+    bool readData(const uint64_t timeoutUs, Packet &packet) override
+    {
+        return _inner.readData(timeoutUs, packet);
+    }
+};
+
+
+static uint64_t elapsedUs(const std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+}
+
+/// @brief a lost READ is retried, the next read takes its own reply once the lost one is waited for
+/// @brief a lost READ is retried, the next identical reply is not taken for its late duplicate
+static void unchangedValueAfterLostRead(SimulatedBus &bus)
+{
+    LossyBus lossy(bus);
+    Protocol protocol(&lossy);
+    Master master(&protocol, MASTER_ADDRESS, TIMEOUT_US);
+    master.setRetryPolicy(OP_READ, {3, 0, 0, true});
+
+    lossy.dropNext();
+    Result<uint32_t> first = master.tryReadValue<uint32_t>(LEAF_ADDRESS, PV0_OFFSET);
+    CHECK(first.has_value());
+    CHECK(lossy.sent == 2);
+
+    // the value did not change, so the reply equals the one accepted after the retry
+    const auto start = std::chrono::steady_clock::now();
+    Result<uint32_t> second = master.tryReadValue<uint32_t>(LEAF_ADDRESS, PV0_OFFSET);
+    CHECK(second.has_value());
+    CHECK(*second == *first);
+    CHECK(lossy.sent == 3);
+    // the reply of the lost attempt is waited for until two timeouts after the retry
+    CHECK(elapsedUs(start) < 3 * TIMEOUT_US);
+}
+
+
+/// @brief a lost idempotent WRITE is retried, the ACK_OK of a following write is not dropped
+static void writeAfterLostIdempotentWrite(SimulatedBus &bus, LeafEngine &leaf)
+{
+    LossyBus lossy(bus);
+    Protocol protocol(&lossy);
+    Master master(&protocol, MASTER_ADDRESS, TIMEOUT_US);
+    master.setRetryPolicy(OP_WRITE, {2, 0, 0, true});
+
+    lossy.dropNext();
+    CHECK(master.tryWriteValue<float>(LEAF_ADDRESS, PV1_OFFSET, 1.0f).has_value());
+    CHECK(lossy.sent == 2);
+
+    master.setRetryPolicy(OP_WRITE, {1, 0, 0, false});
+    Result<void> written = master.tryWriteValue<float>(LEAF_ADDRESS, PV1_OFFSET, 2.0f);
+    CHECK(written.has_value());
+
+    float value;
+    memcpy(&value, leaf.registers() + PV1_OFFSET, sizeof(value));
+    CHECK(value == 2.0f);
+}
+
+
+/// @brief a leaf slower than the timeout answers every attempt, the late replies are not
+/// taken for the replies to the next requests
+static void slowLeafAnswersLate()
+{
+    SimulatedBus bus;
+    bus.setTurnaroundUs(TIMEOUT_US * 3 / 2);
+    LeafEngine leaf(LEAF_ADDRESS, DEVID_WELDER);
+    bus.attach(leaf);
+    const float pv0 = 111.0f;
+    const float pv1 = 222.0f;
+    memcpy(leaf.registers() + PV0_OFFSET, &pv0, sizeof(pv0));
+    memcpy(leaf.registers() + PV1_OFFSET, &pv1, sizeof(pv1));
+
+    Protocol protocol(&bus);
+    Master master(&protocol, MASTER_ADDRESS, TIMEOUT_US);
+
+    // the first attempt times out, the retry takes its reply, the reply of the retry is late
+    master.setRetryPolicy(OP_READ, {2, 0, 0, true});
+    Result<float> first = master.tryReadValue<float>(LEAF_ADDRESS, PV0_OFFSET);
+    CHECK(first.has_value());
+    CHECK(*first == pv0);
+
+    Result<float> second = master.tryReadValue<float>(LEAF_ADDRESS, PV1_OFFSET);
+    CHECK(second.has_value());
+    CHECK(*second == pv1);
+
+    // a failed read leaves its reply on the way too
+    master.setRetryPolicy(OP_READ, {1, 0, 0, true});
+    CHECK(!master.tryReadValue<float>(LEAF_ADDRESS, PV0_OFFSET).has_value());
+    master.setRetryPolicy(OP_READ, {2, 0, 0, true});
+    Result<float> third = master.tryReadValue<float>(LEAF_ADDRESS, PV1_OFFSET);
+    CHECK(third.has_value());
+    CHECK(*third == pv1);
+}
+
+
+int main()
+{
+    SimulatedBus bus;
+    LeafEngine leaf(LEAF_ADDRESS, DEVID_WELDER);
+    bus.attach(leaf);
+
+    unchangedValueAfterLostRead(bus);
+    writeAfterLostIdempotentWrite(bus, leaf);
+    slowLeafAnswersLate();
+    return 0;
+}
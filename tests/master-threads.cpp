@@ -0,0 +1,195 @@
+#include "Check.hpp"
+#include "Master.hpp"
+#include "Registers.hpp"
+#include "SimulatedBus.hpp"
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <memory>
+#include <thread>
+#include <vector>
+
+using namespace Xerxes;
+
+
+constexpr address_t MASTER_ADDRESS = 0xfe;
+constexpr uint32_t THREADS = 8;
+constexpr uint32_t LEAVES = 16;
+constexpr uint32_t READS = 50;
+constexpr uint32_t TIMEOUT_US = 2000;
+/// @brief leaf whose replies arrive corrupted
+constexpr address_t NOISY_ADDRESS = LEAVES + 1;
+/// @brief long enough for all the readers to finish during the backoff, even under a sanitizer
+constexpr uint32_t BACKOFF_US = 1000000;
+
+
+/**
+ * @brief Bus corrupting the replies of the noisy leaf, counts the requests sent to it
+ *
+ */
+class NoisyBus : public Network
+{
+private:
+    Network &_inner;
+
+public:
+    mutable std::atomic<uint32_t> noisyRequests = 0;
+    std::atomic<uint32_t> noisyReplies = 0;
+
+    NoisyBus(Network &inner) : _inner(inner) {}
+
+    bool sendData(const Packet &toSend) const override
+    {
+        // SOH, length, source, destination
+        if(toSend.size() > 3 && toSend.data()[3] == NOISY_ADDRESS)
+        {
+            noisyRequests++;
+        }
+        return _inner.sendData(toSend);
+    }
+
+    bool readData(const uint64_t timeoutUs, Packet &packet) override
+    {
+        if(!_inner.readData(timeoutUs, packet))
+        {
+            return false;
+        }
+        if(packet.size() > 2 && packet.data()[2] == NOISY_ADDRESS)
+        {
+            std::vector<uint8_t> data = packet.getData();
+            data.back() ^= 0xff;
+            packet.setData(data);
+            noisyReplies++;
+        }
+        return true;
+    }
+};
+
+
+/// @brief every leaf holds its own address in PV0, a reply delivered to the wrong caller shows up
+static void readersGetTheirOwnReplies(Master &master)
+{
+    std::atomic<uint32_t> mismatches = 0;
+    std::atomic<uint32_t> failures = 0;
+    std::atomic<bool> running = true;
+
+    // SYNCs are broadcast between the transactions of the readers
+    std::thread syncer([&]{
+        while(running)
+        {
+            master.sync();
+            std::this_thread::sleep_for(std::chrono::microseconds(200));
+        }
+    });
+
+    std::vector<std::thread> readers;
+    for(uint32_t t = 0; t < THREADS; t++)
+    {
+        readers.emplace_back([&, t]{
+            for(uint32_t i = 0; i < READS; i++)
+            {
+                const address_t leaf = 1 + (t + i * THREADS) % LEAVES;
+                Result<float> value = master.tryReadValue<float>(leaf, PV0_OFFSET);
+                if(!value)
+                {
+                    failures++;
+                }
+                else if(*value != (float)leaf)
+                {
+                    mismatches++;
+                }
+            }
+        });
+    }
+    for(std::thread &reader : readers)
+    {
+        reader.join();
+    }
+    running = false;
+    syncer.join();
+
+    CHECK(failures == 0);
+    CHECK(mismatches == 0);
+}
+
+
+/// @brief while one thread backs off after a corrupted reply, the others keep using the bus
+static void backoffReleasesTheBus(Master &master, NoisyBus &noisy)
+{
+    master.setRetryPolicy(OP_PING, {2, BACKOFF_US, 0, true});
+
+    std::thread retrying([&]{
+        CHECK(!master.tryPing(NOISY_ADDRESS).has_value());
+    });
+
+    // the first attempt got its corrupted reply, the retry is due after the backoff
+    while(noisy.noisyReplies == 0)
+    {
+        std::this_thread::yield();
+    }
+    readersGetTheirOwnReplies(master);
+    CHECK(noisy.noisyRequests == 1);
+
+    retrying.join();
+    CHECK(noisy.noisyRequests == 2);
+}
+
+
+/// @brief two threads read different registers of a leaf slower than the timeout, the reply
+/// to a timed out attempt of one thread is never handed to the other one
+static void slowLeafSharedByThreads(Master &master)
+{
+    master.setRetryPolicy(OP_READ, {3, TIMEOUT_US / 2, 0, true});
+
+    std::atomic<uint32_t> mismatches = 0;
+    std::atomic<uint32_t> failures = 0;
+    auto reader = [&](const uint16_t offset, const float expected) {
+        for(uint32_t i = 0; i < READS / 5; i++)
+        {
+            Result<float> value = master.tryReadValue<float>(1, offset);
+            if(!value)
+            {
+                failures++;
+            }
+            else if(*value != expected)
+            {
+                mismatches++;
+            }
+        }
+    };
+
+    std::thread pv0(reader, PV0_OFFSET, 1.0f);
+    std::thread pv1(reader, PV1_OFFSET, -1.0f);
+    pv0.join();
+    pv1.join();
+
+    CHECK(failures == 0);
+    CHECK(mismatches == 0);
+}
+
+
+int main()
+{
+    SimulatedBus bus;
+    std::vector<std::unique_ptr<LeafEngine>> leaves;
+    for(address_t address = 1; address <= LEAVES + 1; address++)
+    {
+        leaves.emplace_back(new LeafEngine(address, DEVID_WELDER));
+        const float value = address;
+        memcpy(leaves.back()->registers() + PV0_OFFSET, &value, sizeof(value));
+        const float negative = -value;
+        memcpy(leaves.back()->registers() + PV1_OFFSET, &negative, sizeof(negative));
+        bus.attach(*leaves.back());
+    }
+
+    NoisyBus noisy(bus);
+    Protocol protocol(&noisy);
+    Master master(&protocol, MASTER_ADDRESS, TIMEOUT_US);
+
+    readersGetTheirOwnReplies(master);
+    backoffReleasesTheBus(master, noisy);
+
+    bus.setTurnaroundUs(TIMEOUT_US * 3 / 2);
+    slowLeafSharedByThreads(master);
+    return 0;
+}
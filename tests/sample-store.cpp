@@ -0,0 +1,126 @@
+#include "Check.hpp"
+#include "SampleStore.hpp"
+#include <cstdlib>
+#include <fcntl.h>
+#include <stdexcept>
+#include <unistd.h>
+
+using namespace Xerxes;
+
+
+constexpr SeriesKey KEY = {0, 1, 0x40};
+constexpr uint32_t CAPACITY = 16;
+
+
+/// @brief write a segment of a few samples and return its path
+static std::string writeSegment(const std::string &dir, const std::string &name)
+{
+    const std::string path = dir + "/" + name;
+    std::unique_ptr<Segment> segment = Segment::create(path, KEY, CAPACITY);
+    for(int64_t i = 0; i < 4; i++)
+    {
+        CHECK(segment->append(i, (double)i));
+    }
+    return path;
+}
+
+
+/// @brief overwrite a part of the file in place
+static void patch(const std::string &path, const off_t offset, const void *data, const size_t size)
+{
+    int fd = ::open(path.c_str(), O_WRONLY);
+    CHECK(fd >= 0);
+    CHECK(pwrite(fd, data, size, offset) == (ssize_t)size);
+    close(fd);
+}
+
+
+/// @brief both create() and open() refuse the file
+static void rejected(const std::string &path)
+{
+    bool created = true;
+    try
+    {
+        Segment::create(path, KEY, CAPACITY);
+    }
+    catch(const std::runtime_error &)
+    {
+        created = false;
+    }
+    CHECK(!created);
+
+    bool opened = true;
+    try
+    {
+        Segment::open(path);
+    }
+    catch(const std::runtime_error &)
+    {
+        opened = false;
+    }
+    CHECK(!opened);
+}
+
+
+/// @brief a segment cut short, eg. by a crash or a full disk, is not mapped past its end
+static void truncatedSegment(const std::string &dir)
+{
+    const std::string path = writeSegment(dir, "truncated.seg");
+    CHECK(Segment::open(path)->size() == 4);
+
+    CHECK(truncate(path.c_str(), sizeof(SegmentHeader) + 8) == 0);
+    rejected(path);
+}
+
+
+/// @brief a count over the capacity would read samples past the columns
+static void countOverCapacity(const std::string &dir)
+{
+    const std::string path = writeSegment(dir, "count.seg");
+    const uint32_t count = CAPACITY + 1;
+    patch(path, offsetof(SegmentHeader, count), &count, sizeof(count));
+    rejected(path);
+}
+
+
+/// @brief a segment of another version is neither read nor continued
+static void otherVersion(const std::string &dir)
+{
+    const std::string path = writeSegment(dir, "version.seg");
+    const uint8_t version = SEGMENT_FILE_VERSION + 1;
+    patch(path, offsetof(SegmentHeader, version), &version, sizeof(version));
+    rejected(path);
+}
+
+
+/// @brief a writer of zero samples per segment would drop every sample
+static void zeroCapacity(const std::string &dir)
+{
+    bool constructed = true;
+    try
+    {
+        SeriesWriter writer(dir, KEY, 0);
+    }
+    catch(const std::invalid_argument &)
+    {
+        constructed = false;
+    }
+    CHECK(!constructed);
+    CHECK(SampleStore::segments(dir, KEY).empty());
+}
+
+
+int main()
+{
+    char name[] = "/tmp/xerxes-sample-store-XXXXXX";
+    CHECK(mkdtemp(name) != nullptr);
+    const std::string dir = name;
+
+    truncatedSegment(dir);
+    countOverCapacity(dir);
+    otherVersion(dir);
+    zeroCapacity(dir);
+
+    CHECK(system(("rm -rf " + dir).c_str()) == 0);
+    return 0;
+}
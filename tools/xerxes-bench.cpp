@@ -0,0 +1,195 @@
+#include "Benchmark.hpp"
+#include "SimulatedBus.hpp"
+#include "Realtime.hpp"
+#include "DeviceIds.h"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <vector>
+
+using namespace Xerxes;
+
+
+/// @brief address the benchmark sends from
+constexpr address_t BENCH_ADDRESS = 0xfe;
+
+
+static void usage(const char *name)
+{
+    fprintf(stderr,
+        "usage: %s [options]\n"
+        "  --leaves N        number of simulated leaves, addresses 1..N (default 4)\n"
+        "  --count N         requests per leaf and size (default 10000)\n"
+        "  --probe ping|read request to send (default ping)\n"
+        "  --size N          bytes per read (default 4)\n"
+        "  --sweep           sweep the read size up to the frame limit\n"
+        "  --turnaround US   simulated turnaround of the leaves in microseconds (default 0)\n"
+        "  --timeout US      reply timeout in microseconds (default 10000)\n"
+        "  --rt              run with SCHED_FIFO, locked and pre-faulted memory\n"
+        "  --priority N      SCHED_FIFO priority with --rt (default 80)\n"
+        "  --cpu N           pin the benchmark to the CPU with --rt\n"
+        "  --spin US         busy-poll for replies up to US before blocking (default 0)\n",
+        name
+    );
+}
+
+
+static void printHeader()
+{
+    printf("%-4s %-5s %4s %9s %9s %7s %6s %6s %11s %11s %10s %10s %10s %10s\n",
+        "leaf", "probe", "size", "sent", "received", "lost", "errors", "late",
+        "req/s", "bytes/s", "p50 us", "p99 us", "p999 us", "wake99 us");
+}
+
+
+static void printResult(const BenchmarkResult &result)
+{
+    printf("%-4u %-5s %4u %9lu %9lu %7lu %6lu %6lu %11.0f %11.0f %10.2f %10.2f %10.2f %10.2f\n",
+        result.address,
+        result.probe == PROBE_PING ? "ping" : "read",
+        result.readSize,
+        (unsigned long)result.sent,
+        (unsigned long)result.received,
+        (unsigned long)result.lost,
+        (unsigned long)result.errors,
+        (unsigned long)result.late,
+        result.requestsPerSecond(),
+        result.bytesPerSecond(),
+        result.rttNs.percentile(0.5) / 1e3,
+        result.rttNs.percentile(0.99) / 1e3,
+        result.rttNs.percentile(0.999) / 1e3,
+        result.wakeNs.percentile(0.99) / 1e3);
+}
+
+
+int main(int argc, char **argv)
+{
+    uint32_t leaves = 4;
+    uint32_t count = 10000;
+    BenchmarkProbe probe = PROBE_PING;
+    uint8_t size = 4;
+    bool sweep = false;
+    uint32_t turnaround_us = 0;
+    uint32_t timeout_us = 10000;
+    bool realtime = false;
+    RealtimeOptions rt_options;
+    uint32_t spin_us = 0;
+
+    for(int i = 1; i < argc; i++)
+    {
+        const bool has_value = i + 1 < argc;
+        if(!strcmp(argv[i], "--leaves") && has_value)
+        {
+            leaves = strtoul(argv[++i], nullptr, 0);
+        }
+        else if(!strcmp(argv[i], "--count") && has_value)
+        {
+            count = strtoul(argv[++i], nullptr, 0);
+        }
+        else if(!strcmp(argv[i], "--probe") && has_value)
+        {
+            probe = !strcmp(argv[++i], "read") ? PROBE_READ : PROBE_PING;
+        }
+        else if(!strcmp(argv[i], "--size") && has_value)
+        {
+            size = strtoul(argv[++i], nullptr, 0);
+        }
+        else if(!strcmp(argv[i], "--sweep"))
+        {
+            sweep = true;
+        }
+        else if(!strcmp(argv[i], "--turnaround") && has_value)
+        {
+            turnaround_us = strtoul(argv[++i], nullptr, 0);
+        }
+        else if(!strcmp(argv[i], "--timeout") && has_value)
+        {
+            timeout_us = strtoul(argv[++i], nullptr, 0);
+        }
+        else if(!strcmp(argv[i], "--rt"))
+        {
+            realtime = true;
+        }
+        else if(!strcmp(argv[i], "--priority") && has_value)
+        {
+            rt_options.priority = strtol(argv[++i], nullptr, 0);
+        }
+        else if(!strcmp(argv[i], "--cpu") && has_value)
+        {
+            rt_options.cpu = strtol(argv[++i], nullptr, 0);
+        }
+        else if(!strcmp(argv[i], "--spin") && has_value)
+        {
+            spin_us = strtoul(argv[++i], nullptr, 0);
+        }
+        else
+        {
+            usage(argv[0]);
+            return 2;
+        }
+    }
+
+    if(leaves < 1 || leaves >= BENCH_ADDRESS)
+    {
+        fprintf(stderr, "number of leaves out of range\n");
+        return 2;
+    }
+
+    SimulatedBus bus;
+    bus.setTurnaroundUs(turnaround_us);
+    std::vector<std::unique_ptr<LeafEngine>> engines;
+    for(uint32_t address = 1; address <= leaves; address++)
+    {
+        engines.emplace_back(new LeafEngine(address, DEVID_PRESSURE_600MBAR));
+        bus.attach(*engines.back());
+    }
+
+    BusyPollNetwork busy_poll(bus, spin_us);
+    Protocol protocol(spin_us > 0 ? (Network *)&busy_poll : &bus);
+
+    if(realtime)
+    {
+        // the simulated leaves reply from this thread too, so they run real-time as well
+        const RealtimeStatus status = enterRealtime(rt_options);
+        if(!status.scheduler || !status.memoryLocked || (rt_options.cpu >= 0 && !status.affinity))
+        {
+            fprintf(stderr, "real-time mode incomplete: scheduler %s, affinity %s, memory lock %s\n",
+                status.scheduler ? "ok" : "failed",
+                rt_options.cpu < 0 ? "unchanged" : status.affinity ? "ok" : "failed",
+                status.memoryLocked ? "ok" : "failed");
+        }
+    }
+    LatencyBenchmark benchmark(protocol, BENCH_ADDRESS, timeout_us);
+
+    printHeader();
+    try
+    {
+        for(uint32_t address = 1; address <= leaves; address++)
+        {
+            if(sweep)
+            {
+                for(const auto &result : benchmark.sweep(address, count))
+                {
+                    printResult(result);
+                }
+            }
+            else
+            {
+                printResult(benchmark.run(address, probe, count, size));
+            }
+        }
+    }
+    catch(const std::invalid_argument &e)
+    {
+        fprintf(stderr, "%s\n", e.what());
+        return 2;
+    }
+
+    if(spin_us > 0)
+    {
+        fprintf(stderr, "busy-poll: %lu replies caught spinning, %lu blocking reads\n",
+            (unsigned long)busy_poll.spinHits(), (unsigned long)busy_poll.blockingReads());
+    }
+    return 0;
+}
@@ -0,0 +1,92 @@
+#include "Stress.hpp"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+using namespace Xerxes;
+
+
+static void usage(const char *name)
+{
+    fprintf(stderr,
+        "usage: %s [options]\n"
+        "  --frames N          frames in the stream (default 1000000)\n"
+        "  --chunk N           bytes per decoder call (default 64)\n"
+        "  --bit-flip R        probability of a bit flip per byte (default 1e-4)\n"
+        "  --drop R            probability of a lost byte (default 1e-4)\n"
+        "  --soh R             probability of a spurious SOH per byte (default 1e-4)\n"
+        "  --truncate R        probability of a frame cut short (default 1e-3)\n"
+        "  --seed N            seed of the noise (default 1)\n"
+        "  --baud N            baud rate for the time to resync (default 115200)\n"
+        "  --min-mbps X        fail below this decoder throughput (default 0)\n"
+        "  --min-recovery X    fail below this recovery of clean frames (default 0.99)\n"
+        "  --max-resync N      fail above this p99 resync distance in bytes (default 510)\n"
+        "  --max-false X       fail above this ratio of false frames (default 0.001)\n",
+        name
+    );
+}
+
+
+int main(int argc, char **argv)
+{
+    size_t frames = 1000000;
+    size_t chunk = 64;
+    uint32_t baud = 115200;
+    NoiseProfile profile;
+    profile.bitFlipRate = 1e-4;
+    profile.dropRate = 1e-4;
+    profile.spuriousSohRate = 1e-4;
+    profile.truncateRate = 1e-3;
+    StressThresholds thresholds;
+
+    for(int i = 1; i < argc; i++)
+    {
+        if(i + 1 >= argc)
+        {
+            usage(argv[0]);
+            return 2;
+        }
+        const char *option = argv[i];
+        const char *value = argv[++i];
+        if(!strcmp(option, "--frames")) frames = strtoull(value, nullptr, 0);
+        else if(!strcmp(option, "--chunk")) chunk = strtoull(value, nullptr, 0);
+        else if(!strcmp(option, "--bit-flip")) profile.bitFlipRate = atof(value);
+        else if(!strcmp(option, "--drop")) profile.dropRate = atof(value);
+        else if(!strcmp(option, "--soh")) profile.spuriousSohRate = atof(value);
+        else if(!strcmp(option, "--truncate")) profile.truncateRate = atof(value);
+        else if(!strcmp(option, "--seed")) profile.seed = strtoull(value, nullptr, 0);
+        else if(!strcmp(option, "--baud")) baud = strtoul(value, nullptr, 0);
+        else if(!strcmp(option, "--min-mbps")) thresholds.minThroughputMBps = atof(value);
+        else if(!strcmp(option, "--min-recovery")) thresholds.minCleanRecovery = atof(value);
+        else if(!strcmp(option, "--max-resync")) thresholds.maxResyncBytesP99 = strtoull(value, nullptr, 0);
+        else if(!strcmp(option, "--max-false")) thresholds.maxFalseFrameRatio = atof(value);
+        else
+        {
+            usage(argv[0]);
+            return 2;
+        }
+    }
+
+    StressHarness harness(profile, chunk);
+    const StressResult result = harness.run(frames);
+
+    printf("frames sent      %lu\n", (unsigned long)result.framesSent);
+    printf("frames clean     %lu\n", (unsigned long)result.framesClean);
+    printf("recovered        %lu (clean %lu, %.4f%%)\n", (unsigned long)result.framesRecovered, (unsigned long)result.cleanRecovered, result.cleanRecovery() * 100);
+    printf("lost             %lu\n", (unsigned long)result.framesLost);
+    printf("false frames     %lu\n", (unsigned long)result.falseFrames);
+    printf("resyncs          %lu, %lu bytes skipped\n", (unsigned long)result.resyncs, (unsigned long)result.skippedBytes);
+    printf("resync distance  p50 %lu, p99 %lu, p999 %lu bytes\n",
+        (unsigned long)result.resyncBytes.percentile(0.5),
+        (unsigned long)result.resyncBytes.percentile(0.99),
+        (unsigned long)result.resyncBytes.percentile(0.999));
+    printf("time to resync   p99 %.0f us at %u baud\n", result.resyncUsP99(baud), baud);
+    printf("throughput       %.1f MB/s (%lu bytes in %.3f s)\n", result.throughputMBps(), (unsigned long)result.bytes, result.seconds);
+
+    const std::vector<std::string> failed = result.violations(thresholds);
+    for(const auto &violation : failed)
+    {
+        printf("FAIL: %s\n", violation.c_str());
+    }
+    return failed.empty() ? 0 : 1;
+}
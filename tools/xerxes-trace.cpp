@@ -0,0 +1,63 @@
+#include "Trace.hpp"
+#include "Message.hpp"
+#include <cstdio>
+
+using namespace Xerxes;
+
+
+static const char *directionName(const TraceDirection direction)
+{
+    switch(direction)
+    {
+        case TRACE_TX: return "TX";
+        case TRACE_RX: return "RX";
+        case TRACE_RX_CORRUPTED: return "RX!";
+        default: return "??";
+    }
+}
+
+
+int main(int argc, char **argv)
+{
+    if(argc != 2)
+    {
+        fprintf(stderr, "usage: %s <trace file>\n", argv[0]);
+        return 2;
+    }
+
+    std::vector<TraceEntry> entries;
+    uint8_t bus_id = 0;
+    if(!FrameTrace::read(argv[1], entries, bus_id))
+    {
+        fprintf(stderr, "%s: not a valid trace file\n", argv[1]);
+        return 1;
+    }
+
+    printf("# bus %u, %zu frames\n", bus_id, entries.size());
+
+    const uint64_t t0 = entries.empty() ? 0 : entries.front().timestampNs;
+    for(const auto &entry : entries)
+    {
+        const uint64_t t = entry.timestampNs - t0;
+        printf("%6lu.%09lu %-3s ", (unsigned long)(t / 1000000000), (unsigned long)(t % 1000000000), directionName(entry.direction));
+
+        // SOH | LEN | SRC | DST | MSGID_L | MSGID_H | PAYLOAD | CHECKSUM
+        if(entry.frame.size() >= 7)
+        {
+            const uint16_t msg_id = entry.frame[4] | (entry.frame[5] << 8);
+            printf("%02x -> %02x %-24s (0x%04x) ", entry.frame[2], entry.frame[3], msgIdName(msg_id), msg_id);
+        }
+        else
+        {
+            printf("%-47s ", "<short frame>");
+        }
+
+        for(size_t i = 0; i < entry.frame.size(); i++)
+        {
+            printf(i ? ":%02x" : "%02x", entry.frame[i]);
+        }
+        printf("\n");
+    }
+
+    return 0;
+}
@@ -2,18 +2,65 @@ set(PREFIX ${CMAKE_CURRENT_LIST_DIR}/src)
 set(xerxes-protocol_VERSION 1.4.0)
 
 set(xerxes-protocol_SOURCES
+${PREFIX}/Benchmark.cpp
+${PREFIX}/Bulk.cpp
+${PREFIX}/Calibration.cpp
+${PREFIX}/Capture.cpp
+${PREFIX}/ChangeFilter.cpp
+${PREFIX}/Clock.cpp
+${PREFIX}/Daemon.cpp
+${PREFIX}/Error.cpp
+${PREFIX}/Leaf.cpp
+${PREFIX}/LeafEngine.cpp
+${PREFIX}/Master.cpp
 ${PREFIX}/Message.cpp
+${PREFIX}/MessageQueue.cpp
+${PREFIX}/Metrics.cpp
 ${PREFIX}/Network.cpp
 ${PREFIX}/Packet.cpp
 ${PREFIX}/Protocol.cpp
+${PREFIX}/Realtime.cpp
+${PREFIX}/SampleStore.cpp
+${PREFIX}/SimulatedBus.cpp
+${PREFIX}/Snapshot.cpp
+${PREFIX}/Sniffer.cpp
+${PREFIX}/Statistics.cpp
+${PREFIX}/Stress.cpp
+${PREFIX}/Topology.cpp
+${PREFIX}/Trace.cpp
 )
 
 set(xerxes-protocol_HEADERS
+${PREFIX}/Benchmark.hpp
+${PREFIX}/Bulk.hpp
+${PREFIX}/Calibration.hpp
+${PREFIX}/Capture.hpp
+${PREFIX}/ChangeFilter.hpp
+${PREFIX}/Clock.hpp
+${PREFIX}/Daemon.hpp
+${PREFIX}/DeviceProfiles.hpp
+${PREFIX}/Error.hpp
+${PREFIX}/Leaf.hpp
+${PREFIX}/LeafEngine.hpp
+${PREFIX}/Master.hpp
 ${PREFIX}/Message.hpp
+${PREFIX}/MessageQueue.hpp
+${PREFIX}/Metrics.hpp
 ${PREFIX}/Network.hpp
 ${PREFIX}/Packet.hpp
 ${PREFIX}/Protocol.hpp
+${PREFIX}/Realtime.hpp
+${PREFIX}/Registers.hpp
+${PREFIX}/SampleStore.hpp
+${PREFIX}/SimulatedBus.hpp
+${PREFIX}/Snapshot.hpp
+${PREFIX}/Sniffer.hpp
+${PREFIX}/Statistics.hpp
+${PREFIX}/Stress.hpp
+${PREFIX}/Topology.hpp
+${PREFIX}/Trace.hpp
 ${PREFIX}/DeviceIds.h
+${PREFIX}/MemoryMap.h
 ${PREFIX}/MessageId.h
 )
 